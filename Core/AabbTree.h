@@ -0,0 +1,725 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/Frustum.h"
+
+namespace VenusEngine
+{
+	/// \brief A dynamic bounding volume hierarchy over axis-aligned boxes.
+	/// Leaves store "fat" boxes, enlarged by a margin, so that an object that
+	///   moves a little does not change the tree. A leaf that leaves its fat box
+	///   but not by far keeps its place and its ancestors are refit to it;
+	///   optimize() reinserts a few such leaves per call at the position of
+	///   least surface area.  A leaf that jumps is reinserted at once.
+	///   Reinsertion rebalances the ancestors with tree rotations on the way up.
+	/// All nodes live in one array and refer to each other by index; a node's
+	///   box is stored first so that traversal touches one cache line per node.
+	template<typename UserData>
+	class AabbTree
+	{
+	public:
+		static constexpr std::int32_t NULL_NODE = -1;
+
+		/// \param[in] margin How far fat boxes extend beyond the tight boxes.
+		explicit AabbTree(float margin = 0.1f)
+			: m_margin(margin)
+		{
+		}
+
+		/// \brief Adds a box.
+		/// \return The proxy (leaf index) of the box; it stays the same until the
+		///   box is removed.
+		std::int32_t insert(Vec3 const& min, Vec3 const& max, UserData const& userData)
+		{
+			std::int32_t proxy = allocateNode();
+			Node& node    = m_nodes[proxy];
+			node.min      = min - Vec3(m_margin, m_margin, m_margin);
+			node.max      = max + Vec3(m_margin, m_margin, m_margin);
+			node.userData = userData;
+			node.height   = 0;
+			insertLeaf(proxy);
+			++m_proxyCount;
+			return proxy;
+		}
+
+		void remove(std::int32_t proxy)
+		{
+			assert(isLeaf(proxy));
+			if (m_nodes[proxy].queued)
+			{
+				// Its entry in m_queued is skipped by optimize()
+				m_nodes[proxy].queued = false;
+				--m_queuedCount;
+			}
+			removeLeaf(proxy);
+			freeNode(proxy);
+			--m_proxyCount;
+		}
+
+		/// \brief Updates the box of a proxy.
+		/// \param[in] displacement The expected movement until the next update; the
+		///   fat box is stretched in that direction.
+		/// \return Whether the fat box changed. Nothing changes while the new box
+		///   stays inside the fat box and the fat box is not much too large.
+		bool move(std::int32_t proxy, Vec3 const& min, Vec3 const& max, Vec3 const& displacement = Vec3::ZERO)
+		{
+			assert(isLeaf(proxy));
+			Vec3 const margin(m_margin, m_margin, m_margin);
+			Vec3 fatMin = min - margin;
+			Vec3 fatMax = max + margin;
+			Vec3 stretch = displacement * DISPLACEMENT_MULTIPLIER;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				(stretch[axis] < 0.0f ? fatMin[axis] : fatMax[axis]) += stretch[axis];
+			}
+
+			Node const& node = m_nodes[proxy];
+			if (contains(node.min, node.max, min, max))
+			{
+				// Shrink only when the fat box is far larger than needed.  The
+				// stretch is allowed behind the box too, or a steady mover would
+				// shrink as often as it grows
+				Vec3 hugeMin = fatMin - margin * 4.0f;
+				Vec3 hugeMax = fatMax + margin * 4.0f;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					(stretch[axis] < 0.0f ? hugeMax[axis] : hugeMin[axis]) -= stretch[axis];
+				}
+				if (contains(hugeMin, hugeMax, node.min, node.max))
+				{
+					return false;
+				}
+			}
+
+			if (overlaps(node.min, node.max, fatMin, fatMax))
+			{
+				// The leaf keeps its place, a little worse than the one
+				// reinsertion would find, until optimize() reinserts it.
+				// Refitting walks up one path and mostly stops early, where
+				// reinsertion also searches down the tree and rotates
+				m_nodes[proxy].min = fatMin;
+				m_nodes[proxy].max = fatMax;
+				refitInPlace(m_nodes[proxy].parent);
+				if (!m_nodes[proxy].queued)
+				{
+					m_nodes[proxy].queued = true;
+					m_queued.push_back(proxy);
+					++m_queuedCount;
+				}
+				return true;
+			}
+			removeLeaf(proxy);
+			m_nodes[proxy].min = fatMin;
+			m_nodes[proxy].max = fatMax;
+			insertLeaf(proxy);
+			return true;
+		}
+
+		/// \brief Reinserts leaves that move() kept in place, oldest first, so
+		///   that the tree regains its quality over a few frames instead of
+		///   paying for every move at once.
+		/// \param[in] minCount The leaves reinserted per call at least; more are
+		///   when the backlog would take over OPTIMIZE_CALLS calls to drain,
+		///   so that it keeps up with however many leaves move.
+		/// \return The number of leaves reinserted.
+		std::size_t optimize(std::size_t minCount)
+		{
+			std::size_t maxCount   = std::max(minCount, m_queuedCount / OPTIMIZE_CALLS);
+			std::size_t reinserted = 0;
+			while (m_queuedHead < m_queued.size() && reinserted < maxCount)
+			{
+				std::int32_t proxy = m_queued[m_queuedHead++];
+				// Removed since it was queued, maybe reused by a new proxy that
+				// was queued again further on
+				if (!isLeaf(proxy) || !m_nodes[proxy].queued)
+				{
+					continue;
+				}
+				m_nodes[proxy].queued = false;
+				--m_queuedCount;
+				removeLeaf(proxy);
+				insertLeaf(proxy);
+				++reinserted;
+			}
+			// Drop the consumed entries once they are half the queue, so that it
+			// stays within twice the leaves waiting at a linear cost per entry
+			if (m_queuedHead * 2 >= m_queued.size())
+			{
+				m_queued.erase(m_queued.begin(), m_queued.begin() + static_cast<std::ptrdiff_t>(m_queuedHead));
+				m_queuedHead = 0;
+			}
+			return reinserted;
+		}
+
+		/// \return The number of leaves waiting for optimize().
+		std::size_t queuedCount() const
+		{
+			return m_queuedCount;
+		}
+
+		void clear()
+		{
+			m_nodes.clear();
+			m_root       = NULL_NODE;
+			m_freeList   = NULL_NODE;
+			m_proxyCount = 0;
+			m_queued.clear();
+			m_queuedHead  = 0;
+			m_queuedCount = 0;
+		}
+
+		UserData const& getUserData(std::int32_t proxy) const
+		{
+			return m_nodes[proxy].userData;
+		}
+
+		Vec3 const& getFatMin(std::int32_t proxy) const
+		{
+			return m_nodes[proxy].min;
+		}
+
+		Vec3 const& getFatMax(std::int32_t proxy) const
+		{
+			return m_nodes[proxy].max;
+		}
+
+		std::size_t size() const
+		{
+			return m_proxyCount;
+		}
+
+		/// \return The height of the tree; 0 for a single leaf.
+		std::int32_t height() const
+		{
+			return m_root == NULL_NODE ? 0 : m_nodes[m_root].height;
+		}
+
+		/// \brief Calls callback(userData) for every proxy whose fat box overlaps
+		///   the box.
+		template<typename Callback>
+		void queryBox(Vec3 const& min, Vec3 const& max, Callback&& callback) const
+		{
+			traverse([&](Node const& node) { return overlaps(node.min, node.max, min, max); }, callback);
+		}
+
+		/// \brief Calls callback(userData) for every proxy whose fat box overlaps
+		///   the sphere.
+		template<typename Callback>
+		void querySphere(Vec3 const& center, float radius, Callback&& callback) const
+		{
+			float const radiusSquared = radius * radius;
+			traverse([&](Node const& node)
+				{
+					float distanceSquared = 0.0f;
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						float closest = std::max(node.min[axis], std::min(center[axis], node.max[axis]));
+						distanceSquared += (center[axis] - closest) * (center[axis] - closest);
+					}
+					return distanceSquared <= radiusSquared;
+				}, callback);
+		}
+
+		/// \brief Calls callback(userData) for every proxy whose fat box may be
+		///   inside the frustum. Subtrees entirely inside are reported without
+		///   further tests.
+		template<typename Callback>
+		void queryFrustum(Frustum const& frustum, Callback&& callback) const
+		{
+			Stack stack;
+			push(stack, m_root);
+			while (!stack.empty())
+			{
+				std::int32_t index = pop(stack);
+				Node const& node = m_nodes[index];
+				Frustum::Containment containment = frustum.classify(node.min, node.max);
+				if (containment == Frustum::Containment::Outside)
+				{
+					continue;
+				}
+				if (containment == Frustum::Containment::Inside)
+				{
+					reportSubtree(index, callback);
+				}
+				else if (node.isLeaf())
+				{
+					callback(node.userData);
+				}
+				else
+				{
+					push(stack, node.child1);
+					push(stack, node.child2);
+				}
+			}
+		}
+
+		/// \brief Casts a ray against the fat boxes.
+		/// \param[in] direction Need not be normalized; distances are in units of
+		///   its length.
+		/// \param[in] callback callback(userData, entryDistance) returns the new
+		///   maximum distance: entryDistance to keep only closer hits, the current
+		///   maximum to see all hits, or 0 to stop.
+		template<typename Callback>
+		void raycast(Vec3 const& origin, Vec3 const& direction, float maxDistance, Callback&& callback) const
+		{
+			Vec3 inverse;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				inverse[axis] = direction[axis] != 0.0f ? 1.0f / direction[axis] : std::numeric_limits<float>::infinity();
+			}
+			Stack stack;
+			push(stack, m_root);
+			while (!stack.empty() && maxDistance > 0.0f)
+			{
+				std::int32_t index = pop(stack);
+				Node const& node = m_nodes[index];
+				float entry = 0.0f;
+				if (!intersectsRay(node, origin, inverse, maxDistance, entry))
+				{
+					continue;
+				}
+				if (node.isLeaf())
+				{
+					maxDistance = std::min(maxDistance, callback(node.userData, entry));
+				}
+				else
+				{
+					push(stack, node.child1);
+					push(stack, node.child2);
+				}
+			}
+		}
+
+		/// \brief Checks the structure of the tree; for debugging.
+		bool validate() const
+		{
+			return m_root == NULL_NODE || (m_nodes[m_root].parent == NULL_NODE && validate(m_root));
+		}
+
+	private:
+		// Fat boxes are stretched this many times the expected displacement,
+		// half a second of steady motion at 60 fps, so that movers seldom
+		// leave them
+		static constexpr float DISPLACEMENT_MULTIPLIER = 32.0f;
+		// optimize() drains its backlog within this many calls at most
+		static constexpr std::size_t OPTIMIZE_CALLS = 4;
+		// Traversal stack kept on the call stack unless the tree is very deep
+		static constexpr std::size_t STACK_CAPACITY = 256;
+
+		struct Node
+		{
+			Vec3         min;
+			Vec3         max;
+			// parent while allocated, next free node while free
+			std::int32_t parent = NULL_NODE;
+			std::int32_t child1 = NULL_NODE;
+			std::int32_t child2 = NULL_NODE;
+			// 0 for leaves, -1 for free nodes
+			std::int32_t height = 0;
+			// A leaf refit in place and waiting for optimize()
+			bool         queued = false;
+			UserData     userData{};
+
+			bool isLeaf() const
+			{
+				return child1 == NULL_NODE;
+			}
+		};
+
+		struct Stack
+		{
+			std::int32_t              fixed[STACK_CAPACITY];
+			std::size_t               count = 0;
+			std::vector<std::int32_t> overflow;
+
+			bool empty() const
+			{
+				return count == 0;
+			}
+		};
+
+		static void push(Stack& stack, std::int32_t index)
+		{
+			if (index == NULL_NODE)
+			{
+				return;
+			}
+			if (stack.count < STACK_CAPACITY)
+			{
+				stack.fixed[stack.count] = index;
+			}
+			else
+			{
+				stack.overflow.push_back(index);
+			}
+			++stack.count;
+		}
+
+		static std::int32_t pop(Stack& stack)
+		{
+			--stack.count;
+			if (stack.count < STACK_CAPACITY)
+			{
+				return stack.fixed[stack.count];
+			}
+			std::int32_t index = stack.overflow.back();
+			stack.overflow.pop_back();
+			return index;
+		}
+
+		template<typename Test, typename Callback>
+		void traverse(Test&& test, Callback& callback) const
+		{
+			Stack stack;
+			push(stack, m_root);
+			while (!stack.empty())
+			{
+				Node const& node = m_nodes[pop(stack)];
+				if (!test(node))
+				{
+					continue;
+				}
+				if (node.isLeaf())
+				{
+					callback(node.userData);
+				}
+				else
+				{
+					push(stack, node.child1);
+					push(stack, node.child2);
+				}
+			}
+		}
+
+		template<typename Callback>
+		void reportSubtree(std::int32_t root, Callback& callback) const
+		{
+			Stack stack;
+			push(stack, root);
+			while (!stack.empty())
+			{
+				Node const& node = m_nodes[pop(stack)];
+				if (node.isLeaf())
+				{
+					callback(node.userData);
+				}
+				else
+				{
+					push(stack, node.child1);
+					push(stack, node.child2);
+				}
+			}
+		}
+
+		// Slab test; entry receives the distance at which the ray enters the box
+		static bool intersectsRay(Node const& node, Vec3 const& origin, Vec3 const& inverse, float maxDistance, float& entry)
+		{
+			float tMin = 0.0f;
+			float tMax = maxDistance;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float t1 = (node.min[axis] - origin[axis]) * inverse[axis];
+				float t2 = (node.max[axis] - origin[axis]) * inverse[axis];
+				// NaN (0 * infinity) when the origin lies on a slab of a parallel ray
+				if (t1 != t1 || t2 != t2)
+				{
+					continue;
+				}
+				tMin = std::max(tMin, std::min(t1, t2));
+				tMax = std::min(tMax, std::max(t1, t2));
+			}
+			entry = tMin;
+			return tMin <= tMax;
+		}
+
+		static bool overlaps(Vec3 const& minA, Vec3 const& maxA, Vec3 const& minB, Vec3 const& maxB)
+		{
+			return minA.x <= maxB.x && minB.x <= maxA.x &&
+				minA.y <= maxB.y && minB.y <= maxA.y &&
+				minA.z <= maxB.z && minB.z <= maxA.z;
+		}
+
+		// Whether box A contains box B
+		static bool contains(Vec3 const& minA, Vec3 const& maxA, Vec3 const& minB, Vec3 const& maxB)
+		{
+			return minA.x <= minB.x && minA.y <= minB.y && minA.z <= minB.z &&
+				maxB.x <= maxA.x && maxB.y <= maxA.y && maxB.z <= maxA.z;
+		}
+
+		// Surface area up to a factor 2; the insertion cost metric
+		static float area(Vec3 const& min, Vec3 const& max)
+		{
+			Vec3 size = max - min;
+			return size.x * size.y + size.y * size.z + size.z * size.x;
+		}
+
+		static float unionArea(Node const& a, Node const& b)
+		{
+			Vec3 min = a.min;
+			Vec3 max = a.max;
+			min.makeFloor(b.min);
+			max.makeCeil(b.max);
+			return area(min, max);
+		}
+
+		void fitToChildren(std::int32_t index)
+		{
+			Node& node = m_nodes[index];
+			Node const& child1 = m_nodes[node.child1];
+			Node const& child2 = m_nodes[node.child2];
+			node.min = child1.min;
+			node.max = child1.max;
+			node.min.makeFloor(child2.min);
+			node.max.makeCeil(child2.max);
+			node.height = 1 + std::max(child1.height, child2.height);
+		}
+
+		std::int32_t allocateNode()
+		{
+			if (m_freeList == NULL_NODE)
+			{
+				m_nodes.emplace_back();
+				return static_cast<std::int32_t>(m_nodes.size() - 1);
+			}
+			std::int32_t index = m_freeList;
+			m_freeList = m_nodes[index].parent;
+			m_nodes[index] = Node();
+			return index;
+		}
+
+		void freeNode(std::int32_t index)
+		{
+			m_nodes[index].parent = m_freeList;
+			m_nodes[index].height = -1;
+			m_freeList = index;
+		}
+
+		bool isLeaf(std::int32_t index) const
+		{
+			return index >= 0 && static_cast<std::size_t>(index) < m_nodes.size() &&
+				m_nodes[index].height == 0;
+		}
+
+		void insertLeaf(std::int32_t leaf)
+		{
+			if (m_root == NULL_NODE)
+			{
+				m_root = leaf;
+				m_nodes[leaf].parent = NULL_NODE;
+				return;
+			}
+
+			// Descend towards the sibling that adds the least surface area
+			std::int32_t index = m_root;
+			while (!m_nodes[index].isLeaf())
+			{
+				Node const& node = m_nodes[index];
+				Node const& leafNode = m_nodes[leaf];
+				float nodeArea     = area(node.min, node.max);
+				float combinedArea = unionArea(node, leafNode);
+				// Cost of pairing the leaf with this node
+				float cost = 2.0f * combinedArea;
+				// Cost added to every ancestor by growing this node
+				float inheritedCost = 2.0f * (combinedArea - nodeArea);
+				float cost1 = descendCost(node.child1, leafNode) + inheritedCost;
+				float cost2 = descendCost(node.child2, leafNode) + inheritedCost;
+				if (cost < cost1 && cost < cost2)
+				{
+					break;
+				}
+				index = cost1 < cost2 ? node.child1 : node.child2;
+			}
+
+			std::int32_t sibling   = index;
+			std::int32_t oldParent = m_nodes[sibling].parent;
+			std::int32_t newParent = allocateNode();
+			m_nodes[newParent].parent = oldParent;
+			m_nodes[newParent].child1 = sibling;
+			m_nodes[newParent].child2 = leaf;
+			m_nodes[sibling].parent   = newParent;
+			m_nodes[leaf].parent      = newParent;
+			fitToChildren(newParent);
+			if (oldParent == NULL_NODE)
+			{
+				m_root = newParent;
+			}
+			else if (m_nodes[oldParent].child1 == sibling)
+			{
+				m_nodes[oldParent].child1 = newParent;
+			}
+			else
+			{
+				m_nodes[oldParent].child2 = newParent;
+			}
+
+			refitAncestors(m_nodes[leaf].parent);
+		}
+
+		float descendCost(std::int32_t child, Node const& leafNode) const
+		{
+			Node const& node = m_nodes[child];
+			if (node.isLeaf())
+			{
+				return unionArea(node, leafNode);
+			}
+			return unionArea(node, leafNode) - area(node.min, node.max);
+		}
+
+		void removeLeaf(std::int32_t leaf)
+		{
+			if (leaf == m_root)
+			{
+				m_root = NULL_NODE;
+				return;
+			}
+			std::int32_t parent      = m_nodes[leaf].parent;
+			std::int32_t grandParent = m_nodes[parent].parent;
+			std::int32_t sibling     = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+			freeNode(parent);
+			if (grandParent == NULL_NODE)
+			{
+				m_root = sibling;
+				m_nodes[sibling].parent = NULL_NODE;
+				return;
+			}
+			if (m_nodes[grandParent].child1 == parent)
+			{
+				m_nodes[grandParent].child1 = sibling;
+			}
+			else
+			{
+				m_nodes[grandParent].child2 = sibling;
+			}
+			m_nodes[sibling].parent = grandParent;
+			refitAncestors(grandParent);
+		}
+
+		// Grows or shrinks the nodes from index up to their children, stopping
+		// at the first one that does not change
+		void refitInPlace(std::int32_t index)
+		{
+			while (index != NULL_NODE)
+			{
+				Node& node = m_nodes[index];
+				Vec3 min = node.min;
+				Vec3 max = node.max;
+				fitToChildren(index);
+				if (node.min == min && node.max == max)
+				{
+					return;
+				}
+				index = node.parent;
+			}
+		}
+
+		// Rebalances and refits every node from index up to the root
+		void refitAncestors(std::int32_t index)
+		{
+			while (index != NULL_NODE)
+			{
+				index = rotate(index);
+				fitToChildren(index);
+				index = m_nodes[index].parent;
+			}
+		}
+
+		/// Rotates the taller grandchild of a node up when the heights of the
+		///   node's children differ by more than one.
+		/// \return The node now at the position of index.
+		std::int32_t rotate(std::int32_t indexA)
+		{
+			Node& a = m_nodes[indexA];
+			if (a.isLeaf() || a.height < 2)
+			{
+				return indexA;
+			}
+			std::int32_t indexB = a.child1;
+			std::int32_t indexC = a.child2;
+			std::int32_t balance = m_nodes[indexC].height - m_nodes[indexB].height;
+			if (balance > 1)
+			{
+				return rotateUp(indexA, indexC, false);
+			}
+			if (balance < -1)
+			{
+				return rotateUp(indexA, indexB, true);
+			}
+			return indexA;
+		}
+
+		// Makes the tall child of A take A's place. A keeps the short child and
+		//   the shorter grandchild; the tall child keeps the taller grandchild.
+		std::int32_t rotateUp(std::int32_t indexA, std::int32_t indexTall, bool tallIsChild1)
+		{
+			Node& a    = m_nodes[indexA];
+			Node& tall = m_nodes[indexTall];
+			std::int32_t indexF = tall.child1;
+			std::int32_t indexG = tall.child2;
+
+			// The tall child replaces A under A's parent
+			tall.child1 = indexA;
+			tall.parent = a.parent;
+			a.parent    = indexTall;
+			if (tall.parent == NULL_NODE)
+			{
+				m_root = indexTall;
+			}
+			else if (m_nodes[tall.parent].child1 == indexA)
+			{
+				m_nodes[tall.parent].child1 = indexTall;
+			}
+			else
+			{
+				m_nodes[tall.parent].child2 = indexTall;
+			}
+
+			std::int32_t indexKeep  = m_nodes[indexF].height > m_nodes[indexG].height ? indexF : indexG;
+			std::int32_t indexGiven = indexKeep == indexF ? indexG : indexF;
+			tall.child2 = indexKeep;
+			(tallIsChild1 ? a.child1 : a.child2) = indexGiven;
+			m_nodes[indexGiven].parent = indexA;
+
+			fitToChildren(indexA);
+			fitToChildren(indexTall);
+			return indexTall;
+		}
+
+		bool validate(std::int32_t index) const
+		{
+			Node const& node = m_nodes[index];
+			if (node.isLeaf())
+			{
+				return node.height == 0 && node.child2 == NULL_NODE;
+			}
+			Node const& child1 = m_nodes[node.child1];
+			Node const& child2 = m_nodes[node.child2];
+			if (child1.parent != index || child2.parent != index ||
+				node.height != 1 + std::max(child1.height, child2.height) ||
+				!contains(node.min, node.max, child1.min, child1.max) ||
+				!contains(node.min, node.max, child2.min, child2.max))
+			{
+				return false;
+			}
+			return validate(node.child1) && validate(node.child2);
+		}
+
+	private:
+		std::vector<Node> m_nodes;
+		std::int32_t      m_root       = NULL_NODE;
+		std::int32_t      m_freeList   = NULL_NODE;
+		std::size_t       m_proxyCount = 0;
+		float             m_margin;
+		// Leaves moved in place, in the order move() queued them
+		std::vector<std::int32_t> m_queued;
+		std::size_t               m_queuedHead  = 0;
+		// Leaves flagged queued; m_queued also holds entries of removed ones
+		std::size_t               m_queuedCount = 0;
+	};
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/AabbTree.h"
+#include "Core/Frustum.h"
+#include "Core/JobSystem.h"
+#include "Core/Time.h"
+
+namespace VenusEngine
+{
+	/// \brief Stress tests that run without a window, selected with
+	///   "--benchmark <name>" on the command line.
+	class Benchmark
+	{
+	public:
+		/// \return The process exit code.
+		static int run(std::string const& name)
+		{
+			if (name == "bvh")
+			{
+				return bvh();
+			}
+			if (name == "jobs")
+			{
+				return jobs();
+			}
+			std::cerr << "Unknown benchmark: " << name << std::endl;
+			return EXIT_FAILURE;
+		}
+
+	private:
+		// 100k boxes moving through a 1000^3 world, queried like a frame would
+		static int bvh()
+		{
+			constexpr std::size_t OBJECT_COUNT = 100000;
+			constexpr int         FRAME_COUNT  = 100;
+			constexpr int         QUERY_COUNT  = 100;
+			constexpr float       WORLD_HALF   = 500.0f;
+			// Like Scene::updateSpatialIndex
+			constexpr std::size_t OPTIMIZE_BUDGET = 512;
+
+			std::mt19937 random(42);
+			std::uniform_real_distribution<float> position(-WORLD_HALF, WORLD_HALF);
+			std::uniform_real_distribution<float> size(0.5f, 2.0f);
+			std::uniform_real_distribution<float> velocity(-0.2f, 0.2f);
+
+			std::vector<Vec3>         centers(OBJECT_COUNT);
+			std::vector<Vec3>         extents(OBJECT_COUNT);
+			std::vector<Vec3>         velocities(OBJECT_COUNT);
+			std::vector<std::int32_t> proxies(OBJECT_COUNT);
+			for (std::size_t i = 0; i < OBJECT_COUNT; ++i)
+			{
+				centers[i]    = Vec3(position(random), position(random), position(random));
+				float half    = size(random);
+				extents[i]    = Vec3(half, half, half);
+				velocities[i] = Vec3(velocity(random), velocity(random), velocity(random));
+			}
+
+			AabbTree<std::uint32_t> tree(0.5f);
+			Timer timer;
+			for (std::size_t i = 0; i < OBJECT_COUNT; ++i)
+			{
+				proxies[i] = tree.insert(centers[i] - extents[i], centers[i] + extents[i], static_cast<std::uint32_t>(i));
+			}
+			float buildMilliseconds = timer.elapsedMilliseconds();
+
+			Frustum frustum(Math::makePerspectiveMatrix(Radian(Math::degreesToRadians(60.0f)), 4.0f / 3.0f, 0.1f, 400.0f) *
+				Math::makeLookAtMatrix(Vec3(0.0f, 0.0f, WORLD_HALF), Vec3::ZERO, Vec3::UNIT_Y));
+
+			// Structure-of-arrays copy for the brute-force baseline
+			std::vector<float> columns[6];
+			for (std::vector<float>& column : columns)
+			{
+				column.resize(OBJECT_COUNT);
+			}
+			std::vector<std::uint8_t> visible(OBJECT_COUNT);
+
+			float       moveMilliseconds = 0.0f, frustumMilliseconds = 0.0f, bruteMilliseconds = 0.0f;
+			float       rayMilliseconds = 0.0f, sphereMilliseconds = 0.0f;
+			std::size_t updated = 0, reinserted = 0, treeVisible = 0, bruteVisible = 0, sphereHits = 0, rayHits = 0;
+			for (int frame = 0; frame < FRAME_COUNT; ++frame)
+			{
+				timer.reset();
+				for (std::size_t i = 0; i < OBJECT_COUNT; ++i)
+				{
+					centers[i] += velocities[i];
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						if (Math::abs(centers[i][axis]) > WORLD_HALF)
+						{
+							velocities[i][axis] = -velocities[i][axis];
+						}
+					}
+					updated += tree.move(proxies[i], centers[i] - extents[i], centers[i] + extents[i], velocities[i]);
+				}
+				reinserted += tree.optimize(OPTIMIZE_BUDGET);
+				moveMilliseconds += timer.elapsedMilliseconds();
+
+				timer.reset();
+				std::size_t count = 0;
+				tree.queryFrustum(frustum, [&](std::uint32_t) { ++count; });
+				frustumMilliseconds += timer.elapsedMilliseconds();
+				treeVisible += count;
+
+				for (std::size_t i = 0; i < OBJECT_COUNT; ++i)
+				{
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						columns[axis][i]     = centers[i][axis];
+						columns[axis + 3][i] = extents[i][axis];
+					}
+				}
+				timer.reset();
+				frustum.cull(columns[0].data(), columns[1].data(), columns[2].data(),
+					columns[3].data(), columns[4].data(), columns[5].data(), OBJECT_COUNT, visible.data());
+				bruteMilliseconds += timer.elapsedMilliseconds();
+				for (std::uint8_t isVisible : visible)
+				{
+					bruteVisible += isVisible;
+				}
+
+				timer.reset();
+				for (int query = 0; query < QUERY_COUNT; ++query)
+				{
+					Vec3 origin(position(random), position(random), -WORLD_HALF);
+					bool hit = false;
+					tree.raycast(origin, Vec3::UNIT_Z, 2.0f * WORLD_HALF, [&](std::uint32_t, float distance)
+						{
+							hit = true;
+							return distance;
+						});
+					rayHits += hit;
+				}
+				rayMilliseconds += timer.elapsedMilliseconds();
+
+				timer.reset();
+				for (int query = 0; query < QUERY_COUNT; ++query)
+				{
+					tree.querySphere(Vec3(position(random), position(random), position(random)), 20.0f,
+						[&](std::uint32_t) { ++sphereHits; });
+				}
+				sphereMilliseconds += timer.elapsedMilliseconds();
+			}
+
+			std::cout << "bvh: " << OBJECT_COUNT << " moving objects, " << FRAME_COUNT << " frames\n"
+				<< "  build:              " << buildMilliseconds << " ms, height " << tree.height() << "\n"
+				<< "  move:               " << moveMilliseconds / FRAME_COUNT << " ms/frame, "
+				<< updated / FRAME_COUNT << " updated/frame, " << reinserted / FRAME_COUNT << " reinserted/frame, "
+				<< tree.queuedCount() << " queued at the end\n"
+				<< "  frustum (tree):     " << frustumMilliseconds / FRAME_COUNT << " ms/frame, "
+				<< treeVisible / FRAME_COUNT << " visible\n"
+				<< "  frustum (brute):    " << bruteMilliseconds / FRAME_COUNT << " ms/frame, "
+				<< bruteVisible / FRAME_COUNT << " visible\n"
+				<< "  " << QUERY_COUNT << " rays:           " << rayMilliseconds / FRAME_COUNT << " ms/frame, "
+				<< rayHits / FRAME_COUNT << " hits\n"
+				<< "  " << QUERY_COUNT << " spheres (r=20): " << sphereMilliseconds / FRAME_COUNT << " ms/frame, "
+				<< sphereHits / FRAME_COUNT << " hits" << std::endl;
+			return tree.validate() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+		// A transform-update-like parallelFor and a fan-out/fan-in task graph, on
+		// pools of 1, 2, 4, ... threads up to the machine's (at most 64)
+		static int jobs()
+		{
+			constexpr std::size_t TRANSFORM_COUNT = 1000000;
+			constexpr std::size_t GRAIN           = 1024;
+			constexpr std::size_t TASK_COUNT      = 10000;
+			constexpr int         REPEAT_COUNT    = 10;
+
+			std::mt19937 random(42);
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+			std::vector<Transform> transforms(TRANSFORM_COUNT);
+			for (Transform& transform : transforms)
+			{
+				transform.m_position = Vec3(unit(random), unit(random), unit(random)) * 100.0f;
+				transform.m_rotation = Quaternion(Radian(unit(random) * Math::PI), Vec3::UNIT_Y);
+			}
+			std::vector<Mat4> matrices(TRANSFORM_COUNT);
+
+			unsigned maxThreads = std::min(64u, std::max(1u, std::thread::hardware_concurrency()));
+			float forBaseline = 0.0f, graphBaseline = 0.0f;
+			std::cout << "jobs: parallelFor over " << TRANSFORM_COUNT << " transforms (grain " << GRAIN
+				<< "), graph of " << TASK_COUNT << " tasks\n";
+			for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+			{
+				JobSystem jobSystem(threads - 1);
+
+				Timer timer;
+				for (int repeat = 0; repeat < REPEAT_COUNT; ++repeat)
+				{
+					jobSystem.parallelFor(0, TRANSFORM_COUNT, GRAIN, [&](std::size_t begin, std::size_t end)
+						{
+							for (std::size_t i = begin; i < end; ++i)
+							{
+								matrices[i] = transforms[i].getMatrix();
+							}
+						});
+				}
+				float forMilliseconds = timer.elapsedMilliseconds() / REPEAT_COUNT;
+
+				// One root, TASK_COUNT tasks that depend on it, one task that
+				// depends on them all
+				std::atomic<std::size_t> ran{ 0 };
+				timer.reset();
+				for (int repeat = 0; repeat < REPEAT_COUNT; ++repeat)
+				{
+					JobSystem::TaskHandle root = jobSystem.submit([&ran] { ++ran; });
+					std::vector<JobSystem::TaskHandle> leaves;
+					leaves.reserve(TASK_COUNT);
+					for (std::size_t i = 0; i < TASK_COUNT; ++i)
+					{
+						leaves.push_back(jobSystem.submit([&ran] { ++ran; }, { root }));
+					}
+					jobSystem.wait(jobSystem.submit([&ran] { ++ran; }, leaves));
+				}
+				float graphMilliseconds = timer.elapsedMilliseconds() / REPEAT_COUNT;
+				if (ran != REPEAT_COUNT * (TASK_COUNT + 2))
+				{
+					std::cerr << "jobs: " << ran << " tasks ran" << std::endl;
+					return EXIT_FAILURE;
+				}
+
+				if (threads == 1)
+				{
+					forBaseline   = forMilliseconds;
+					graphBaseline = graphMilliseconds;
+				}
+				std::cout << "  " << threads << " threads: parallelFor " << forMilliseconds << " ms ("
+					<< forBaseline / forMilliseconds << "x), graph " << graphMilliseconds << " ms ("
+					<< graphBaseline / graphMilliseconds << "x, "
+					<< graphMilliseconds * 1000.0f / TASK_COUNT << " us/task)\n";
+			}
+			std::cout << std::flush;
+			return EXIT_SUCCESS;
+		}
+	};
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Core/Registry.h"
+#include "Core/Components.h"
+#include "Core/TransformSystem.h"
+
+namespace VenusEngine
+{
+	// Transforms the local bounds of every entity that moved into world space
+	class BoundsSystem
+	{
+	public:
+		explicit BoundsSystem(TransformSystem const& transformSystem)
+			: m_transformSystem(transformSystem)
+		{
+		}
+
+		static ComponentMask reads()
+		{
+			return Registry::componentMask<WorldMatrixComponent>();
+		}
+
+		static ComponentMask writes()
+		{
+			return Registry::componentMask<BoundsComponent>();
+		}
+
+		/// \pre The TransformSystem ran earlier in the frame.
+		void run(Registry& registry)
+		{
+			ComponentPool<BoundsComponent>& bounds      = registry.pool<BoundsComponent>();
+			ComponentPool<WorldMatrixComponent>& worlds = registry.pool<WorldMatrixComponent>();
+			for (Entity entity : m_transformSystem.changed())
+			{
+				if (BoundsComponent* entityBounds = bounds.get(entity))
+				{
+					transformBounds(worlds.get(entity)->matrix, *entityBounds);
+				}
+			}
+		}
+
+		/// \brief Computes the world AABB enclosing the transformed local AABB.
+		static void transformBounds(Mat4 const& matrix, BoundsComponent& bounds)
+		{
+			Vec3 center = (bounds.localMin + bounds.localMax) * 0.5f;
+			Vec3 extent = (bounds.localMax - bounds.localMin) * 0.5f;
+			Vec3 worldCenter = matrix.transformAffine(center);
+			Vec3 worldExtent;
+			for (int row = 0; row < 3; ++row)
+			{
+				worldExtent[row] = Math::abs(matrix[row][0]) * extent.x +
+					Math::abs(matrix[row][1]) * extent.y +
+					Math::abs(matrix[row][2]) * extent.z;
+			}
+			bounds.worldMin = worldCenter - worldExtent;
+			bounds.worldMax = worldCenter + worldExtent;
+		}
+
+	private:
+		TransformSystem const& m_transformSystem;
+	};
+}
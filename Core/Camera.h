@@ -35,11 +35,25 @@ namespace VenusEngine
 			m_position = position;
 		}
 
+		Vec3 const& getPosition() const
+		{
+			return m_position;
+		}
+
 		void setTarget(Vec3 const& target)
 		{
 			m_target = target;
 		}
 
+		/// \brief Places the camera at position, looking at target.
+		/// \post The camera's axis vectors have been recomputed.
+		void lookAt(Vec3 const& position, Vec3 const& target)
+		{
+			m_position = position;
+			m_target   = target;
+			updateCameraOrientation();
+		}
+
 		/// \brief Moves the position (eye point) of the camera right or left.
 		/// \param[in] distance How far to move along the right vector.
 		/// \post The camera's location has been changed.
@@ -164,6 +178,16 @@ namespace VenusEngine
 			return getProjectionMatrix() * getViewMatrix();
 		}
 
+		float getNearClipPlaneDistance() const
+		{
+			return m_nearClipPlaneDistance;
+		}
+
+		float getFarClipPlaneDistance() const
+		{
+			return m_farClipPlaneDistance;
+		}
+
 		/// \brief Resets the camera to its original pose.
 		/// \post The position (eye point) is the same as what had been specified in
 		///   the constructor.
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Math/MathHeaders.h"
+#include "Core/Mesh.h"
+#include "Core/LightSource.h"
+#include "Core/Registry.h"
+#include "Core/Symbol.h"
+
+namespace VenusEngine
+{
+	// Local position, rotation and scale of an entity
+	struct TransformComponent
+	{
+		Transform transform;
+	};
+
+	// Links of an entity in the transform hierarchy. Children are kept in an
+	//   intrusive doubly linked list; depth is 0 for roots.
+	struct HierarchyComponent
+	{
+		Entity        parent;
+		Entity        firstChild;
+		Entity        nextSibling;
+		Entity        prevSibling;
+		std::uint32_t depth      = 0;
+		// Set while the world matrix is queued for an update
+		bool          worldDirty = false;
+	};
+
+	// World matrix: the parent's world matrix times the local transform.
+	//   Recomputed only when the entity or one of its ancestors moved.
+	struct WorldMatrixComponent
+	{
+		Mat4 matrix;
+	};
+
+	// Something drawn with a Mesh. Several entities may share one Mesh.
+	struct RenderableComponent
+	{
+		std::shared_ptr<Mesh> mesh;
+		// Value written to the ID attachment for picking
+		int                   pickID  = 0;
+		// Below 1, the mesh is drawn in the blended pass
+		float                 opacity  = 1.0f;
+		// Whether the mesh hides what is behind it in occlusion culling; only
+		// large, simple meshes are worth rasterizing, so none is by default
+		bool                  occluder = false;
+	};
+
+	struct LightComponent
+	{
+		std::shared_ptr<LightSource> light;
+	};
+
+	// Axis-aligned bounds of an entity, in its local and in world space
+	struct BoundsComponent
+	{
+		Vec3 localMin;
+		Vec3 localMax;
+		Vec3 worldMin;
+		Vec3 worldMax;
+		// leaf of the entity in the Scene's spatial index
+		std::int32_t spatialProxy = -1;
+	};
+
+	// Set on a renderable entity while it moves.  Shadow maps draw it every
+	// frame, rather than caching it with the meshes that stand still
+	struct MovingComponent
+	{
+		// Frames since the entity last moved
+		std::uint32_t idleFrames = 0;
+	};
+
+	// Set on a renderable entity that stands still: the world bounds at which
+	// shadow maps cache it
+	struct StaticCasterComponent
+	{
+		Vec3 worldMin;
+		Vec3 worldMax;
+	};
+
+	// Tag of the entity currently selected in the editor
+	struct SelectionComponent
+	{
+	};
+
+	// Display name; looked up through the name index of the Scene or the
+	// SceneLight
+	struct NameComponent
+	{
+		Symbol name;
+	};
+}
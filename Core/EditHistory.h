@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace VenusEngine
+{
+	/// \brief A journal of reversible edits, for undo and redo.
+	/// An entry holds only what its edit changed (the old and new values, or
+	///   the objects the edit removed), never a copy of the scene, so recording
+	///   costs O(changed data).  The journal is bounded both in steps and in
+	///   bytes; the oldest steps are dropped first.
+	class EditHistory
+	{
+	public:
+		static constexpr std::size_t MAX_STEPS = 1000;
+		static constexpr std::size_t MAX_BYTES = 64 * 1024 * 1024;
+
+		/// \brief An edit that has already been applied, and how to revert and
+		///   re-apply it.
+		struct Edit
+		{
+			std::function<void()> undo;
+			std::function<void()> redo;
+			// Memory held by the two functions, approximately
+			std::size_t           bytes = 0;
+		};
+
+		/// \brief Records an edit that has just been applied.
+		/// \param[in] mergeKey Consecutive edits with the same non-zero key are
+		///   merged into one step until seal() is called, so that dragging a
+		///   gizmo or a slider is undone at once.
+		/// \post The steps that had been undone can no longer be redone.
+		void record(Edit edit, std::uint64_t mergeKey = 0)
+		{
+			for (Entry const& entry : m_redo)
+			{
+				m_bytes -= entry.edit.bytes + sizeof(Entry);
+			}
+			m_redo.clear();
+
+			if (mergeKey != 0 && !m_sealed && !m_undo.empty() && m_undo.back().mergeKey == mergeKey)
+			{
+				// Keep the oldest undo and the newest redo
+				m_undo.back().edit.redo = std::move(edit.redo);
+				return;
+			}
+			m_bytes += edit.bytes + sizeof(Entry);
+			m_undo.push_back({ std::move(edit), mergeKey });
+			m_sealed = false;
+			while (m_undo.size() > MAX_STEPS || (m_bytes > MAX_BYTES && m_undo.size() > 1))
+			{
+				m_bytes -= m_undo.front().edit.bytes + sizeof(Entry);
+				m_undo.pop_front();
+			}
+		}
+
+		/// \brief Ends the current merge; the next edit starts a new step.
+		void seal()
+		{
+			m_sealed = true;
+		}
+
+		/// \return false if there is nothing to undo.
+		bool undo()
+		{
+			if (m_undo.empty())
+			{
+				return false;
+			}
+			Entry entry = std::move(m_undo.back());
+			m_undo.pop_back();
+			entry.edit.undo();
+			m_redo.push_back(std::move(entry));
+			m_sealed = true;
+			return true;
+		}
+
+		/// \return false if there is nothing to redo.
+		bool redo()
+		{
+			if (m_redo.empty())
+			{
+				return false;
+			}
+			Entry entry = std::move(m_redo.back());
+			m_redo.pop_back();
+			entry.edit.redo();
+			m_undo.push_back(std::move(entry));
+			m_sealed = true;
+			return true;
+		}
+
+		bool canUndo() const
+		{
+			return !m_undo.empty();
+		}
+
+		bool canRedo() const
+		{
+			return !m_redo.empty();
+		}
+
+		/// \brief Forgets every step, e.g. when another scene is opened.
+		void clear()
+		{
+			m_undo.clear();
+			m_redo.clear();
+			m_bytes  = 0;
+			m_sealed = true;
+		}
+
+		std::size_t size() const
+		{
+			return m_undo.size();
+		}
+
+		std::size_t bytes() const
+		{
+			return m_bytes;
+		}
+
+	private:
+		struct Entry
+		{
+			Edit          edit;
+			std::uint64_t mergeKey = 0;
+		};
+
+	private:
+		std::deque<Entry>  m_undo;
+		std::vector<Entry> m_redo;
+		std::size_t        m_bytes  = 0;
+		bool               m_sealed = true;
+	};
+}
@@ -2,24 +2,25 @@
 
 #include <string>
 #include <fstream>
-#include <cassert>
+#include <iterator>
 
 namespace VenusEngine
 {
 	class FileReader
 	{
 	public:
-		static std::string readFile(std::string const& path)
+		/// \return false if the file cannot be read.
+		static bool readFile(std::string const& path, std::string& contents)
 		{
-			std::ifstream filename(path);
-			if (!filename)
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
 			{
-				std::cout << "File %s does not exist; exiting\n" << path << std::endl;
-				exit(-1);
+				return false;
 			}
 
-			return std::string((std::istreambuf_iterator<char>(filename)),
-								std::istreambuf_iterator<char>());
+			contents.assign((std::istreambuf_iterator<char>(file)),
+							std::istreambuf_iterator<char>());
+			return true;
 		}
 	};
 }
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VENUS_FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "Math/MathHeaders.h"
+
+namespace VenusEngine
+{
+	/// \brief The six clipping planes of a camera, in world space.
+	/// Boxes are tested as center and half extent: a box is outside when, for
+	///   some plane, its center lies further behind the plane than its extent
+	///   projected onto the plane normal. The test is conservative: boxes near a
+	///   frustum corner may be kept although they are outside.
+	class Frustum
+	{
+	public:
+		static constexpr std::size_t PLANE_COUNT = 6;
+
+		/// \brief Constructs a frustum that contains everything.
+		Frustum()
+		{
+			for (std::size_t i = 0; i < PLANE_COUNT; ++i)
+			{
+				m_planes[i][0] = m_planes[i][1] = m_planes[i][2] = 0.0f;
+				m_planes[i][3] = 1.0f;
+			}
+		}
+
+		/// \brief Extracts the planes of a view-projection matrix (OpenGL clip
+		///   space, -w <= x, y, z <= w).
+		explicit Frustum(Mat4 const& viewProjection)
+		{
+			// left, right, bottom, top, near, far: row 3 +/- row 0, 1, 2
+			for (std::size_t i = 0; i < PLANE_COUNT; ++i)
+			{
+				std::size_t row  = i / 2;
+				float       sign = (i % 2 == 0) ? 1.0f : -1.0f;
+				for (std::size_t col = 0; col < 4; ++col)
+				{
+					m_planes[i][col] = viewProjection[3][col] + sign * viewProjection[row][col];
+				}
+				float length = std::sqrt(m_planes[i][0] * m_planes[i][0] + m_planes[i][1] * m_planes[i][1] +
+					m_planes[i][2] * m_planes[i][2]);
+				for (std::size_t col = 0; col < 4; ++col)
+				{
+					m_planes[i][col] /= length;
+				}
+			}
+		}
+
+		enum class Containment
+		{
+			Outside,
+			Intersects,
+			Inside
+		};
+
+		/// \brief Classifies a box against all planes.
+		/// \return Inside if the box is entirely inside the frustum, Outside if it
+		///   is entirely behind one plane, Intersects otherwise.
+		Containment classify(Vec3 const& min, Vec3 const& max) const
+		{
+			Vec3 center = (min + max) * 0.5f;
+			Vec3 extent = (max - min) * 0.5f;
+			Containment result = Containment::Inside;
+			for (std::size_t p = 0; p < PLANE_COUNT; ++p)
+			{
+				float const* plane = m_planes[p];
+				float distance = plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3];
+				float radius   = std::fabs(plane[0]) * extent.x + std::fabs(plane[1]) * extent.y +
+					std::fabs(plane[2]) * extent.z;
+				if (distance + radius < 0.0f)
+				{
+					return Containment::Outside;
+				}
+				if (distance - radius < 0.0f)
+				{
+					result = Containment::Intersects;
+				}
+			}
+			return result;
+		}
+
+		/// \return Whether the box given by its corners may be visible.
+		bool intersects(Vec3 const& min, Vec3 const& max) const
+		{
+			Vec3 center = (min + max) * 0.5f;
+			Vec3 extent = (max - min) * 0.5f;
+			return intersects(center.x, center.y, center.z, extent.x, extent.y, extent.z);
+		}
+
+		/// \brief Tests many boxes given in structure-of-arrays form.
+		/// \param[out] visible One entry per box: 1 if it may be visible, else 0.
+		/// Four boxes are tested at once when SSE is available.
+		void cull(float const* centerX, float const* centerY, float const* centerZ,
+			float const* extentX, float const* extentY, float const* extentZ,
+			std::size_t count, std::uint8_t* visible) const
+		{
+			std::size_t i = 0;
+#ifdef VENUS_FRUSTUM_SSE
+			__m128 const signMask = _mm_set1_ps(-0.0f);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 cx = _mm_loadu_ps(centerX + i);
+				__m128 cy = _mm_loadu_ps(centerY + i);
+				__m128 cz = _mm_loadu_ps(centerZ + i);
+				__m128 ex = _mm_loadu_ps(extentX + i);
+				__m128 ey = _mm_loadu_ps(extentY + i);
+				__m128 ez = _mm_loadu_ps(extentZ + i);
+				__m128 outside = _mm_setzero_ps();
+				for (std::size_t p = 0; p < PLANE_COUNT; ++p)
+				{
+					__m128 nx = _mm_set1_ps(m_planes[p][0]);
+					__m128 ny = _mm_set1_ps(m_planes[p][1]);
+					__m128 nz = _mm_set1_ps(m_planes[p][2]);
+					// distance = n . c + d
+					__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+						_mm_add_ps(_mm_mul_ps(nz, cz), _mm_set1_ps(m_planes[p][3])));
+					// radius = |n| . e
+					__m128 radius = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+						_mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+						_mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+				}
+				int outsideBits = _mm_movemask_ps(outside);
+				visible[i + 0] = !(outsideBits & 1);
+				visible[i + 1] = !(outsideBits & 2);
+				visible[i + 2] = !(outsideBits & 4);
+				visible[i + 3] = !(outsideBits & 8);
+			}
+#endif
+			for (; i < count; ++i)
+			{
+				visible[i] = intersects(centerX[i], centerY[i], centerZ[i], extentX[i], extentY[i], extentZ[i]);
+			}
+		}
+
+	private:
+		bool intersects(float cx, float cy, float cz, float ex, float ey, float ez) const
+		{
+			for (std::size_t p = 0; p < PLANE_COUNT; ++p)
+			{
+				float const* plane = m_planes[p];
+				float distance = plane[0] * cx + plane[1] * cy + plane[2] * cz + plane[3];
+				float radius   = std::fabs(plane[0]) * ex + std::fabs(plane[1]) * ey + std::fabs(plane[2]) * ez;
+				if (distance + radius < 0.0f)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		// a, b, c, d of ax + by + cz + d >= 0 for points inside; normals have unit length
+		float m_planes[PLANE_COUNT][4];
+	};
+}
@@ -4,6 +4,7 @@
 #include <array>
 
 #include "Math/MathHeaders.h"
+#include "Render/VertexLayout.h"
 
 namespace VenusEngine
 {
@@ -298,29 +299,30 @@ namespace VenusEngine
 
 		/// \brief Produces a collection of interleaved position / normal / color data from
 		///   faces, face normals and face colors.
+		/// \tparam Layout The vertex layout to write; it must have float position,
+		///   normal and color attributes and a stride that is a multiple of a float.
 		/// \param[in] faces A collection of faces that are part of the mesh.
 		/// \param[in] faceNormals A collection of normals, one per face.
-		/// /// \param[in] faceColors A collection of colors, one per face.
+		/// \param[in] faceColors A collection of colors, one per face.
 		/// \return A collection containing interleaved position / normal / color data that is
 		///   ready to be indexed / added to a Mesh.
+		template<typename Layout = MeshVertexLayout>
 		static std::vector<float> dataWithFaceNormalsANDColors(std::vector<Triangle> const& faces,
 			std::vector<Vec3> const& faceNormals, std::vector<Vec3> const& faceColors)
 		{
+			static_assert(Layout::STRIDE % sizeof(float) == 0, "Layout stride must be a multiple of a float");
 			assert(faces.size() == faceNormals.size() && faces.size() == faceColors.size());
-			std::vector<float> data;
+			std::size_t const floatsPerVertex = Layout::STRIDE / sizeof(float);
+			std::vector<float> data(faces.size() * 3 * floatsPerVertex, 0.0f);
+			float* vertex = data.data();
 			for (unsigned int faceIndex = 0; faceIndex < faces.size(); faceIndex++)
 			{
 				for (unsigned int vertexIndex = 0; vertexIndex < 3; vertexIndex++)
 				{
-					data.push_back(faces[faceIndex][vertexIndex].x);
-					data.push_back(faces[faceIndex][vertexIndex].y);
-					data.push_back(faces[faceIndex][vertexIndex].z);
-					data.push_back(faceNormals[faceIndex].x);
-					data.push_back(faceNormals[faceIndex].y);
-					data.push_back(faceNormals[faceIndex].z);
-					data.push_back(faceColors[faceIndex].x);
-					data.push_back(faceColors[faceIndex].y);
-					data.push_back(faceColors[faceIndex].z);
+					Layout::template write<VertexSemantic::Position>(vertex, faces[faceIndex][vertexIndex].ptr());
+					Layout::template write<VertexSemantic::Normal>(vertex, faceNormals[faceIndex].ptr());
+					Layout::template write<VertexSemantic::Color>(vertex, faceColors[faceIndex].ptr());
+					vertex += floatsPerVertex;
 				}
 			}
 			return data;
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VenusEngine
+{
+	/// \brief A pool of worker threads, sized to the machine, that runs tasks
+	///   for the whole engine.
+	/// Each worker owns a Chase-Lev deque: it pushes and pops its own tasks at
+	///   the bottom, and idle workers steal from the top of the others'.  Tasks
+	///   submitted by other threads go to a shared queue.  A thread that waits
+	///   for a task runs other tasks meanwhile, so a task may wait for the tasks
+	///   it spawns.
+	/// GL calls are only valid on the main thread; tasks hand such work to it
+	///   with runOnMainThread().
+	class JobSystem
+	{
+	public:
+		class Task;
+		using TaskHandle = std::shared_ptr<Task>;
+
+		/// \brief A unit of work, and the tasks that wait for it.
+		class Task
+		{
+		public:
+			bool isDone() const
+			{
+				return m_done.load(std::memory_order_acquire);
+			}
+
+		private:
+			friend class JobSystem;
+
+			std::function<void()>   m_function;
+			// Unfinished dependencies, plus one until submit() returns
+			std::atomic<int>        m_dependencies{ 1 };
+			std::atomic<bool>       m_done{ false };
+			std::mutex              m_mutex;
+			std::vector<TaskHandle> m_continuations;
+			// Keeps the task alive while it sits in a queue
+			TaskHandle              m_self;
+		};
+
+		/// \param[in] workerCount The number of threads besides the ones that
+		///   submit and wait, which help.
+		explicit JobSystem(unsigned workerCount = defaultWorkerCount())
+			: m_workers(workerCount)
+		{
+			for (unsigned i = 0; i < workerCount; ++i)
+			{
+				m_workers[i] = std::make_unique<Worker>();
+			}
+			for (unsigned i = 0; i < workerCount; ++i)
+			{
+				m_workers[i]->thread = std::thread([this, i] { work(i); });
+			}
+		}
+
+		/// \brief Runs the queued tasks, then stops the workers.
+		~JobSystem()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_sleepMutex);
+				m_stopping = true;
+			}
+			m_wake.notify_all();
+			for (std::unique_ptr<Worker>& worker : m_workers)
+			{
+				worker->thread.join();
+			}
+			// Tasks submitted without a worker to run them
+			while (Task* task = findWork())
+			{
+				execute(task);
+			}
+		}
+
+		JobSystem(JobSystem const&) = delete;
+
+		void operator=(JobSystem const&) = delete;
+
+		/// \brief The engine's pool, created on first use.
+		static JobSystem& get()
+		{
+			static JobSystem jobSystem;
+			return jobSystem;
+		}
+
+		/// \return One worker per hardware thread, but for the main thread, and at
+		///   least one so that background tasks progress while nothing waits.
+		static unsigned defaultWorkerCount()
+		{
+			return std::max(2u, std::thread::hardware_concurrency()) - 1;
+		}
+
+		unsigned workerCount() const
+		{
+			return static_cast<unsigned>(m_workers.size());
+		}
+
+		/// \brief Queues a function, to run once every dependency has finished.
+		/// \param[in] dependencies Tasks that must finish first; empty handles
+		///   are ignored.
+		TaskHandle submit(std::function<void()> function, std::vector<TaskHandle> const& dependencies = {})
+		{
+			auto task = std::make_shared<Task>();
+			task->m_function = std::move(function);
+			for (TaskHandle const& dependency : dependencies)
+			{
+				if (!dependency)
+				{
+					continue;
+				}
+				std::lock_guard<std::mutex> lock(dependency->m_mutex);
+				if (!dependency->isDone())
+				{
+					task->m_dependencies.fetch_add(1);
+					dependency->m_continuations.push_back(task);
+				}
+			}
+			if (task->m_dependencies.fetch_sub(1) == 1)
+			{
+				schedule(task);
+			}
+			return task;
+		}
+
+		/// \brief Runs other tasks until task has finished.
+		void wait(TaskHandle const& task)
+		{
+			while (task && !task->isDone())
+			{
+				if (Task* other = findWork())
+				{
+					execute(other);
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		/// \brief Calls body(chunkBegin, chunkEnd) over [begin, end) in chunks of
+		///   grain indices, spread over the workers and the calling thread.
+		/// \param[in] grain The smallest amount of work worth a task; ranges of
+		///   at most one chunk run on the calling thread.
+		template <typename Function>
+		void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, Function&& body)
+		{
+			if (begin >= end)
+			{
+				return;
+			}
+			grain = std::max<std::size_t>(1, grain);
+			std::size_t chunkCount = (end - begin + grain - 1) / grain;
+			if (chunkCount == 1 || m_workers.empty())
+			{
+				body(begin, end);
+				return;
+			}
+
+			// Chunks are claimed one at a time, so a helper that starts late or
+			// runs slowly takes less of the range
+			std::atomic<std::size_t> nextChunk{ 0 };
+			auto run = [&]
+			{
+				for (std::size_t chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1))
+				{
+					std::size_t chunkBegin = begin + chunk * grain;
+					body(chunkBegin, std::min(end, chunkBegin + grain));
+				}
+			};
+			std::size_t helperCount = std::min<std::size_t>(chunkCount - 1, m_workers.size());
+			std::vector<TaskHandle> helpers;
+			helpers.reserve(helperCount);
+			for (std::size_t i = 0; i < helperCount; ++i)
+			{
+				helpers.push_back(submit(run));
+			}
+			run();
+			for (TaskHandle const& helper : helpers)
+			{
+				wait(helper);
+			}
+		}
+
+		/// \brief Queues a function for the main thread, e.g. GL work prepared by
+		///   a task.  It runs in the next runMainThreadJobs().
+		void runOnMainThread(std::function<void()> function)
+		{
+			std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+			m_mainThreadJobs.push_back(std::move(function));
+		}
+
+		/// \brief Runs the functions queued for the main thread.  Called once per
+		///   frame by the main thread.
+		void runMainThreadJobs()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mainThreadMutex);
+				m_mainThreadRunning.swap(m_mainThreadJobs);
+			}
+			for (std::function<void()>& function : m_mainThreadRunning)
+			{
+				function();
+			}
+			m_mainThreadRunning.clear();
+		}
+
+	private:
+		// Spins before a worker sleeps, in case work arrives right away
+		static constexpr int SPIN_COUNT = 64;
+
+		/// \brief The work-stealing deque of Chase and Lev, with the memory
+		///   orderings of Le et al. for weak memory models.  Only the owner
+		///   pushes and pops; any thread steals.
+		class WorkDeque
+		{
+		public:
+			static constexpr std::int64_t CAPACITY = 1024;
+
+			/// \return false if the deque is full.
+			bool push(Task* task)
+			{
+				std::int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+				std::int64_t top    = m_top.load(std::memory_order_acquire);
+				if (bottom - top >= CAPACITY)
+				{
+					return false;
+				}
+				m_tasks[bottom & (CAPACITY - 1)].store(task, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_release);
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			Task* pop()
+			{
+				std::int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+				m_bottom.store(bottom, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				std::int64_t top = m_top.load(std::memory_order_relaxed);
+				if (top > bottom)
+				{
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+					return nullptr;
+				}
+				Task* task = m_tasks[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+				if (top == bottom)
+				{
+					// The last task; race the thieves for it
+					if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					{
+						task = nullptr;
+					}
+					m_bottom.store(bottom + 1, std::memory_order_relaxed);
+				}
+				return task;
+			}
+
+			Task* steal()
+			{
+				std::int64_t top = m_top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				std::int64_t bottom = m_bottom.load(std::memory_order_acquire);
+				if (top >= bottom)
+				{
+					return nullptr;
+				}
+				Task* task = m_tasks[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+				if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return nullptr;
+				}
+				return task;
+			}
+
+		private:
+			alignas(64) std::atomic<std::int64_t> m_top{ 0 };
+			alignas(64) std::atomic<std::int64_t> m_bottom{ 0 };
+			std::atomic<Task*>                    m_tasks[CAPACITY] = {};
+		};
+
+		struct Worker
+		{
+			WorkDeque   tasks;
+			std::thread thread;
+		};
+
+		// The worker that the calling thread is, if any
+		struct CurrentWorker
+		{
+			JobSystem const* jobSystem = nullptr;
+			std::size_t      index     = 0;
+		};
+
+		static CurrentWorker& currentWorker()
+		{
+			static thread_local CurrentWorker current;
+			return current;
+		}
+
+		Worker* ownWorker()
+		{
+			CurrentWorker const& current = currentWorker();
+			return current.jobSystem == this ? m_workers[current.index].get() : nullptr;
+		}
+
+		void work(std::size_t index)
+		{
+			currentWorker() = { this, index };
+			for (;;)
+			{
+				if (Task* task = findWork())
+				{
+					execute(task);
+					continue;
+				}
+				for (int i = 0; i < SPIN_COUNT && m_queued.load() <= 0; ++i)
+				{
+					std::this_thread::yield();
+				}
+				if (m_queued.load() > 0)
+				{
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(m_sleepMutex);
+				if (m_stopping)
+				{
+					return;
+				}
+				m_sleeping.fetch_add(1);
+				m_wake.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+				m_sleeping.fetch_sub(1);
+			}
+		}
+
+		void schedule(TaskHandle const& task)
+		{
+			task->m_self = task;
+			Worker* worker = ownWorker();
+			if (!worker || !worker->tasks.push(task.get()))
+			{
+				std::lock_guard<std::mutex> lock(m_sharedMutex);
+				m_shared.push_back(task.get());
+				m_sharedCount.fetch_add(1);
+			}
+			m_queued.fetch_add(1);
+			// A worker that saw no work either rechecks after this, or sleeps
+			if (m_sleeping.load() > 0)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_sleepMutex);
+				}
+				m_wake.notify_one();
+			}
+		}
+
+		// Own tasks first, then the shared queue, then the other workers'
+		Task* findWork()
+		{
+			Worker* worker = ownWorker();
+			if (worker)
+			{
+				if (Task* task = worker->tasks.pop())
+				{
+					return take(task);
+				}
+			}
+			if (m_sharedCount.load() > 0)
+			{
+				std::lock_guard<std::mutex> lock(m_sharedMutex);
+				if (!m_shared.empty())
+				{
+					Task* task = m_shared.front();
+					m_shared.pop_front();
+					m_sharedCount.fetch_sub(1);
+					return take(task);
+				}
+			}
+			std::size_t count = m_workers.size();
+			std::size_t start = count > 0 ? m_nextVictim.fetch_add(1, std::memory_order_relaxed) % count : 0;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				Worker* victim = m_workers[(start + i) % count].get();
+				if (victim == worker)
+				{
+					continue;
+				}
+				if (Task* task = victim->tasks.steal())
+				{
+					return take(task);
+				}
+			}
+			return nullptr;
+		}
+
+		Task* take(Task* task)
+		{
+			m_queued.fetch_sub(1);
+			return task;
+		}
+
+		void execute(Task* queued)
+		{
+			TaskHandle task = std::move(queued->m_self);
+			task->m_function();
+			task->m_function = nullptr;
+
+			std::vector<TaskHandle> continuations;
+			{
+				std::lock_guard<std::mutex> lock(task->m_mutex);
+				task->m_done.store(true, std::memory_order_release);
+				continuations.swap(task->m_continuations);
+			}
+			for (TaskHandle const& continuation : continuations)
+			{
+				if (continuation->m_dependencies.fetch_sub(1) == 1)
+				{
+					schedule(continuation);
+				}
+			}
+		}
+
+	private:
+		std::vector<std::unique_ptr<Worker>> m_workers;
+		std::atomic<std::size_t>             m_nextVictim{ 0 };
+
+		// Tasks submitted by threads that are not workers
+		std::mutex                           m_sharedMutex;
+		std::deque<Task*>                    m_shared;
+		std::atomic<std::size_t>             m_sharedCount{ 0 };
+
+		// Tasks in any queue, and the workers sleeping until there are some
+		std::atomic<std::int64_t>            m_queued{ 0 };
+		std::atomic<int>                     m_sleeping{ 0 };
+		std::mutex                           m_sleepMutex;
+		std::condition_variable              m_wake;
+		bool                                 m_stopping = false;
+
+		std::mutex                           m_mainThreadMutex;
+		std::vector<std::function<void()>>   m_mainThreadJobs;
+		std::vector<std::function<void()>>   m_mainThreadRunning;
+	};
+}
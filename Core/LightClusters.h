@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VENUS_CLUSTER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "Math/MathHeaders.h"
+#include "Core/JobSystem.h"
+#include "Core/LightSource.h"
+#include "Render/LightBlock.h"
+
+namespace VenusEngine
+{
+	/// \brief Assigns lights to the clusters of the view frustum for clustered
+	///   forward shading.
+	/// The frustum is split into GRID_X x GRID_Y screen tiles and GRID_Z depth
+	///   slices whose thickness grows with distance, so clusters stay roughly
+	///   as deep as they are wide.  Each frame the point and spot lights are
+	///   bounded by spheres in view space, then every depth slice is filled on
+	///   a worker thread, testing a sphere against four cluster boxes at a
+	///   time.  Spot lights are also tested with their cone against the
+	///   bounding sphere of each box they touch.  The result is a compact list
+	///   of light indices per cluster, so shading a point costs the lights
+	///   near it rather than every light.
+	/// Directional lights light every cluster and are left out.
+	class LightClusters
+	{
+	public:
+		static constexpr int GRID_X        = 16;
+		static constexpr int GRID_Y        = 9;
+		static constexpr int GRID_Z        = 24;
+		static constexpr int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+		static_assert(GRID_X % 4 == 0, "Rows of clusters are tested four at a time");
+
+		LightClusters()
+			: m_lists(CLUSTER_COUNT), m_clusters(2 * CLUSTER_COUNT, 0)
+		{
+		}
+
+		/// \brief Assigns lights to clusters.
+		/// \param lights The directional lights, then the point and spot lights.
+		/// \param maxIndices The most indices the lists may hold in total; lights
+		///   past it are dropped from the last clusters.
+		void build(std::vector<LightData> const& lights, std::size_t directionalCount, Mat4 const& view,
+			Mat4 const& projection, float nearDistance, float farDistance, std::size_t maxIndices)
+		{
+			if (projection[0][0] != m_scaleX || projection[1][1] != m_scaleY
+				|| nearDistance != m_near || farDistance != m_far)
+			{
+				buildBoxes(projection[0][0], projection[1][1], nearDistance, farDistance);
+			}
+
+			m_bounds.resize(lights.size() - directionalCount);
+			JobSystem::get().parallelFor(0, m_bounds.size(), BOUNDS_GRAIN,
+				[&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i = begin; i < end; ++i)
+					{
+						m_bounds[i] = bound(lights[directionalCount + i], view);
+					}
+				});
+
+			JobSystem::get().parallelFor(0, GRID_Z, 1, [this, directionalCount](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t z = begin; z < end; ++z)
+					{
+						fillSlice(static_cast<int>(z), directionalCount);
+					}
+				});
+
+			// Lay the lists out one after the other
+			std::size_t offset = 0;
+			for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+			{
+				std::size_t count = std::min(m_lists[cluster].size(), maxIndices - offset);
+				m_clusters[2 * cluster]     = static_cast<std::uint32_t>(offset);
+				m_clusters[2 * cluster + 1] = static_cast<std::uint32_t>(count);
+				offset += count;
+			}
+			m_indices.resize(offset);
+			JobSystem::get().parallelFor(0, CLUSTER_COUNT, GRID_X * GRID_Y, [this](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t cluster = begin; cluster < end; ++cluster)
+					{
+						std::copy_n(m_lists[cluster].begin(), m_clusters[2 * cluster + 1],
+							m_indices.begin() + m_clusters[2 * cluster]);
+					}
+				});
+		}
+
+		/// \return The offset into indices() and the light count of every
+		///   cluster, indexed by (z * GRID_Y + y) * GRID_X + x.
+		std::vector<std::uint32_t> const& clusters() const
+		{
+			return m_clusters;
+		}
+
+		/// \return The light indices of all clusters.
+		std::vector<std::uint32_t> const& indices() const
+		{
+			return m_indices;
+		}
+
+		// The depth slice of a view depth d is floor(log(d) * scale + bias)
+		float sliceScale() const
+		{
+			return m_sliceScale;
+		}
+
+		float sliceBias() const
+		{
+			return m_sliceBias;
+		}
+
+	private:
+		// A light bounded in view space
+		struct Bounds
+		{
+			float x, y, z, radius;
+			// Unit cone axis, and the cone half angle; spot lights only
+			float axisX, axisY, axisZ, cosAngle, sinAngle;
+			bool  cone;
+			// Inclusive cluster ranges; empty when the light is out of view
+			int   minSlice, maxSlice, minTileX, maxTileX, minTileY, maxTileY;
+		};
+
+		static constexpr std::size_t BOUNDS_GRAIN = 256;
+
+		int slice(float depth) const
+		{
+			int slice = static_cast<int>(std::floor(std::log(depth) * m_sliceScale + m_sliceBias));
+			return std::clamp(slice, 0, GRID_Z - 1);
+		}
+
+		static int tile(float ndc, int tiles)
+		{
+			int tile = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+			return std::clamp(tile, 0, tiles - 1);
+		}
+
+		// The view space boxes of the clusters, and the spheres around them
+		void buildBoxes(float scaleX, float scaleY, float nearDistance, float farDistance)
+		{
+			m_scaleX = scaleX;
+			m_scaleY = scaleY;
+			m_near   = nearDistance;
+			m_far    = farDistance;
+			float logDepthRatio = std::log(farDistance / nearDistance);
+			m_sliceScale = GRID_Z / logDepthRatio;
+			m_sliceBias  = -GRID_Z * std::log(nearDistance) / logDepthRatio;
+
+			for (std::vector<float>* box : { &m_minX, &m_maxX, &m_minY, &m_maxY, &m_minZ, &m_maxZ })
+			{
+				box->resize(CLUSTER_COUNT);
+			}
+			m_spheres.resize(CLUSTER_COUNT);
+			for (int z = 0; z < GRID_Z; ++z)
+			{
+				float nearDepth = nearDistance * std::pow(farDistance / nearDistance, float(z) / GRID_Z);
+				float farDepth  = nearDistance * std::pow(farDistance / nearDistance, float(z + 1) / GRID_Z);
+				for (int y = 0; y < GRID_Y; ++y)
+				{
+					float bottom = -1.0f + 2.0f * y / GRID_Y;
+					float top    = -1.0f + 2.0f * (y + 1) / GRID_Y;
+					for (int x = 0; x < GRID_X; ++x)
+					{
+						float left  = -1.0f + 2.0f * x / GRID_X;
+						float right = -1.0f + 2.0f * (x + 1) / GRID_X;
+						int cluster = (z * GRID_Y + y) * GRID_X + x;
+						// A view space point at depth d projects to x * scaleX / d
+						m_minX[cluster] = std::min(left * nearDepth, left * farDepth) / scaleX;
+						m_maxX[cluster] = std::max(right * nearDepth, right * farDepth) / scaleX;
+						m_minY[cluster] = std::min(bottom * nearDepth, bottom * farDepth) / scaleY;
+						m_maxY[cluster] = std::max(top * nearDepth, top * farDepth) / scaleY;
+						m_minZ[cluster] = -farDepth;
+						m_maxZ[cluster] = -nearDepth;
+						Vec3 minimum(m_minX[cluster], m_minY[cluster], m_minZ[cluster]);
+						Vec3 maximum(m_maxX[cluster], m_maxY[cluster], m_maxZ[cluster]);
+						m_spheres[cluster] = Vec4((minimum + maximum) * 0.5f, (maximum - minimum).length() * 0.5f);
+					}
+				}
+			}
+		}
+
+		Bounds bound(LightData const& light, Mat4 const& view) const
+		{
+			Bounds bounds = {};
+			bounds.minSlice = 0;
+			bounds.maxSlice = -1;
+			Vec3 center = view.transformAffine(Vec3(light.position[0], light.position[1], light.position[2]));
+			float radius = light.range;
+			float minDepth = -center.z - radius;
+			float maxDepth = -center.z + radius;
+			if (radius <= 0.0f || maxDepth <= m_near || minDepth >= m_far)
+			{
+				return bounds;
+			}
+
+			bounds.minTileX = 0;
+			bounds.maxTileX = GRID_X - 1;
+			bounds.minTileY = 0;
+			bounds.maxTileY = GRID_Y - 1;
+			if (minDepth > m_near)
+			{
+				// The sphere is in front of the camera: project its box, taking
+				// each side at the depth that spreads it the most
+				float left   = center.x - radius;
+				float right  = center.x + radius;
+				float bottom = center.y - radius;
+				float top    = center.y + radius;
+				float minX = m_scaleX * left   / (left   < 0.0f ? minDepth : maxDepth);
+				float maxX = m_scaleX * right  / (right  > 0.0f ? minDepth : maxDepth);
+				float minY = m_scaleY * bottom / (bottom < 0.0f ? minDepth : maxDepth);
+				float maxY = m_scaleY * top    / (top    > 0.0f ? minDepth : maxDepth);
+				if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+				{
+					return bounds;
+				}
+				bounds.minTileX = tile(minX, GRID_X);
+				bounds.maxTileX = tile(maxX, GRID_X);
+				bounds.minTileY = tile(minY, GRID_Y);
+				bounds.maxTileY = tile(maxY, GRID_Y);
+			}
+			bounds.minSlice = slice(std::max(minDepth, m_near));
+			bounds.maxSlice = slice(std::min(maxDepth, m_far));
+			bounds.x      = center.x;
+			bounds.y      = center.y;
+			bounds.z      = center.z;
+			bounds.radius = radius;
+
+			if (light.type == LightType::SPOT)
+			{
+				// The shader compares against the unnormalized direction, which
+				// scales the cutoff
+				Vec3 axis(light.direction[0], light.direction[1], light.direction[2]);
+				axis = Vec3(view[0][0] * axis.x + view[0][1] * axis.y + view[0][2] * axis.z,
+					view[1][0] * axis.x + view[1][1] * axis.y + view[1][2] * axis.z,
+					view[2][0] * axis.x + view[2][1] * axis.y + view[2][2] * axis.z);
+				float length = axis.length();
+				if (length > 0.0f && light.cutoffCosAngle / length > 0.0f)
+				{
+					axis /= length;
+					bounds.cone     = true;
+					bounds.axisX    = axis.x;
+					bounds.axisY    = axis.y;
+					bounds.axisZ    = axis.z;
+					bounds.cosAngle = std::min(light.cutoffCosAngle / length, 1.0f);
+					bounds.sinAngle = std::sqrt(1.0f - bounds.cosAngle * bounds.cosAngle);
+				}
+			}
+			return bounds;
+		}
+
+		// Whether a cone can reach the sphere around a cluster
+		bool coneTouches(Bounds const& bounds, int cluster) const
+		{
+			Vec4 const& sphere = m_spheres[cluster];
+			float x = sphere.x - bounds.x;
+			float y = sphere.y - bounds.y;
+			float z = sphere.z - bounds.z;
+			float alongAxis = x * bounds.axisX + y * bounds.axisY + z * bounds.axisZ;
+			float acrossAxis = std::sqrt(std::max(x * x + y * y + z * z - alongAxis * alongAxis, 0.0f));
+			float distance = bounds.cosAngle * acrossAxis - bounds.sinAngle * alongAxis;
+			return distance <= sphere.w && alongAxis <= sphere.w + bounds.radius && alongAxis >= -sphere.w;
+		}
+
+		// Bit i is set if the sphere touches the box of cluster first + i
+		int sphereTouches4(Bounds const& bounds, int first) const
+		{
+#ifdef VENUS_CLUSTER_SSE
+			__m128 zero = _mm_setzero_ps();
+			__m128 distanceSq = zero;
+			float const* minimum[3] = { &m_minX[first], &m_minY[first], &m_minZ[first] };
+			float const* maximum[3] = { &m_maxX[first], &m_maxY[first], &m_maxZ[first] };
+			float const  center[3]  = { bounds.x, bounds.y, bounds.z };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				__m128 c = _mm_set1_ps(center[axis]);
+				__m128 below = _mm_sub_ps(_mm_loadu_ps(minimum[axis]), c);
+				__m128 above = _mm_sub_ps(c, _mm_loadu_ps(maximum[axis]));
+				__m128 outside = _mm_max_ps(_mm_max_ps(below, above), zero);
+				distanceSq = _mm_add_ps(distanceSq, _mm_mul_ps(outside, outside));
+			}
+			__m128 radiusSq = _mm_set1_ps(bounds.radius * bounds.radius);
+			return _mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq));
+#else
+			int mask = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				int cluster = first + i;
+				float x = std::max({ m_minX[cluster] - bounds.x, bounds.x - m_maxX[cluster], 0.0f });
+				float y = std::max({ m_minY[cluster] - bounds.y, bounds.y - m_maxY[cluster], 0.0f });
+				float z = std::max({ m_minZ[cluster] - bounds.z, bounds.z - m_maxZ[cluster], 0.0f });
+				if (x * x + y * y + z * z <= bounds.radius * bounds.radius)
+				{
+					mask |= 1 << i;
+				}
+			}
+			return mask;
+#endif
+		}
+
+		// Fills the lists of the clusters of one depth slice
+		void fillSlice(int z, std::size_t directionalCount)
+		{
+			for (int cluster = z * GRID_X * GRID_Y; cluster < (z + 1) * GRID_X * GRID_Y; ++cluster)
+			{
+				m_lists[cluster].clear();
+			}
+			for (std::size_t i = 0; i < m_bounds.size(); ++i)
+			{
+				Bounds const& bounds = m_bounds[i];
+				if (z < bounds.minSlice || z > bounds.maxSlice)
+				{
+					continue;
+				}
+				std::uint32_t index = static_cast<std::uint32_t>(directionalCount + i);
+				for (int y = bounds.minTileY; y <= bounds.maxTileY; ++y)
+				{
+					int row = (z * GRID_Y + y) * GRID_X;
+					for (int x = bounds.minTileX & ~3; x <= bounds.maxTileX; x += 4)
+					{
+						int mask = sphereTouches4(bounds, row + x);
+						for (int bit = 0; bit < 4; ++bit)
+						{
+							int cluster = row + x + bit;
+							if ((mask & (1 << bit)) && x + bit >= bounds.minTileX && x + bit <= bounds.maxTileX
+								&& (!bounds.cone || coneTouches(bounds, cluster)))
+							{
+								m_lists[cluster].push_back(index);
+							}
+						}
+					}
+				}
+			}
+		}
+
+	private:
+		// The projection the boxes were built for
+		float m_scaleX     = 0.0f;
+		float m_scaleY     = 0.0f;
+		float m_near       = 0.0f;
+		float m_far        = 0.0f;
+		float m_sliceScale = 0.0f;
+		float m_sliceBias  = 0.0f;
+		// Cluster boxes in view space, one array per bound so that neighbouring
+		// clusters load together
+		std::vector<float> m_minX, m_maxX, m_minY, m_maxY, m_minZ, m_maxZ;
+		std::vector<Vec4>  m_spheres;
+
+		std::vector<Bounds>                     m_bounds;
+		// Light indices per cluster, kept between frames to reuse their memory
+		std::vector<std::vector<std::uint32_t>> m_lists;
+		std::vector<std::uint32_t>              m_clusters;
+		std::vector<std::uint32_t>              m_indices;
+	};
+}
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/LightSource.h"
+#include "Render/LightBlock.h"
+#include "Render/RenderQueue.h"
+
+namespace VenusEngine
+{
+	/// \brief Picks the lights that reach each object, so that an object
+	///   reached by at most ObjectLights::MAX_LIGHTS lights is shaded with
+	///   those alone rather than with every light of its clusters.  An object
+	///   reached by more keeps the clusters, so that no light is dropped.
+	/// The point and spot lights are binned by their range spheres into a
+	///   uniform world space grid.  An object only considers the lights of the
+	///   cells its bounds overlap; each light is reported by the first cell it
+	///   shares with the object, so none is counted twice.  A light is relevant
+	///   if its range reaches the bounds, and spot lights must also point at
+	///   the sphere around them.  The relevant lights are ranked by their
+	///   attenuated brightness at the nearest point of the bounds.
+	/// Lights that never fade are considered by every object.
+	class LightSelector
+	{
+	public:
+		/// \brief Bins the lights; the vector must outlive the selections.
+		/// \param lights The directional lights, then the point and spot lights.
+		void build(std::vector<LightData> const& lights, std::size_t directionalCount)
+		{
+			m_lights = &lights;
+			m_unbounded.clear();
+			m_cellStarts.clear();
+			m_cellLights.clear();
+			m_cells[0] = m_cells[1] = m_cells[2] = 0;
+
+			float const huge = std::numeric_limits<float>::max();
+			Vec3 minimum( huge,  huge,  huge);
+			Vec3 maximum(-huge, -huge, -huge);
+			float rangeSum = 0.0f;
+			std::size_t bounded = 0;
+			for (std::size_t i = directionalCount; i < lights.size(); ++i)
+			{
+				LightData const& light = lights[i];
+				if (light.range <= 0.0f)
+				{
+					continue;
+				}
+				if (light.range >= UNBOUNDED_RANGE)
+				{
+					m_unbounded.push_back(static_cast<std::uint32_t>(i));
+					continue;
+				}
+				Vec3 reach(light.range, light.range, light.range);
+				minimum.makeFloor(position(light) - reach);
+				maximum.makeCeil(position(light) + reach);
+				rangeSum += light.range;
+				++bounded;
+			}
+			if (bounded == 0)
+			{
+				return;
+			}
+
+			// Cells about as wide as a light, but not too many of them
+			Vec3 extent = maximum - minimum;
+			float largest = std::max({ extent.x, extent.y, extent.z });
+			m_cellSize = std::max(0.5f * rangeSum / bounded, largest / MAX_CELLS_PER_AXIS);
+			m_origin   = minimum;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				m_cells[axis] = std::clamp(static_cast<int>(std::ceil(extent[axis] / m_cellSize)), 1, MAX_CELLS_PER_AXIS);
+			}
+
+			// Count the lights of every cell, then lay the cells out one after another
+			m_cellStarts.assign(m_cells[0] * m_cells[1] * m_cells[2] + 1, 0);
+			forEachBinnedCell(directionalCount, [this](std::uint32_t, int const*, int cell) { ++m_cellStarts[cell + 1]; });
+			for (std::size_t cell = 1; cell < m_cellStarts.size(); ++cell)
+			{
+				m_cellStarts[cell] += m_cellStarts[cell - 1];
+			}
+			m_cellLights.resize(m_cellStarts.back());
+			m_cellFill.assign(m_cellStarts.begin(), m_cellStarts.end() - 1);
+			forEachBinnedCell(directionalCount, [this](std::uint32_t light, int const* first, int cell)
+				{
+					CellLight& entry = m_cellLights[m_cellFill[cell]++];
+					entry.light = light;
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						entry.first[axis] = static_cast<std::uint8_t>(first[axis]);
+					}
+				});
+		}
+
+		/// \brief Picks the relevant lights for an object, or none, with a
+		///   count of -1, if there are more than ObjectLights::MAX_LIGHTS.
+		/// Safe to call from several threads at once.
+		void select(Vec3 const& boundsMin, Vec3 const& boundsMax, ObjectLights& selection) const
+		{
+			selection.count = 0;
+			float weights[ObjectLights::MAX_LIGHTS];
+			Vec3 center = (boundsMin + boundsMax) * 0.5f;
+			float radius = (boundsMax - boundsMin).length() * 0.5f;
+			bool overflowed = false;
+			auto consider = [&](std::uint32_t index)
+				{
+					if (overflowed)
+					{
+						return;
+					}
+					float weight = relevance((*m_lights)[index], boundsMin, boundsMax, center, radius);
+					if (weight <= 0.0f)
+					{
+						return;
+					}
+					if (selection.count == ObjectLights::MAX_LIGHTS)
+					{
+						overflowed = true;
+						return;
+					}
+					insert(selection, weights, static_cast<std::int32_t>(index), weight);
+				};
+			forEachLightNear(boundsMin, boundsMax, consider);
+			if (overflowed)
+			{
+				// The shader falls back to the lights of the clusters
+				selection.count = -1;
+			}
+		}
+
+	private:
+		// Calls consider once with every light binned into the cells the box
+		// overlaps, and with every light that never fades
+		template <typename Consider>
+		void forEachLightNear(Vec3 const& boundsMin, Vec3 const& boundsMax, Consider& consider) const
+		{
+
+			for (std::uint32_t index : m_unbounded)
+			{
+				consider(index);
+			}
+			if (m_cellStarts.empty())
+			{
+				return;
+			}
+			int first[3], last[3];
+			if (!cellRange(boundsMin, boundsMax, first, last))
+			{
+				return;
+			}
+			for (int z = first[2]; z <= last[2]; ++z)
+			{
+				for (int y = first[1]; y <= last[1]; ++y)
+				{
+					for (int x = first[0]; x <= last[0]; ++x)
+					{
+						int cell = (z * m_cells[1] + y) * m_cells[0] + x;
+						for (std::uint32_t i = m_cellStarts[cell]; i < m_cellStarts[cell + 1]; ++i)
+						{
+							CellLight const& entry = m_cellLights[i];
+							// Only the first cell shared with the object reports the light
+							if (x == std::max<int>(first[0], entry.first[0]) && y == std::max<int>(first[1], entry.first[1])
+								&& z == std::max<int>(first[2], entry.first[2]))
+							{
+								consider(entry.light);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		// Lights reaching this far are treated as never fading
+		static constexpr float UNBOUNDED_RANGE    = 1.0e6f;
+		static constexpr int   MAX_CELLS_PER_AXIS = 32;
+
+		static Vec3 position(LightData const& light)
+		{
+			return Vec3(light.position);
+		}
+
+		// The cells a box overlaps, clamped to the grid
+		// \return false if the box misses the grid
+		bool cellRange(Vec3 const& boxMin, Vec3 const& boxMax, int* first, int* last) const
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float low  = (boxMin[axis] - m_origin[axis]) / m_cellSize;
+				float high = (boxMax[axis] - m_origin[axis]) / m_cellSize;
+				if (high < 0.0f || low >= m_cells[axis])
+				{
+					return false;
+				}
+				first[axis] = std::clamp(static_cast<int>(std::floor(low)), 0, m_cells[axis] - 1);
+				last[axis]  = std::clamp(static_cast<int>(std::floor(high)), 0, m_cells[axis] - 1);
+			}
+			return true;
+		}
+
+		// A light binned into a cell, and the first cell of its range
+		struct CellLight
+		{
+			std::uint32_t light;
+			std::uint8_t  first[3];
+		};
+
+		template <typename Callback>
+		void forEachBinnedCell(std::size_t directionalCount, Callback&& callback) const
+		{
+			for (std::size_t i = directionalCount; i < m_lights->size(); ++i)
+			{
+				LightData const& light = (*m_lights)[i];
+				if (light.range <= 0.0f || light.range >= UNBOUNDED_RANGE)
+				{
+					continue;
+				}
+				int first[3], last[3];
+				Vec3 reach(light.range, light.range, light.range);
+				cellRange(position(light) - reach, position(light) + reach, first, last);
+				for (int z = first[2]; z <= last[2]; ++z)
+				{
+					for (int y = first[1]; y <= last[1]; ++y)
+					{
+						for (int x = first[0]; x <= last[0]; ++x)
+						{
+							callback(static_cast<std::uint32_t>(i), first, (z * m_cells[1] + y) * m_cells[0] + x);
+						}
+					}
+				}
+			}
+		}
+
+		// The brightness of a light at the nearest point of a box, the way
+		// GeneralShader.frag attenuates it, or 0 if it cannot reach the box
+		static float relevance(LightData const& light, Vec3 const& boundsMin, Vec3 const& boundsMax,
+			Vec3 const& center, float radius)
+		{
+			Vec3 lightPosition = position(light);
+			Vec3 nearest(std::clamp(lightPosition.x, boundsMin.x, boundsMax.x),
+				std::clamp(lightPosition.y, boundsMin.y, boundsMax.y),
+				std::clamp(lightPosition.z, boundsMin.z, boundsMax.z));
+			float distance = (nearest - lightPosition).length();
+			if (distance >= light.range)
+			{
+				return 0.0f;
+			}
+			if (light.type == LightType::SPOT && !coneTouches(light, center - lightPosition, radius))
+			{
+				return 0.0f;
+			}
+			float attenuation = 1.0f / (light.attenuationCoefficients[0]
+				+ light.attenuationCoefficients[1] * distance
+				+ light.attenuationCoefficients[2] * distance * distance);
+			float fraction = distance / light.range;
+			float window = std::clamp(1.0f - fraction * fraction * fraction * fraction, 0.0f, 1.0f);
+			float brightest = std::max({ light.diffuseIntensity[0], light.diffuseIntensity[1], light.diffuseIntensity[2] });
+			return brightest * attenuation * window * window;
+		}
+
+		// Whether the cone of a spot light can reach a sphere; offset is from
+		// the light to the sphere
+		static bool coneTouches(LightData const& light, Vec3 const& offset, float radius)
+		{
+			// The shader compares against the unnormalized direction, which
+			// scales the cutoff
+			Vec3 axis(light.direction[0], light.direction[1], light.direction[2]);
+			float length = axis.length();
+			if (length <= 0.0f || light.cutoffCosAngle / length <= 0.0f)
+			{
+				return true;
+			}
+			axis /= length;
+			float cosAngle = std::min(light.cutoffCosAngle / length, 1.0f);
+			float sinAngle = std::sqrt(1.0f - cosAngle * cosAngle);
+			float alongAxis = offset.dotProduct(axis);
+			float acrossAxis = std::sqrt(std::max(offset.squaredLength() - alongAxis * alongAxis, 0.0f));
+			return cosAngle * acrossAxis - sinAngle * alongAxis <= radius && alongAxis >= -radius;
+		}
+
+		// Keeps the selection sorted by decreasing weight, dropping the weakest
+		static void insert(ObjectLights& selection, float* weights, std::int32_t index, float weight)
+		{
+			int position = selection.count;
+			if (position == ObjectLights::MAX_LIGHTS)
+			{
+				if (weight <= weights[position - 1])
+				{
+					return;
+				}
+				--position;
+			}
+			else
+			{
+				++selection.count;
+			}
+			while (position > 0 && weights[position - 1] < weight)
+			{
+				weights[position]           = weights[position - 1];
+				selection.indices[position] = selection.indices[position - 1];
+				--position;
+			}
+			weights[position]           = weight;
+			selection.indices[position] = index;
+		}
+
+	private:
+		std::vector<LightData> const* m_lights = nullptr;
+		// Lights every object considers
+		std::vector<std::uint32_t>    m_unbounded;
+		Vec3                          m_origin;
+		float                         m_cellSize = 1.0f;
+		int                           m_cells[3] = {};
+		// The lights of cell c are m_cellLights[m_cellStarts[c], m_cellStarts[c + 1])
+		std::vector<std::uint32_t>    m_cellStarts;
+		std::vector<CellLight>        m_cellLights;
+		std::vector<std::uint32_t>    m_cellFill;
+	};
+}
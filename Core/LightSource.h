@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "Math/Vector3.h"
-#include "Render/ShaderProgram.h"
+#include "Render/LightBlock.h"
 
 namespace VenusEngine
 {
@@ -24,11 +28,11 @@ namespace VenusEngine
 		{
 		}
 
-		virtual void setUniforms(ShaderProgram& program, int lightNum)
+		/// \brief Writes this light into its slot of the light data buffer.
+		virtual void write(LightData& data) const
 		{
-			std::string name("uLights[" + std::to_string(lightNum) + "].");
-			program.setUniformVec3(name + "diffuseIntensity" , m_diffuseIntensity);
-			program.setUniformVec3(name + "specularIntensity", m_specularIntensity);
+			copy(m_diffuseIntensity , data.diffuseIntensity);
+			copy(m_specularIntensity, data.specularIntensity);
 		}
 
 		Vec3& getDiffuseIntensity()
@@ -36,11 +40,24 @@ namespace VenusEngine
 			return m_diffuseIntensity;
 		}
 
+		Vec3 const& getDiffuseIntensity() const
+		{
+			return m_diffuseIntensity;
+		}
+
 		Vec3& getSpecularIntensity()
 		{
 			return m_specularIntensity;
 		}
 
+	protected:
+		static void copy(Vec3 const& vector, float* floats)
+		{
+			floats[0] = vector.x;
+			floats[1] = vector.y;
+			floats[2] = vector.z;
+		}
+
 	private:
 		Vec3 m_diffuseIntensity;
 		Vec3 m_specularIntensity;
@@ -58,12 +75,11 @@ namespace VenusEngine
 		{
 		}
 
-		virtual void setUniforms(ShaderProgram& program, int lightNum)
+		virtual void write(LightData& data) const
 		{
-			LightSource::setUniforms(program, lightNum);
-			std::string name("uLights[" + std::to_string(lightNum) + "].");
-			program.setUniformInt( name + "type"     , LightType::DIRECTIONAL);
-			program.setUniformVec3(name + "direction", m_direction);
+			LightSource::write(data);
+			data.type = LightType::DIRECTIONAL;
+			copy(m_direction, data.direction);
 		}
 
 		Vec3& getDirection()
@@ -87,14 +103,45 @@ namespace VenusEngine
 		{
 		}
 
-		virtual void setUniforms(ShaderProgram& program, int lightNum)
+		virtual void write(LightData& data) const
+		{
+			LightSource::write(data);
+			copy(m_position               , data.position);
+			copy(m_attenuationCoefficients, data.attenuationCoefficients);
+			data.range = getRange();
+		}
+
+		/// \brief The distance at which the attenuated light falls to
+		///   RANGE_CUTOFF of its brightest diffuse component.  Shaders fade the
+		///   light out towards it, and lights are only assigned to the clusters
+		///   it reaches.
+		/// \return The range, or the largest float if the light never fades.
+		float getRange() const
 		{
-			LightSource::setUniforms(program, lightNum);
-			std::string name("uLights[" + std::to_string(lightNum) + "].");
-			program.setUniformVec3(name + "position"               , m_position);
-			program.setUniformVec3(name + "attenuationCoefficients", m_attenuationCoefficients);
+			Vec3 const& diffuse = getDiffuseIntensity();
+			float brightest = std::max({ diffuse.x, diffuse.y, diffuse.z });
+			// Solve c + l d + q d^2 = brightest / RANGE_CUTOFF for d
+			float constant  = m_attenuationCoefficients.x - brightest / RANGE_CUTOFF;
+			float linear    = m_attenuationCoefficients.y;
+			float quadratic = m_attenuationCoefficients.z;
+			if (constant >= 0.0f)
+			{
+				return 0.0f;
+			}
+			if (quadratic > 0.0f)
+			{
+				return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * constant)) / (2.0f * quadratic);
+			}
+			if (linear > 0.0f)
+			{
+				return -constant / linear;
+			}
+			return std::numeric_limits<float>::max();
 		}
 
+		// Fraction of its full brightness at which a light counts as off
+		static constexpr float RANGE_CUTOFF = 1.0f / 64.0f;
+
 		Vec3& getPosition()
 		{
 			return m_position;
@@ -122,11 +169,10 @@ namespace VenusEngine
 		{
 		}
 
-		virtual void setUniforms(ShaderProgram& program, int lightNum)
+		virtual void write(LightData& data) const
 		{
-			LocationLightSource::setUniforms(program, lightNum);
-			std::string name("uLights[" + std::to_string(lightNum) + "].");
-			program.setUniformInt(name + "type", LightType::POINT);
+			LocationLightSource::write(data);
+			data.type = LightType::POINT;
 		}
 	};
 
@@ -142,14 +188,13 @@ namespace VenusEngine
 		{
 		}
 
-		virtual void setUniforms(ShaderProgram& program, int lightNum)
+		virtual void write(LightData& data) const
 		{
-			LocationLightSource::setUniforms(program, lightNum);
-			std::string name("uLights[" + std::to_string(lightNum) + "].");
-			program.setUniformInt(  name + "type"          , LightType::SPOT);
-			program.setUniformVec3( name + "direction"     , m_direction);
-			program.setUniformFloat(name + "cutoffCosAngle", m_cutoffCosAngle);
-			program.setUniformFloat(name + "falloff"       , m_falloff);
+			LocationLightSource::write(data);
+			data.type           = LightType::SPOT;
+			copy(m_direction, data.direction);
+			data.cutoffCosAngle = m_cutoffCosAngle;
+			data.falloff        = m_falloff;
 		}
 
 		Vec3& getDirection()
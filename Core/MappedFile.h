@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VenusEngine
+{
+	/// \brief A read-only view of a whole file mapped into memory.
+	/// Pages are read by the OS when first touched, so opening a file costs the
+	///   same regardless of its size, and parts that are never read are never
+	///   loaded.  The mapping starts on a page boundary.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		MappedFile(MappedFile const&) = delete;
+
+		MappedFile& operator=(MappedFile const&) = delete;
+
+		/// \brief Maps the file at path, replacing any file mapped before.
+		/// \return false if the file cannot be opened or is empty.
+		bool open(std::string const& path)
+		{
+			close();
+#ifdef _WIN32
+			m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			LARGE_INTEGER size;
+			if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+			{
+				close();
+				return false;
+			}
+			m_size    = static_cast<std::size_t>(size.QuadPart);
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			m_data    = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+			m_file = ::open(path.c_str(), O_RDONLY);
+			struct stat status;
+			if (m_file < 0 || fstat(m_file, &status) != 0 || status.st_size == 0)
+			{
+				close();
+				return false;
+			}
+			m_size = static_cast<std::size_t>(status.st_size);
+			m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+			if (m_data == MAP_FAILED)
+			{
+				m_data = nullptr;
+			}
+#endif
+			if (!m_data)
+			{
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void close()
+		{
+#ifdef _WIN32
+			if (m_data)
+			{
+				UnmapViewOfFile(m_data);
+			}
+			if (m_mapping)
+			{
+				CloseHandle(m_mapping);
+			}
+			if (m_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(m_file);
+			}
+			m_mapping = nullptr;
+			m_file    = INVALID_HANDLE_VALUE;
+#else
+			if (m_data)
+			{
+				munmap(m_data, m_size);
+			}
+			if (m_file >= 0)
+			{
+				::close(m_file);
+			}
+			m_file = -1;
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		bool isOpen() const
+		{
+			return m_data != nullptr;
+		}
+
+		std::uint8_t const* data() const
+		{
+			return static_cast<std::uint8_t const*>(m_data);
+		}
+
+		std::size_t size() const
+		{
+			return m_size;
+		}
+
+	private:
+#ifdef _WIN32
+		HANDLE m_file    = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+#else
+		int    m_file    = -1;
+#endif
+		void*       m_data = nullptr;
+		std::size_t m_size = 0;
+	};
+}
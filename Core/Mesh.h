@@ -1,24 +1,38 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "Render/ShaderProgram.h"
 #include "Render/VertexArray.h"
 #include "Render/VertexBuffer.h"
+#include "Render/RingBuffer.h"
 #include "Math/MathHeaders.h"
-#include "Core/ID.h"
 
 namespace VenusEngine
 {
 	class Mesh
 	{
 	public:
+		// 3 float position, 3 float normal, 3 float color
+		using Layout = MeshVertexLayout;
+
+		/// \brief Geometry decoded away from the GL thread, ready to be taken over
+		///   by a Mesh.
+		struct Data
+		{
+			std::vector<float>        vertices;
+			std::vector<unsigned int> indices;
+			Vec3                      localMin;
+			Vec3                      localMax;
+			// Only extracted for meshes used as occluders
+			std::shared_ptr<std::vector<float> const> occluderPositions;
+		};
+
 		/// \brief Constructs an empty Mesh with no triangles.
 		/// \post A unique VAO and VBO have been generated for this Mesh and stored
 		///   for later use.
-		Mesh() : m_id(ID::generateID())
-		{
-		}
+		Mesh() = default;
 
 		/// \brief Destructs this Mesh.
 		/// \post The VAO and VBO associated with this Mesh have been deleted.
@@ -44,17 +58,43 @@ namespace VenusEngine
 		/// \brief Copies this Mesh's geometry into this Mesh's VBO an d sets up its
 		///   VAO.
 		/// \pre This Mesh has not yet been prepared.
-		/// \post The first two vertex attributes have been enabled, with
-		///   interleaved 3-part positions and 3-part colors.
+		/// \post The attributes of this Mesh's vertex Layout have been enabled.
 		/// \post This Mesh's geometry has been copied to its VBO.
+		/// \post The local bounds of this Mesh have been computed.
 		void prepareVao()
 		{
-			m_vertexArray.bind();
-			m_vertexBuffer.bind();
-			m_vertexBuffer.bufferData(m_vertices.size() * sizeof(float), m_vertices.data(), GL_STATIC_DRAW);
-			enableAttributes();
-			m_vertexBuffer.unbind();
-			m_vertexArray.unbind();
+			computeLocalBounds();
+			uploadVao(m_vertices.data());
+		}
+
+		/// \brief Fills this Mesh's VBO straight from vertex data that is already
+		///   laid out for it, e.g. a blob of a memory-mapped scene file.
+		/// \param[in] vertices floatCount floats in this Mesh's vertex Layout.
+		/// \param[in] localMin,localMax The bounds of the vertex positions.
+		/// \pre This Mesh has no vertices and has not yet been prepared.
+		/// \post This Mesh has been prepared; its geometry store holds a copy of
+		///   the vertices for editing.
+		void prepareVao(float const* vertices, std::size_t floatCount, Vec3 const& localMin, Vec3 const& localMax)
+		{
+			m_vertices.assign(vertices, vertices + floatCount);
+			m_localMin = localMin;
+			m_localMax = localMax;
+			uploadVao(vertices);
+		}
+
+		/// \brief Takes over decoded geometry and allocates the VBO without filling
+		///   it; the vertices are then streamed in with streamVertices, possibly
+		///   over several frames.
+		/// \pre This Mesh has not yet been prepared.
+		/// \post The attributes of this Mesh's vertex Layout have been enabled.
+		void allocateVao(Data&& data)
+		{
+			m_vertices          = std::move(data.vertices);
+			m_indices           = std::move(data.indices);
+			m_localMin          = data.localMin;
+			m_localMax          = data.localMax;
+			m_occluderPositions = std::move(data.occluderPositions);
+			uploadVao(nullptr);
 		}
 
 		/// \brief Adds additional triangles to this Mesh.
@@ -73,95 +113,195 @@ namespace VenusEngine
 
 		/// \brief Gets the number of floats used to represent each vertex.
 		/// \return The number of floats used for each vertex.
-		std::size_t getFloatsPerVertex() const
+		static constexpr std::size_t getFloatsPerVertex()
+		{
+			return Layout::STRIDE / sizeof(float);
+		}
+
+		/// \brief Makes a Mesh of the same geometry that can be edited apart
+		///   from this one, e.g. by an entity that shares this Mesh.
+		/// \pre This Mesh has been prepared.
+		/// \post The copy has been prepared.
+		std::shared_ptr<Mesh> clone() const
 		{
-			return 9ULL;
+			std::shared_ptr<Mesh> copy = std::make_shared<Mesh>();
+			copy->m_vertices          = m_vertices;
+			copy->m_indices           = m_indices;
+			copy->m_localMin          = m_localMin;
+			copy->m_localMax          = m_localMax;
+			copy->m_occluderPositions = m_occluderPositions;
+			copy->uploadVao(copy->m_vertices.data());
+			return copy;
 		}
 
-		// reset color of all vertices to color of the first vertex
-		void resetColorToFirst()
+		/// \brief Gives every vertex the color.
+		/// \post The next uploadVertices uploads the change.
+		void setColor(Vec3 const& color)
 		{
-			if (m_vertices[9 + 6] == m_vertices[6] &&
-				m_vertices[9 + 7] == m_vertices[7] &&
-				m_vertices[9 + 8] == m_vertices[8])
+			for (std::size_t i = COLOR_OFFSET; i < m_vertices.size(); i += getFloatsPerVertex())
+			{
+				m_vertices[i + 0] = color.x;
+				m_vertices[i + 1] = color.y;
+				m_vertices[i + 2] = color.z;
+			}
+			m_verticesDirty = true;
+		}
+
+		/// \return The color of the first vertex, which is that of every vertex
+		///   once setColor has been called.
+		Vec3 getColor() const
+		{
+			return m_vertices.empty() ? Vec3::ZERO : Vec3(&m_vertices[COLOR_OFFSET]);
+		}
+
+		/// \brief Uploads vertex edits made since the last upload.
+		/// \param[in] streamBuffer The per-frame ring buffer the new data is staged in.
+		/// \pre This Mesh has been prepared.
+		/// \post The VBO matches this Mesh's geometry store.
+		/// If the ring buffer is full for this frame, the data is uploaded directly.
+		void uploadVertices(RingBuffer& streamBuffer)
+		{
+			if (!m_verticesDirty)
 			{
-				// assume all vertices after the first vertex have the same color
-				// return directly if the color don't need to change
 				return;
 			}
-			for (std::size_t i = 9ULL; i < m_vertices.size(); i += getFloatsPerVertex())
+			GLsizeiptr size = static_cast<GLsizeiptr>(m_vertices.size() * sizeof(float));
+			RingBuffer::Allocation allocation = streamBuffer.write(m_vertices.data(), size);
+			if (allocation.valid())
+			{
+				m_vertexBuffer.copySubData(streamBuffer.id(), allocation.offset, 0, size);
+			}
+			else
 			{
-				m_vertices[i + 6ULL] = m_vertices[6];
-				m_vertices[i + 7ULL] = m_vertices[7];
-				m_vertices[i + 8ULL] = m_vertices[8];
+				m_vertexBuffer.bind();
+				m_vertexBuffer.bufferSubData(0, size, m_vertices.data());
+				m_vertexBuffer.unbind();
 			}
-			prepareVao();
+			m_verticesDirty = false;
 		}
 
-		/// \brief Draws this Mesh in OpenGL.
-		/// \param[in] shaderProgram A pointer to the ShaderProgram that should
-		///   be used.
+		/// \brief Copies a byte range of the geometry store to the VBO through the
+		///   ring buffer, without stalling on the GPU.
+		/// \pre allocateVao has been called.
+		/// \return false if the ring buffer has no room left this frame.
+		bool streamVertices(RingBuffer& streamBuffer, GLintptr offset, GLsizeiptr size)
+		{
+			RingBuffer::Allocation allocation =
+				streamBuffer.write(reinterpret_cast<char const*>(m_vertices.data()) + offset, size);
+			if (!allocation.valid())
+			{
+				return false;
+			}
+			m_vertexBuffer.copySubData(streamBuffer.id(), allocation.offset, offset, size);
+			return true;
+		}
+
+		/// \brief Gets the VAO drawing this Mesh's triangles.
 		/// \pre This Mesh has been prepared.
-		/// \post While the ShaderProgram was enabled, the viewMatrix has been set as
-		///   the "uModelView" uniform matrix and the geometry has been drawn.
-		void draw(ShaderProgram& shaderProgram)
+		VertexArray& getVertexArray()
 		{
-			shaderProgram.enable();
+			return m_vertexArray;
+		}
 
-			shaderProgram.setUniformMat4("uWorld", m_transform.getMatrix());
-			shaderProgram.setUniformInt("objectID", m_id);
+		/// \brief Gets this Mesh's geometry store, in its vertex Layout.
+		std::vector<float> const& getVertices() const
+		{
+			return m_vertices;
+		}
 
-			m_vertexArray.bind();
-			// 3 float position, 3 float normal, 3 float color
-			glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(m_vertices.size()) / getFloatsPerVertex());
-			m_vertexArray.unbind();
+		std::vector<unsigned int> const& getIndices() const
+		{
+			return m_indices;
+		}
 
-			shaderProgram.disable();
+		GLsizei getVertexCount() const
+		{
+			return static_cast<GLsizei>(m_vertices.size() / getFloatsPerVertex());
 		}
 
-		/// \brief Gets the mesh's world matrix.
-		/// \return The world matrix.
-		Transform& getTransform()
+		/// \brief Gets the axis-aligned bounds of this Mesh's vertices.
+		/// \pre This Mesh has been prepared.
+		Vec3 const& getLocalMin() const
 		{
-			return m_transform;
+			return m_localMin;
 		}
 
-		unsigned getID() const
+		Vec3 const& getLocalMax() const
 		{
-			return m_id;
+			return m_localMax;
 		}
 
-		// Return the color of the first vertex(assume all vertices have the same color)
-		float* getFirstColorPtr()
+		/// \brief Gets the triangle positions rasterized when this Mesh is an
+		///   occluder: 3 floats per vertex, 3 vertices per triangle.  They are
+		///   extracted the first time, so meshes never used as occluders keep
+		///   no second copy of their positions.
+		/// \pre This Mesh has been prepared.
+		std::shared_ptr<std::vector<float> const> const& getOccluderPositions()
 		{
-			return &m_vertices[6];
+			if (!m_occluderPositions)
+			{
+				m_occluderPositions = extractPositions(m_vertices.data(), m_vertices.size());
+			}
+			return m_occluderPositions;
 		}
 
-	private:
-		/// \brief Enables VAO attributes.
-		/// \pre This Mesh's VAO has been bound.
-		/// \post Any attributes (positions, colors, normals, texture coordinates)
-		///   have been enabled and configured.
-		/// This should only be called from the middle of prepareVao().
-		void enableAttributes()
+		/// \brief Gets the positions of vertices in this Mesh's vertex Layout, 3
+		///   floats per vertex.  Does not touch GL, so any thread may call it.
+		static std::shared_ptr<std::vector<float> const> extractPositions(float const* vertices, std::size_t floatCount)
 		{
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, getFloatsPerVertex() * sizeof(float), reinterpret_cast<void*>(0));
+			auto positions = std::make_shared<std::vector<float>>();
+			positions->reserve(floatCount / getFloatsPerVertex() * 3);
+			for (std::size_t i = 0; i < floatCount; i += getFloatsPerVertex())
+			{
+				positions->insert(positions->end(), vertices + i, vertices + i + 3);
+			}
+			return positions;
+		}
 
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, getFloatsPerVertex() * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
+	private:
+		void uploadVao(float const* vertices)
+		{
+			m_vertexArray.bind();
+			m_vertexBuffer.bind();
+			m_vertexBuffer.bufferData(m_vertices.size() * sizeof(float), vertices, GL_STATIC_DRAW);
+			m_vertexArray.setLayout<Layout>();
+			m_vertexBuffer.unbind();
+			m_vertexArray.unbind();
+			m_verticesDirty = false;
+		}
 
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, getFloatsPerVertex() * sizeof(float), reinterpret_cast<void*>(6 * sizeof(float)));
+		void computeLocalBounds()
+		{
+			m_localMin = Vec3::ZERO;
+			m_localMax = Vec3::ZERO;
+			if (m_vertices.empty())
+			{
+				return;
+			}
+			m_localMin = Vec3(&m_vertices[0]);
+			m_localMax = m_localMin;
+			for (std::size_t i = getFloatsPerVertex(); i < m_vertices.size(); i += getFloatsPerVertex())
+			{
+				Vec3 position(&m_vertices[i]);
+				m_localMin.makeFloor(position);
+				m_localMax.makeCeil(position);
+			}
 		}
 
 	private:
+		// index of the first color component within a vertex
+		static constexpr std::size_t COLOR_OFFSET = Layout::offsetOf<VertexSemantic::Color>() / sizeof(float);
+
 		std::vector<float>        m_vertices;
 		std::vector<unsigned int> m_indices;
-		Transform                 m_transform;
 		VertexArray               m_vertexArray;
 		VertexBuffer              m_vertexBuffer;
-
-		int m_id;
+		// geometry store changed since the VBO was last written
+		bool                      m_verticesDirty = false;
+		// bounds of the positions, computed when the geometry is prepared
+		Vec3                      m_localMin;
+		Vec3                      m_localMax;
+		// Positions only, so the occlusion rasterizer reads 3 of every 9 floats less
+		std::shared_ptr<std::vector<float> const> m_occluderPositions;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Symbol.h"
+
+namespace VenusEngine
+{
+	/// \brief Maps unique names to handles, and keeps the handles sorted by
+	///   name for the outliner.
+	/// The sorted list is maintained as names are added, removed and renamed:
+	///   additions are collected and merged into the list the next time it is
+	///   read, so loading many objects costs one sort rather than one insertion
+	///   each.  Reading an up-to-date list costs nothing.
+	template <typename Handle>
+	class NameIndex
+	{
+	public:
+		struct Entry
+		{
+			Symbol name;
+			Handle handle;
+		};
+
+		/// \pre name is not in the index.
+		void insert(Symbol name, Handle handle)
+		{
+			m_handleByName.emplace(name.id(), handle);
+			m_pending.push_back({ name, handle });
+		}
+
+		/// \return false if name is not in the index.
+		bool erase(Symbol name)
+		{
+			if (m_handleByName.erase(name.id()) == 0)
+			{
+				return false;
+			}
+			auto pending = std::find_if(m_pending.begin(), m_pending.end(),
+				[name](Entry const& entry) { return entry.name == name; });
+			if (pending != m_pending.end())
+			{
+				m_pending.erase(pending);
+				return true;
+			}
+			auto sorted = std::lower_bound(m_sorted.begin(), m_sorted.end(), name, before);
+			m_sorted.erase(sorted);
+			return true;
+		}
+
+		/// \brief Renames an entry.
+		/// \pre name is in the index and newName is not.
+		void rename(Symbol name, Symbol newName)
+		{
+			Handle handle = find(name);
+			erase(name);
+			insert(newName, handle);
+		}
+
+		/// \return The handle of name, or an invalid handle.
+		Handle find(Symbol name) const
+		{
+			auto iter = m_handleByName.find(name.id());
+			return iter == m_handleByName.end() ? Handle() : iter->second;
+		}
+
+		bool contains(Symbol name) const
+		{
+			return m_handleByName.count(name.id()) != 0;
+		}
+
+		/// \return Every entry, sorted by name.
+		std::vector<Entry> const& sorted() const
+		{
+			if (!m_pending.empty())
+			{
+				std::sort(m_pending.begin(), m_pending.end(), [](Entry const& a, Entry const& b)
+					{
+						return a.name.str() < b.name.str();
+					});
+				std::size_t middle = m_sorted.size();
+				m_sorted.insert(m_sorted.end(), m_pending.begin(), m_pending.end());
+				std::inplace_merge(m_sorted.begin(), m_sorted.begin() + middle, m_sorted.end(),
+					[](Entry const& a, Entry const& b) { return a.name.str() < b.name.str(); });
+				m_pending.clear();
+			}
+			return m_sorted;
+		}
+
+		void clear()
+		{
+			m_handleByName.clear();
+			m_sorted.clear();
+			m_pending.clear();
+		}
+
+		std::size_t size() const
+		{
+			return m_handleByName.size();
+		}
+
+	private:
+		static bool before(Entry const& entry, Symbol name)
+		{
+			return entry.name.str() < name.str();
+		}
+
+	private:
+		std::unordered_map<Symbol::Id, Handle> m_handleByName;
+		// Sorted by name, and the entries added since it was last read
+		mutable std::vector<Entry>             m_sorted;
+		mutable std::vector<Entry>             m_pending;
+	};
+}
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VENUS_OCCLUSION_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include "Math/MathHeaders.h"
+#include "Core/JobSystem.h"
+
+namespace VenusEngine
+{
+	/// \brief Culls objects hidden behind occluders with a low-resolution depth
+	///   buffer rasterized on the CPU.
+	/// Each frame the occluder triangles are transformed, binned into screen
+	///   tiles and rasterized tile by tile on worker threads, keeping the nearest
+	///   depth per pixel. Every 8x8 block then stores its farthest depth (a
+	///   hierarchical Z level). An object is hidden when the nearest point of its
+	///   bounding box is farther than every block its screen rectangle touches.
+	/// Triangles crossing the near plane are skipped, which only makes the
+	///   occluders smaller, so culling stays conservative apart from the
+	///   coverage of pixels occluders only partly cover.
+	class OcclusionCuller
+	{
+	public:
+		static constexpr int WIDTH       = 256;
+		static constexpr int HEIGHT      = 128;
+		static constexpr int TILE_WIDTH  = 64;
+		static constexpr int TILE_HEIGHT = 32;
+		static constexpr int BLOCK_SIZE  = 8;
+		static constexpr int TILES_X     = WIDTH / TILE_WIDTH;
+		static constexpr int TILES_Y     = HEIGHT / TILE_HEIGHT;
+		static constexpr int BLOCKS_X    = WIDTH / BLOCK_SIZE;
+		static constexpr int BLOCKS_Y    = HEIGHT / BLOCK_SIZE;
+
+		// Triangle positions in local space, 3 floats per vertex, 3 vertices per triangle
+		using Positions = std::shared_ptr<std::vector<float> const>;
+
+		OcclusionCuller()
+			: m_depth(WIDTH * HEIGHT, 1.0f), m_hiZ(BLOCKS_X * BLOCKS_Y, 1.0f)
+		{
+		}
+
+		~OcclusionCuller()
+		{
+			wait();
+		}
+
+		OcclusionCuller(OcclusionCuller const&) = delete;
+		OcclusionCuller& operator=(OcclusionCuller const&) = delete;
+
+		/// \brief Starts collecting the occluders of a frame.
+		void begin(Mat4 const& viewProjection)
+		{
+			wait();
+			m_viewProjection = viewProjection;
+			m_occluders.clear();
+		}
+
+		void addOccluder(Mat4 const& worldMatrix, Positions const& positions)
+		{
+			m_occluders.push_back({ m_viewProjection * worldMatrix, positions });
+		}
+
+		/// \brief Rasterizes the occluders on worker threads. The depth buffer
+		///   must not be read until wait() returns.
+		void rasterizeAsync()
+		{
+			m_pending = JobSystem::get().submit([this] { rasterize(); });
+		}
+
+		void wait()
+		{
+			if (m_pending)
+			{
+				JobSystem::get().wait(m_pending);
+				m_pending.reset();
+			}
+		}
+
+		/// \return Whether any part of the box may be in front of the occluders.
+		/// \pre wait() has returned since the last rasterizeAsync().
+		bool isVisible(Vec3 const& min, Vec3 const& max) const
+		{
+			float minX, minY, maxX, maxY, nearestDepth;
+			if (!projectBox(min, max, minX, minY, maxX, maxY, nearestDepth))
+			{
+				// The box reaches behind the near plane
+				return true;
+			}
+			if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT)
+			{
+				// Off screen; left to frustum culling
+				return true;
+			}
+			int blockMinX = toPixel(minX, WIDTH) / BLOCK_SIZE;
+			int blockMinY = toPixel(minY, HEIGHT) / BLOCK_SIZE;
+			int blockMaxX = toPixel(maxX, WIDTH) / BLOCK_SIZE;
+			int blockMaxY = toPixel(maxY, HEIGHT) / BLOCK_SIZE;
+			for (int y = blockMinY; y <= blockMaxY; ++y)
+			{
+				float const* row = &m_hiZ[y * BLOCKS_X];
+				int x = blockMinX;
+#ifdef VENUS_OCCLUSION_SSE
+				__m128 depth = _mm_set1_ps(nearestDepth);
+				for (; x + 4 <= blockMaxX + 1; x += 4)
+				{
+					if (_mm_movemask_ps(_mm_cmple_ps(depth, _mm_loadu_ps(row + x))))
+					{
+						return true;
+					}
+				}
+#endif
+				for (; x <= blockMaxX; ++x)
+				{
+					if (nearestDepth <= row[x])
+					{
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		/// \return The number of occluder triangles rasterized in the last frame.
+		std::size_t rasterizedTriangles() const
+		{
+			return m_triangles.size();
+		}
+
+		/// \return The depth buffer, row by row from the bottom; 1 is far.
+		std::vector<float> const& depthBuffer() const
+		{
+			return m_depth;
+		}
+
+	private:
+		// Triangles with a vertex closer than this (in clip w) are skipped
+		static constexpr float NEAR_W = 1e-3f;
+
+		struct Occluder
+		{
+			Mat4      modelViewProjection;
+			Positions positions;
+		};
+
+		// A triangle in screen space: x and y in pixels, z in [0, 1]
+		struct ScreenTriangle
+		{
+			float x[3];
+			float y[3];
+			float z[3];
+		};
+
+		void rasterize()
+		{
+			transformAndBin();
+
+			// Tiles are independent; one per task keeps the busy ones spread out
+			JobSystem::get().parallelFor(0, TILES_X * TILES_Y, 1, [this](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t tile = begin; tile < end; ++tile)
+					{
+						rasterizeTile(static_cast<int>(tile));
+					}
+				});
+		}
+
+		void transformAndBin()
+		{
+			m_triangles.clear();
+			for (std::vector<std::uint32_t>& bin : m_bins)
+			{
+				bin.clear();
+			}
+			for (Occluder const& occluder : m_occluders)
+			{
+				std::vector<float> const& positions = *occluder.positions;
+				Mat4 const& m = occluder.modelViewProjection;
+				for (std::size_t i = 0; i + 9 <= positions.size(); i += 9)
+				{
+					ScreenTriangle triangle;
+					bool behind = false;
+					for (int v = 0; v < 3 && !behind; ++v)
+					{
+						float const* p = &positions[i + v * 3];
+						float x = m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3];
+						float y = m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3];
+						float z = m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3];
+						float w = m[3][0] * p[0] + m[3][1] * p[1] + m[3][2] * p[2] + m[3][3];
+						behind = w < NEAR_W;
+						float inverseW = 1.0f / w;
+						triangle.x[v] = (x * inverseW * 0.5f + 0.5f) * WIDTH;
+						triangle.y[v] = (y * inverseW * 0.5f + 0.5f) * HEIGHT;
+						triangle.z[v] = z * inverseW * 0.5f + 0.5f;
+					}
+					if (!behind)
+					{
+						bin(triangle);
+					}
+				}
+			}
+		}
+
+		// Adds a triangle to the bins of every tile its bounding box touches
+		void bin(ScreenTriangle const& triangle)
+		{
+			float minX = std::min({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			float maxX = std::max({ triangle.x[0], triangle.x[1], triangle.x[2] });
+			float minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+			float maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+			if (maxX < 0.0f || maxY < 0.0f || minX >= WIDTH || minY >= HEIGHT ||
+				std::min({ triangle.z[0], triangle.z[1], triangle.z[2] }) > 1.0f)
+			{
+				return;
+			}
+			int tileMinX = toPixel(minX, WIDTH) / TILE_WIDTH;
+			int tileMinY = toPixel(minY, HEIGHT) / TILE_HEIGHT;
+			int tileMaxX = toPixel(maxX, WIDTH) / TILE_WIDTH;
+			int tileMaxY = toPixel(maxY, HEIGHT) / TILE_HEIGHT;
+			std::uint32_t index = static_cast<std::uint32_t>(m_triangles.size());
+			m_triangles.push_back(triangle);
+			for (int y = tileMinY; y <= tileMaxY; ++y)
+			{
+				for (int x = tileMinX; x <= tileMaxX; ++x)
+				{
+					m_bins[y * TILES_X + x].push_back(index);
+				}
+			}
+		}
+
+		void rasterizeTile(int tile)
+		{
+			int tileX = (tile % TILES_X) * TILE_WIDTH;
+			int tileY = (tile / TILES_X) * TILE_HEIGHT;
+			for (int y = tileY; y < tileY + TILE_HEIGHT; ++y)
+			{
+				std::fill_n(&m_depth[y * WIDTH + tileX], TILE_WIDTH, 1.0f);
+			}
+			for (std::uint32_t index : m_bins[tile])
+			{
+				rasterizeTriangle(m_triangles[index], tileX, tileY);
+			}
+			// Farthest depth of every block of the tile
+			for (int blockY = tileY / BLOCK_SIZE; blockY < (tileY + TILE_HEIGHT) / BLOCK_SIZE; ++blockY)
+			{
+				for (int blockX = tileX / BLOCK_SIZE; blockX < (tileX + TILE_WIDTH) / BLOCK_SIZE; ++blockX)
+				{
+					float farthest = 0.0f;
+					for (int y = blockY * BLOCK_SIZE; y < (blockY + 1) * BLOCK_SIZE; ++y)
+					{
+						float const* row = &m_depth[y * WIDTH + blockX * BLOCK_SIZE];
+						farthest = std::max(farthest, *std::max_element(row, row + BLOCK_SIZE));
+					}
+					m_hiZ[blockY * BLOCKS_X + blockX] = farthest;
+				}
+			}
+		}
+
+		// Rasterizes the part of a triangle inside a tile, keeping the nearest depth
+		void rasterizeTriangle(ScreenTriangle const& triangle, int tileX, int tileY)
+		{
+			float x0 = triangle.x[0], y0 = triangle.y[0];
+			float x1 = triangle.x[1], y1 = triangle.y[1];
+			float x2 = triangle.x[2], y2 = triangle.y[2];
+			float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+			if (area == 0.0f)
+			{
+				return;
+			}
+			// Both windings are drawn; flip the edge functions of clockwise triangles
+			float sign = area > 0.0f ? 1.0f : -1.0f;
+			// Edge i is inside where a * x + b * y + c >= 0
+			float a[3] = { sign * (y0 - y1), sign * (y1 - y2), sign * (y2 - y0) };
+			float b[3] = { sign * (x1 - x0), sign * (x2 - x1), sign * (x0 - x2) };
+			float c[3] = { -(a[0] * x0 + b[0] * y0), -(a[1] * x1 + b[1] * y1), -(a[2] * x2 + b[2] * y2) };
+			// Depth plane z = zA * x + zB * y + zC
+			float zA = ((triangle.z[1] - triangle.z[0]) * (y2 - y0) - (triangle.z[2] - triangle.z[0]) * (y1 - y0)) / area;
+			float zB = ((triangle.z[2] - triangle.z[0]) * (x1 - x0) - (triangle.z[1] - triangle.z[0]) * (x2 - x0)) / area;
+			float zC = triangle.z[0] - zA * x0 - zB * y0;
+
+			int minX = std::max(tileX, toPixel(std::min({ x0, x1, x2 }), WIDTH));
+			int maxX = std::min(tileX + TILE_WIDTH - 1, toPixel(std::max({ x0, x1, x2 }), WIDTH));
+			int minY = std::max(tileY, toPixel(std::min({ y0, y1, y2 }), HEIGHT));
+			int maxY = std::min(tileY + TILE_HEIGHT - 1, toPixel(std::max({ y0, y1, y2 }), HEIGHT));
+			// Align to 4 pixels; the tile bounds are multiples of 4
+			minX &= ~3;
+
+			for (int y = minY; y <= maxY; ++y)
+			{
+				float py = y + 0.5f;
+				float* row = &m_depth[y * WIDTH];
+				int x = minX;
+#ifdef VENUS_OCCLUSION_SSE
+				__m128 const zero = _mm_setzero_ps();
+				__m128 const one  = _mm_set1_ps(1.0f);
+				for (; x <= maxX; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+					__m128 inside = _mm_cmpge_ps(edge(a[0], b[0], c[0], px, py), zero);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(edge(a[1], b[1], c[1], px, py), zero));
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(edge(a[2], b[2], c[2], px, py), zero));
+					if (!_mm_movemask_ps(inside))
+					{
+						continue;
+					}
+					__m128 depth = _mm_min_ps(edge(zA, zB, zC, px, py), one);
+					__m128 old   = _mm_loadu_ps(row + x);
+					__m128 nearer = _mm_min_ps(old, depth);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+				}
+#else
+				for (; x <= maxX; ++x)
+				{
+					float px = x + 0.5f;
+					if (a[0] * px + b[0] * py + c[0] >= 0.0f &&
+						a[1] * px + b[1] * py + c[1] >= 0.0f &&
+						a[2] * px + b[2] * py + c[2] >= 0.0f)
+					{
+						row[x] = std::min(row[x], std::min(zA * px + zB * py + zC, 1.0f));
+					}
+				}
+#endif
+			}
+		}
+
+		// The pixel containing a coordinate, clamped to [0, size - 1]
+		static int toPixel(float coordinate, int size)
+		{
+			return static_cast<int>(std::max(0.0f, std::min(coordinate, static_cast<float>(size - 1))));
+		}
+
+#ifdef VENUS_OCCLUSION_SSE
+		static __m128 edge(float a, float b, float c, __m128 px, float py)
+		{
+			return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a), px), _mm_set1_ps(b * py + c));
+		}
+#endif
+
+		// Projects the corners of a box to the screen.
+		// \return false if a corner is behind the near plane.
+		bool projectBox(Vec3 const& min, Vec3 const& max, float& minX, float& minY, float& maxX, float& maxY,
+			float& nearestDepth) const
+		{
+			Mat4 const& m = m_viewProjection;
+			minX = minY = nearestDepth = std::numeric_limits<float>::max();
+			maxX = maxY = -std::numeric_limits<float>::max();
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				float px = (corner & 1) ? max.x : min.x;
+				float py = (corner & 2) ? max.y : min.y;
+				float pz = (corner & 4) ? max.z : min.z;
+				float w = m[3][0] * px + m[3][1] * py + m[3][2] * pz + m[3][3];
+				if (w < NEAR_W)
+				{
+					return false;
+				}
+				float inverseW = 1.0f / w;
+				float x = ((m[0][0] * px + m[0][1] * py + m[0][2] * pz + m[0][3]) * inverseW * 0.5f + 0.5f) * WIDTH;
+				float y = ((m[1][0] * px + m[1][1] * py + m[1][2] * pz + m[1][3]) * inverseW * 0.5f + 0.5f) * HEIGHT;
+				float z = (m[2][0] * px + m[2][1] * py + m[2][2] * pz + m[2][3]) * inverseW * 0.5f + 0.5f;
+				minX = std::min(minX, x);
+				maxX = std::max(maxX, x);
+				minY = std::min(minY, y);
+				maxY = std::max(maxY, y);
+				nearestDepth = std::min(nearestDepth, z);
+			}
+			return true;
+		}
+
+	private:
+		Mat4                        m_viewProjection;
+		std::vector<Occluder>       m_occluders;
+		std::vector<ScreenTriangle> m_triangles;
+		std::vector<std::uint32_t>  m_bins[TILES_X * TILES_Y];
+		std::vector<float>          m_depth;
+		std::vector<float>          m_hiZ;
+		JobSystem::TaskHandle       m_pending;
+	};
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Core/SlotMap.h"
+
+namespace VenusEngine
+{
+	// An entity is a generational handle; it owns nothing but its components.
+	using Entity = SlotHandle;
+
+	// Bit set of component types, one bit per ComponentType<T>::id()
+	using ComponentMask = std::uint64_t;
+
+	class ComponentTypeCounter
+	{
+	protected:
+		static std::size_t next()
+		{
+			static std::size_t counter = 0;
+			assert(counter < 64 && "ComponentMask holds at most 64 component types");
+			return counter++;
+		}
+	};
+
+	// Assigns a small, dense ID to every component type on first use
+	template<typename T>
+	class ComponentType : private ComponentTypeCounter
+	{
+	public:
+		static std::size_t id()
+		{
+			static std::size_t const typeID = next();
+			return typeID;
+		}
+
+		static ComponentMask mask()
+		{
+			return ComponentMask(1) << id();
+		}
+	};
+
+	class ComponentPoolBase
+	{
+	public:
+		virtual ~ComponentPoolBase() = default;
+
+		virtual void remove(Entity entity) = 0;
+	};
+
+	/// \brief A sparse set holding every component of one type.
+	/// Components are packed in one array (a column) with a parallel array of
+	///   their entities, so a system reading this type streams only this column.
+	template<typename T>
+	class ComponentPool : public ComponentPoolBase
+	{
+	public:
+		T& add(Entity entity, T component)
+		{
+			if (entity.index >= m_sparse.size())
+			{
+				m_sparse.resize(entity.index + 1, INVALID);
+			}
+			if (m_sparse[entity.index] != INVALID)
+			{
+				T& existing = m_components[m_sparse[entity.index]];
+				existing = std::move(component);
+				return existing;
+			}
+			m_sparse[entity.index] = static_cast<std::uint32_t>(m_components.size());
+			m_entities.push_back(entity);
+			m_components.push_back(std::move(component));
+			return m_components.back();
+		}
+
+		void remove(Entity entity) override
+		{
+			if (!has(entity))
+			{
+				return;
+			}
+			std::uint32_t denseIndex = m_sparse[entity.index];
+			std::uint32_t lastIndex  = static_cast<std::uint32_t>(m_components.size() - 1);
+			if (denseIndex != lastIndex)
+			{
+				m_components[denseIndex] = std::move(m_components[lastIndex]);
+				m_entities[denseIndex]   = m_entities[lastIndex];
+				m_sparse[m_entities[denseIndex].index] = denseIndex;
+			}
+			m_components.pop_back();
+			m_entities.pop_back();
+			m_sparse[entity.index] = INVALID;
+		}
+
+		bool has(Entity entity) const
+		{
+			return entity.index < m_sparse.size() && m_sparse[entity.index] != INVALID &&
+				m_entities[m_sparse[entity.index]] == entity;
+		}
+
+		T* get(Entity entity)
+		{
+			return has(entity) ? &m_components[m_sparse[entity.index]] : nullptr;
+		}
+
+		T const* get(Entity entity) const
+		{
+			return has(entity) ? &m_components[m_sparse[entity.index]] : nullptr;
+		}
+
+		std::size_t size() const
+		{
+			return m_components.size();
+		}
+
+		// The packed columns; index i of one matches index i of the other
+		std::vector<T>&            components() { return m_components; }
+		std::vector<T> const&      components() const { return m_components; }
+		std::vector<Entity> const& entities() const { return m_entities; }
+
+	private:
+		static constexpr std::uint32_t INVALID = 0xFFFFFFFFu;
+
+		std::vector<std::uint32_t> m_sparse;
+		std::vector<Entity>        m_entities;
+		std::vector<T>             m_components;
+	};
+
+	/// \brief Owns all entities and their component pools.
+	class Registry
+	{
+	public:
+		Registry() = default;
+
+		Registry(Registry const&) = delete;
+		Registry& operator=(Registry const&) = delete;
+
+		Entity create()
+		{
+			return m_entities.insert(ComponentMask(0));
+		}
+
+		/// \post The entity and all of its components are gone; its handle is stale.
+		void destroy(Entity entity)
+		{
+			ComponentMask* mask = m_entities.get(entity);
+			if (!mask)
+			{
+				return;
+			}
+			for (std::size_t typeID = 0; typeID < m_pools.size(); ++typeID)
+			{
+				if ((*mask >> typeID) & 1u)
+				{
+					m_pools[typeID]->remove(entity);
+				}
+			}
+			m_entities.erase(entity);
+		}
+
+		bool valid(Entity entity) const
+		{
+			return m_entities.contains(entity);
+		}
+
+		template<typename T>
+		T& add(Entity entity, T component = T())
+		{
+			assert(valid(entity));
+			*m_entities.get(entity) |= ComponentType<T>::mask();
+			return pool<T>().add(entity, std::move(component));
+		}
+
+		template<typename T>
+		void remove(Entity entity)
+		{
+			if (ComponentMask* mask = m_entities.get(entity))
+			{
+				*mask &= ~ComponentType<T>::mask();
+				pool<T>().remove(entity);
+			}
+		}
+
+		template<typename T>
+		bool has(Entity entity) const
+		{
+			ComponentMask const* mask = m_entities.get(entity);
+			return mask && (*mask & ComponentType<T>::mask());
+		}
+
+		/// \return The component, or nullptr if the entity does not have one.
+		template<typename T>
+		T* get(Entity entity)
+		{
+			return has<T>(entity) ? pool<T>().get(entity) : nullptr;
+		}
+
+		template<typename T>
+		T const* get(Entity entity) const
+		{
+			// has<T> implies the pool exists
+			return has<T>(entity) ?
+				static_cast<ComponentPool<T> const&>(*m_pools[ComponentType<T>::id()]).get(entity) : nullptr;
+		}
+
+		/// \brief Gets the pool (column) of a component type, creating it if needed.
+		template<typename T>
+		ComponentPool<T>& pool()
+		{
+			std::size_t typeID = ComponentType<T>::id();
+			if (typeID >= m_pools.size())
+			{
+				m_pools.resize(typeID + 1);
+			}
+			if (!m_pools[typeID])
+			{
+				m_pools[typeID] = std::make_unique<ComponentPool<T>>();
+			}
+			return static_cast<ComponentPool<T>&>(*m_pools[typeID]);
+		}
+
+		/// \brief Calls function(entity, first, others...) for every entity that has
+		///   all of the listed components, walking the First column in order.
+		template<typename First, typename... Others, typename Function>
+		void each(Function&& function)
+		{
+			ComponentPool<First>& firstPool = pool<First>();
+			ComponentMask required = componentMask<First, Others...>();
+			for (std::size_t i = 0; i < firstPool.size(); ++i)
+			{
+				Entity entity = firstPool.entities()[i];
+				if ((*m_entities.get(entity) & required) == required)
+				{
+					function(entity, firstPool.components()[i], *pool<Others>().get(entity)...);
+				}
+			}
+		}
+
+		template<typename... Components>
+		static ComponentMask componentMask()
+		{
+			return (ComponentMask(0) | ... | ComponentType<Components>::mask());
+		}
+
+		std::size_t size() const
+		{
+			return m_entities.size();
+		}
+
+	private:
+		SlotMap<ComponentMask>                          m_entities;
+		std::vector<std::unique_ptr<ComponentPoolBase>> m_pools;
+	};
+}
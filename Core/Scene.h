@@ -1,15 +1,60 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "Core/Mesh.h"
+#include "Core/ID.h"
+#include "Core/Symbol.h"
+#include "Core/NameIndex.h"
+#include "Core/Registry.h"
+#include "Core/Components.h"
+#include "Core/TransformSystem.h"
+#include "Core/Frustum.h"
+#include "Core/AabbTree.h"
+#include "Core/OcclusionCuller.h"
+#include "Render/RenderStats.h"
+#include "Render/RenderQueue.h"
 
 namespace VenusEngine
 {
+	/// \brief Where the meshes of a Scene changed in ways the TransformSystem
+	///   does not report: removals, and opacity edits.
+	struct SceneChanges
+	{
+		// World bounds of each mesh removed or edited
+		std::vector<std::pair<Vec3, Vec3>> bounds;
+		// Set by Scene::clear, which changes every mesh
+		bool                               everything = false;
+
+		void clear()
+		{
+			bounds.clear();
+			everything = false;
+		}
+	};
+
+	/// \brief The meshes of the world, as a view over the entities of a Registry
+	///   that have a RenderableComponent.
 	class Scene
 	{
 	public:
-		Scene() = default;
+		using MeshHandle = Entity;
+
+		Scene(Registry& registry, TransformSystem& transformSystem)
+			: m_registry(registry), m_transformSystem(transformSystem)
+		{
+			// Create the pools up front; systems must not create them concurrently
+			m_registry.pool<NameComponent>();
+			m_registry.pool<TransformComponent>();
+			m_registry.pool<HierarchyComponent>();
+			m_registry.pool<WorldMatrixComponent>();
+			m_registry.pool<RenderableComponent>();
+			m_registry.pool<BoundsComponent>();
+			m_registry.pool<SelectionComponent>();
+		}
 
 		~Scene() = default;
 
@@ -25,48 +70,245 @@ namespace VenusEngine
 		///   that you can access it in the future.
 		/// \param[in] mesh A pointer to the Mesh that should be added.  This Mesh
 		///   must have been dynamically allocated.  The Scene will now own this Mesh
-		///   and be responsible for de-allocating it.
+		///   and be responsible for de-allocating it.  A Mesh may be shared by
+		///   several entities.
 		/// \pre The Scene does not contain any Mesh associated with meshName.
-		/// \post The Scene contains the mesh, associated with the meshName.
-		void add(std::string const& meshName, std::shared_ptr<Mesh> mesh)
+		/// \post The Scene contains an entity drawing the mesh, associated with
+		///   the meshName.
+		/// \return The entity of the Mesh.
+		MeshHandle add(std::string const& meshName, std::shared_ptr<Mesh> mesh)
 		{
-			m_meshes[meshName] = mesh;
+			remove(meshName);
+			Symbol name(meshName);
+			Entity entity = m_registry.create();
+			int pickID = ID::generateID();
+
+			BoundsComponent bounds;
+			bounds.localMin = mesh->getLocalMin();
+			bounds.localMax = mesh->getLocalMax();
+			bounds.worldMin = bounds.localMin;
+			bounds.worldMax = bounds.localMax;
+
+			m_registry.add(entity, NameComponent{ name });
+			m_registry.add(entity, TransformComponent());
+			m_registry.add(entity, HierarchyComponent());
+			m_registry.add(entity, WorldMatrixComponent());
+			m_registry.add(entity, RenderableComponent{ mesh, pickID });
+			bounds.spatialProxy = m_spatialIndex.insert(bounds.worldMin, bounds.worldMax, entity);
+			m_registry.add(entity, bounds);
+
+			m_names.insert(name, entity);
+			std::size_t id = static_cast<std::size_t>(pickID);
+			if (id >= m_handleByID.size())
+			{
+				m_handleByID.resize(id + 1);
+			}
+			m_handleByID[id] = entity;
+			m_transformSystem.markDirty(entity);
+			return entity;
 		}
 
 		/// \brief Removes a Mesh from this Scene.
 		/// \param[in] meshName The name of the Mesh that should be removed.
-		/// \pre This Scene contains a Mesh associated with meshName.
 		/// \post This Scene no longer associates meshName with anything.
-		/// \post The Mesh that had been associated with meshName has been freed.
+		/// \post The entity that had been associated with meshName has been
+		///   destroyed.  Its children are moved to its parent.
 		void remove(std::string const& meshName)
 		{
-			m_meshes.erase(meshName);
-			if (meshName == m_activeMeshName)
+			Symbol name = Symbol::find(meshName);
+			Entity entity = m_names.find(name);
+			if (!m_names.erase(name))
 			{
-				m_activeMeshName.clear();
+				return;
 			}
+			m_handleByID[static_cast<std::size_t>(m_registry.get<RenderableComponent>(entity)->pickID)] = {};
+			m_transformSystem.detach(m_registry, entity);
+			BoundsComponent const* bounds = m_registry.get<BoundsComponent>(entity);
+			m_spatialIndex.remove(bounds->spatialProxy);
+			m_changes.bounds.emplace_back(bounds->worldMin, bounds->worldMax);
+			m_registry.destroy(entity);
 		}
 
 		/// \brief Removes all Meshes from this Scene.
 		/// \post This Scene is empty.
-		/// \post All Meshes that had been part of this Scene have been freed.
 		void clear()
 		{
-			m_meshes.clear();
-			m_activeMeshName.clear();
+			for (NameIndex<MeshHandle>::Entry const& entry : m_names.sorted())
+			{
+				m_registry.destroy(entry.handle);
+			}
+			m_names.clear();
+			m_handleByID.clear();
+			m_spatialIndex.clear();
+			m_activeMesh = {};
+			m_changes.bounds.clear();
+			m_changes.everything = true;
+		}
+
+		/// \brief Finds the meshes inside the frustum and starts rasterizing the
+		///   occluders among them on worker threads.
+		/// \param[in] viewProjection The matrix the frustum was extracted from.
+		/// \pre updateSpatialIndex has been called since the last transform change.
+		void beginCulling(Frustum const& frustum, Mat4 const& viewProjection)
+		{
+			// Every box is tested against the camera frustum in SIMD batches over
+			// structure-of-arrays columns: with most of the scene on screen this
+			// beats walking the AABB tree, which serves the smaller queries
+			ComponentPool<BoundsComponent>& bounds = m_registry.pool<BoundsComponent>();
+			std::size_t count = bounds.size();
+			for (std::vector<float>* column : { &m_centerX, &m_centerY, &m_centerZ, &m_extentX, &m_extentY, &m_extentZ })
+			{
+				column->resize(count);
+			}
+			m_visible.resize(count);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				BoundsComponent const& box = bounds.components()[i];
+				m_centerX[i] = (box.worldMin.x + box.worldMax.x) * 0.5f;
+				m_centerY[i] = (box.worldMin.y + box.worldMax.y) * 0.5f;
+				m_centerZ[i] = (box.worldMin.z + box.worldMax.z) * 0.5f;
+				m_extentX[i] = (box.worldMax.x - box.worldMin.x) * 0.5f;
+				m_extentY[i] = (box.worldMax.y - box.worldMin.y) * 0.5f;
+				m_extentZ[i] = (box.worldMax.z - box.worldMin.z) * 0.5f;
+			}
+			frustum.cull(m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+				m_extentX.data(), m_extentY.data(), m_extentZ.data(), count, m_visible.data());
+
+			m_visibleEntities.clear();
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				Entity entity = bounds.entities()[i];
+				if (m_visible[i] && m_registry.get<RenderableComponent>(entity))
+				{
+					m_visibleEntities.push_back(entity);
+				}
+			}
+
+			if (!m_occlusionCulling)
+			{
+				return;
+			}
+			m_occlusionCuller.begin(viewProjection);
+			for (Entity entity : m_visibleEntities)
+			{
+				RenderableComponent const* renderable = m_registry.get<RenderableComponent>(entity);
+				// Blended meshes do not hide anything
+				if (renderable->occluder && renderable->opacity >= 1.0f)
+				{
+					m_occlusionCuller.addOccluder(m_registry.get<WorldMatrixComponent>(entity)->matrix,
+						renderable->mesh->getOccluderPositions());
+				}
+			}
+			m_occlusionCuller.rasterizeAsync();
 		}
 
-		/// \brief Draws all of the elements in this Scene.
+		/// \brief Queues the meshes found by beginCulling that are not hidden
+		///   behind occluders.
+		/// \param[out] queue Receives one command per visible mesh.
 		/// \param[in] shaderProgram The ShaderProgram that should be used for
 		///   drawing.
-		/// \param[in] viewMatrix The view matrix that should be used when drawing
-		///   the Scene.
-		void draw(ShaderProgram& shaderProgram)
+		/// \param[in] streamBuffer The per-frame ring buffer used to upload pending
+		///   vertex edits.
+		/// \param[in] cameraPosition Used to order the commands by depth.
+		/// \param[in,out] stats Receives the visible, culled and occluded counts.
+		/// \pre beginCulling has been called this frame.
+		void draw(RenderQueue& queue, ShaderProgram& shaderProgram, RingBuffer& streamBuffer,
+			Vec3 const& cameraPosition, RenderStats& stats)
 		{
-			for (auto& pair : m_meshes)
+			stats.culledObjects += size() - m_visibleEntities.size();
+			if (m_occlusionCulling)
 			{
-				pair.second->draw(shaderProgram);
+				m_occlusionCuller.wait();
+				stats.occluderTriangles += m_occlusionCuller.rasterizedTriangles();
 			}
+
+			for (Entity entity : m_visibleEntities)
+			{
+				RenderableComponent* renderable = m_registry.get<RenderableComponent>(entity);
+				BoundsComponent const* bounds   = m_registry.get<BoundsComponent>(entity);
+				if (m_occlusionCulling && !m_occlusionCuller.isVisible(bounds->worldMin, bounds->worldMax))
+				{
+					++stats.occludedObjects;
+					continue;
+				}
+				++stats.visibleObjects;
+				renderable->mesh->uploadVertices(streamBuffer);
+
+				RenderCommand command;
+				command.shaderProgram = &shaderProgram;
+				command.vertexArray   = &renderable->mesh->getVertexArray();
+				command.vertexCount   = renderable->mesh->getVertexCount();
+				command.worldMatrix   = m_registry.get<WorldMatrixComponent>(entity)->matrix;
+				command.objectID      = renderable->pickID;
+				command.opacity       = renderable->opacity;
+				command.boundsMin     = bounds->worldMin;
+				command.boundsMax     = bounds->worldMax;
+				Vec3 center = (bounds->worldMin + bounds->worldMax) * 0.5f;
+				queue.push(renderable->opacity < 1.0f ? RenderQueue::Pass::Blended : RenderQueue::Pass::Opaque,
+					command, (center - cameraPosition).squaredLength());
+			}
+		}
+
+		void setOcclusionCulling(bool enabled)
+		{
+			m_occlusionCulling = enabled;
+		}
+
+		bool occlusionCulling() const
+		{
+			return m_occlusionCulling;
+		}
+
+		/// \brief Moves the entities whose world bounds changed this frame in the
+		///   spatial index.
+		/// \pre The TransformSystem and BoundsSystem have run this frame.
+		void updateSpatialIndex()
+		{
+			for (Entity entity : m_transformSystem.changed())
+			{
+				if (BoundsComponent* bounds = m_registry.get<BoundsComponent>(entity))
+				{
+					m_spatialIndex.move(bounds->spatialProxy, bounds->worldMin, bounds->worldMax);
+				}
+			}
+			m_spatialIndex.optimize(SPATIAL_OPTIMIZE_BUDGET);
+		}
+
+		/// \return The meshes whose bounds overlap the box.
+		std::vector<MeshHandle> queryBox(Vec3 const& min, Vec3 const& max) const
+		{
+			std::vector<MeshHandle> result;
+			m_spatialIndex.queryBox(min, max, [&](Entity entity) { result.push_back(entity); });
+			return result;
+		}
+
+		/// \return The meshes whose bounds may be inside the frustum.
+		std::vector<MeshHandle> queryFrustum(Frustum const& frustum) const
+		{
+			std::vector<MeshHandle> result;
+			m_spatialIndex.queryFrustum(frustum, [&](Entity entity) { result.push_back(entity); });
+			return result;
+		}
+
+		/// \return The meshes whose bounds overlap the sphere.
+		std::vector<MeshHandle> querySphere(Vec3 const& center, float radius) const
+		{
+			std::vector<MeshHandle> result;
+			m_spatialIndex.querySphere(center, radius, [&](Entity entity) { result.push_back(entity); });
+			return result;
+		}
+
+		/// \brief Finds the mesh whose bounds a ray enters first.
+		/// \return The mesh, or an invalid handle if the ray hits nothing.
+		MeshHandle raycast(Vec3 const& origin, Vec3 const& direction, float maxDistance) const
+		{
+			MeshHandle nearest;
+			m_spatialIndex.raycast(origin, direction, maxDistance, [&](Entity entity, float distance)
+				{
+					nearest = entity;
+					return distance;
+				});
+			return nearest;
 		}
 
 		/// \brief Tests whether or not this Scene contains a Mesh associated with a
@@ -74,93 +316,388 @@ namespace VenusEngine
 		/// \param[in] meshName The name of the requested Mesh.
 		/// \return Whether or not this Scene contains a Mesh associated with
 		///   meshName.
-		bool hasMesh(std::string const& meshName)
+		bool hasMesh(std::string const& meshName) const
+		{
+			return m_names.contains(Symbol::find(meshName));
+		}
+
+		/// \return Whether handle is the entity of a Mesh still in this Scene.
+		bool contains(MeshHandle handle) const
 		{
-			return m_meshes.count(meshName);
+			return m_registry.valid(handle) && m_registry.get<RenderableComponent>(handle) != nullptr;
 		}
 
 		/// \brief Gets the Mesh associated with a name.
 		/// \param[in] meshName The name of the requested Mesh.
-		/// \return A pointer to the Mesh associated with meshName.  This pointer
-		///   should not be permanently stored, as the Mesh it points to will be
-		///   deallocated with this Scene.
-		/// \pre This Scene has a Mesh assocated with meshName.
+		/// \return A pointer to the Mesh associated with meshName, or nullptr.
 		std::shared_ptr<Mesh> getMesh(std::string const& meshName)
 		{
-			return m_meshes[meshName];
+			return getMesh(getHandle(meshName));
+		}
+
+		/// \brief Gets the Mesh of an entity.
+		/// \return The Mesh, or nullptr if the entity is stale.
+		std::shared_ptr<Mesh> getMesh(MeshHandle handle)
+		{
+			RenderableComponent* renderable = m_registry.get<RenderableComponent>(handle);
+			return renderable ? renderable->mesh : nullptr;
+		}
+
+		/// \brief Gets the Mesh of an entity to edit its vertices, first giving
+		///   the entity a copy of its own if other entities share the Mesh,
+		///   so that the edit does not change them.
+		/// \return The Mesh, or nullptr if the entity is stale.
+		std::shared_ptr<Mesh> getOwnMesh(MeshHandle handle)
+		{
+			RenderableComponent* renderable = m_registry.get<RenderableComponent>(handle);
+			if (!renderable)
+			{
+				return nullptr;
+			}
+			for (RenderableComponent const& other : m_registry.pool<RenderableComponent>().components())
+			{
+				if (&other != renderable && other.mesh == renderable->mesh)
+				{
+					renderable->mesh = renderable->mesh->clone();
+					break;
+				}
+			}
+			return renderable->mesh;
+		}
+
+		/// \return The entity of the Mesh named meshName, or an invalid handle.
+		MeshHandle getHandle(std::string const& meshName) const
+		{
+			return m_names.find(Symbol::find(meshName));
+		}
+
+		/// \return The entity whose ID was picked, or an invalid handle.
+		MeshHandle getHandleByID(int id) const
+		{
+			if (id < 0 || static_cast<std::size_t>(id) >= m_handleByID.size())
+			{
+				return {};
+			}
+			return m_handleByID[static_cast<std::size_t>(id)];
+		}
+
+		/// \return The name of a mesh, or an empty string if the handle is stale.
+		std::string const& getName(MeshHandle handle) const
+		{
+			static std::string const noName;
+			Registry const& registry = m_registry;
+			NameComponent const* name = registry.get<NameComponent>(handle);
+			return name ? name->name.str() : noName;
+		}
+
+		/// \brief Gets the local transform of a mesh, relative to its parent.
+		/// \pre The handle is valid.
+		Transform const& getTransform(MeshHandle handle)
+		{
+			return m_registry.get<TransformComponent>(handle)->transform;
+		}
+
+		/// \brief Sets the local transform of a mesh; its world matrix and those
+		///   of its descendants are updated by the next TransformSystem run.
+		/// \pre The handle is valid.
+		void setTransform(MeshHandle handle, Transform const& transform)
+		{
+			m_registry.get<TransformComponent>(handle)->transform = transform;
+			m_transformSystem.markDirty(handle);
+		}
+
+		/// \return The parent of a mesh, or an invalid handle if it is a root.
+		MeshHandle getParent(MeshHandle handle) const
+		{
+			Registry const& registry = m_registry;
+			HierarchyComponent const* node = registry.get<HierarchyComponent>(handle);
+			return node ? node->parent : MeshHandle();
+		}
+
+		/// \return The children of a mesh.
+		std::vector<MeshHandle> getChildren(MeshHandle handle) const
+		{
+			std::vector<MeshHandle> children;
+			Registry const& registry = m_registry;
+			HierarchyComponent const* node = registry.get<HierarchyComponent>(handle);
+			for (Entity child = node ? node->firstChild : Entity(); child.valid();
+				child = registry.get<HierarchyComponent>(child)->nextSibling)
+			{
+				children.push_back(child);
+			}
+			return children;
+		}
+
+		/// \brief Makes parent the parent of child, keeping child where it is in
+		///   the world.
+		/// \param[in] parent The new parent, or an invalid handle to make child a
+		///   root.
+		/// \return false if parent is child or one of its descendants.
+		bool setParent(MeshHandle child, MeshHandle parent)
+		{
+			return m_transformSystem.setParent(m_registry, child, parent);
+		}
+
+		/// \pre The handle is valid.
+		float getOpacity(MeshHandle handle)
+		{
+			return m_registry.get<RenderableComponent>(handle)->opacity;
+		}
+
+		/// \pre The handle is valid.
+		void setOpacity(MeshHandle handle, float opacity)
+		{
+			m_registry.get<RenderableComponent>(handle)->opacity = opacity;
+			BoundsComponent const* bounds = m_registry.get<BoundsComponent>(handle);
+			m_changes.bounds.emplace_back(bounds->worldMin, bounds->worldMax);
+		}
+
+		/// \brief Gets whether a mesh is used as an occluder.
+		/// \pre The handle is valid.
+		bool isOccluder(MeshHandle handle)
+		{
+			return m_registry.get<RenderableComponent>(handle)->occluder;
+		}
+
+		/// \pre The handle is valid.
+		void setOccluder(MeshHandle handle, bool occluder)
+		{
+			m_registry.get<RenderableComponent>(handle)->occluder = occluder;
 		}
 
 		/// \brief Sets the active mesh to the mesh named "meshName".
 		/// The active mesh is the one affected by transforms.
 		/// \param[in] meshName The name of the mesh that should be active.
-		/// \pre The scene contains a mesh with that name.
-		/// \post The mesh with that name becomes the active mesh.
+		/// \post The mesh with that name becomes the active mesh, or no mesh is
+		///   active if there is no such mesh.
 		void setActiveMesh(std::string const& activeMeshName)
 		{
-			m_activeMeshName = activeMeshName;
+			select(getHandle(activeMeshName));
+		}
+
+		/// \brief Makes a mesh active, or none if the handle is invalid.
+		void setActiveHandle(MeshHandle handle)
+		{
+			select(handle);
 		}
 
 		void setActiveMeshByID(int id)
 		{
-			for (auto const& [name, mesh] : m_meshes)
-			{
-				if (mesh->getID() == id)
-				{
-					m_activeMeshName = name;
-					return;
-				}
-			}
-			m_activeMeshName.clear();
+			select(getHandleByID(id));
 		}
 
 		bool hasActiveMesh() const
 		{
-			return !m_activeMeshName.empty();
+			return m_registry.valid(m_activeMesh);
 		}
 
 		/// \brief Gets the active mesh.
-		/// \pre The scene has at least one mesh.
+		/// \pre The scene has an active mesh.
 		/// \return The active mesh.
 		std::shared_ptr<Mesh> getActiveMesh()
 		{
-			return m_meshes[m_activeMeshName];
+			return getMesh(m_activeMesh);
 		}
 
-		void changeActiveMeshName(std::string const& newActiveMeshName)
+		/// \brief Gets the local transform of the active mesh, relative to its
+		///   parent.
+		/// \pre The scene has an active mesh.
+		Transform const& getActiveTransform()
+		{
+			return getTransform(m_activeMesh);
+		}
+
+		/// \brief Sets the local transform of the active mesh; its world matrix
+		///   and those of its descendants are updated by the next TransformSystem
+		///   run.
+		/// \pre The scene has an active mesh.
+		void setActiveTransform(Transform const& transform)
+		{
+			setTransform(m_activeMesh, transform);
+		}
+
+		/// \pre The scene has an active mesh.
+		/// \return The current world matrix of the active mesh.
+		Mat4 getActiveWorldMatrix()
+		{
+			return TransformSystem::computeWorldMatrix(m_registry, m_activeMesh);
+		}
+
+		/// \brief Moves a mesh so that its world matrix becomes world.
+		/// \pre The handle is valid.
+		void setWorldMatrix(MeshHandle handle, Mat4 const& world)
+		{
+			m_transformSystem.setWorldMatrix(m_registry, handle, world);
+		}
+
+		/// \brief Moves the active mesh so that its world matrix becomes world.
+		/// \pre The scene has an active mesh.
+		void setActiveWorldMatrix(Mat4 const& world)
+		{
+			setWorldMatrix(m_activeMesh, world);
+		}
+
+		/// \brief Makes the mesh named parentName the parent of the active mesh,
+		///   keeping the active mesh where it is in the world.
+		/// \param[in] parentName The name of the new parent, or an empty string to
+		///   make the active mesh a root.
+		/// \return false if the parent does not exist or is a descendant of the
+		///   active mesh.
+		bool setActiveParent(std::string const& parentName)
 		{
 			if (!hasActiveMesh())
 			{
-				return;
+				return false;
+			}
+			MeshHandle parent = getHandle(parentName);
+			if (!parentName.empty() && !m_registry.valid(parent))
+			{
+				return false;
 			}
-			auto activeMesh = getActiveMesh();
-			remove(m_activeMeshName);
-			add(newActiveMeshName, activeMesh);
-			setActiveMesh(newActiveMeshName);
+			return setParent(m_activeMesh, parent);
+		}
+
+		/// \return The name of the active mesh's parent, or an empty string if it
+		///   is a root.
+		std::string const& activeParentName() const
+		{
+			return getName(getParent(m_activeMesh));
+		}
+
+		/// \pre The scene has an active mesh.
+		float getActiveOpacity()
+		{
+			return getOpacity(m_activeMesh);
+		}
+
+		/// \pre The scene has an active mesh.
+		void setActiveOpacity(float opacity)
+		{
+			setOpacity(m_activeMesh, opacity);
+		}
+
+		/// \brief Gets whether the active mesh is used as an occluder.
+		/// \pre The scene has an active mesh.
+		bool isActiveOccluder()
+		{
+			return isOccluder(m_activeMesh);
+		}
+
+		/// \pre The scene has an active mesh.
+		void setActiveOccluder(bool occluder)
+		{
+			setOccluder(m_activeMesh, occluder);
+		}
+
+		/// \pre The scene has an active mesh.
+		/// \return The picking ID of the active mesh.
+		int activePickID()
+		{
+			return m_registry.get<RenderableComponent>(m_activeMesh)->pickID;
+		}
+
+		/// \brief Renames a mesh.
+		/// \return false if the handle is stale or the name is taken.
+		bool rename(MeshHandle handle, std::string const& newName)
+		{
+			NameComponent* name = m_registry.get<NameComponent>(handle);
+			if (!name || hasMesh(newName))
+			{
+				return false;
+			}
+			Symbol symbol(newName);
+			m_names.rename(name->name, symbol);
+			name->name = symbol;
+			return true;
+		}
+
+		void changeActiveMeshName(std::string const& newActiveMeshName)
+		{
+			rename(m_activeMesh, newActiveMeshName);
+		}
+
+		/// \return The active mesh, or an invalid handle.
+		MeshHandle activeHandle() const
+		{
+			return hasActiveMesh() ? m_activeMesh : MeshHandle();
 		}
 
 		std::string const& activeMeshName() const
 		{
-			return m_activeMeshName;
+			return getName(m_activeMesh);
+		}
+
+		/// \return Every mesh, sorted by name.  The list is kept up to date as
+		///   meshes are added, removed and renamed, so reading it every frame
+		///   neither copies nor allocates.
+		std::vector<NameIndex<MeshHandle>::Entry> const& outliner() const
+		{
+			return m_names.sorted();
 		}
 
-		std::vector<std::string> allMeshNames() const
+		/// \return Every mesh, parents before their children.
+		std::vector<MeshHandle> allMeshHandles() const
 		{
-			std::vector<std::string> names;
-			names.reserve(m_meshes.size());
-			for (auto iter = m_meshes.begin(); iter != m_meshes.end(); ++iter)
+			std::vector<MeshHandle> handles;
+			handles.reserve(m_names.size());
+			for (NameIndex<MeshHandle>::Entry const& entry : m_names.sorted())
 			{
-				names.push_back(iter->first);
+				handles.push_back(entry.handle);
 			}
-			return names;
+			Registry const& registry = m_registry;
+			std::stable_sort(handles.begin(), handles.end(), [&](MeshHandle a, MeshHandle b)
+				{
+					return registry.get<HierarchyComponent>(a)->depth < registry.get<HierarchyComponent>(b)->depth;
+				});
+			return handles;
 		}
 
 		std::size_t size() const
 		{
-			return m_meshes.size();
+			return m_names.size();
+		}
+
+		/// \brief The changes to the meshes that the TransformSystem does not
+		///   report, since their consumer last cleared them.
+		SceneChanges& changes()
+		{
+			return m_changes;
+		}
+
+	private:
+		// Leaves of the spatial index reinserted per frame after moving in
+		// place, at least; optimize() takes more when its backlog grows
+		static constexpr std::size_t SPATIAL_OPTIMIZE_BUDGET = 512;
+
+		// Moves the selection tag to entity (or clears it)
+		void select(Entity entity)
+		{
+			if (m_registry.valid(m_activeMesh))
+			{
+				m_registry.remove<SelectionComponent>(m_activeMesh);
+			}
+			m_activeMesh = entity;
+			if (m_registry.valid(m_activeMesh))
+			{
+				m_registry.add(m_activeMesh, SelectionComponent());
+			}
 		}
 
 	private:
-		std::unordered_map<std::string, std::shared_ptr<Mesh>> m_meshes;
-		std::string                                            m_activeMeshName;
+		Registry&        m_registry;
+		TransformSystem& m_transformSystem;
+		// Side indices: name -> entity, picking ID -> entity
+		NameIndex<MeshHandle>                       m_names;
+		std::vector<MeshHandle>                     m_handleByID;
+		MeshHandle                                  m_activeMesh;
+		AabbTree<MeshHandle>                        m_spatialIndex;
+		OcclusionCuller                             m_occlusionCuller;
+		bool                                        m_occlusionCulling = true;
+		// Meshes inside the frustum this frame
+		std::vector<MeshHandle>                     m_visibleEntities;
+		std::vector<float>                          m_centerX, m_centerY, m_centerZ;
+		std::vector<float>                          m_extentX, m_extentY, m_extentZ;
+		std::vector<std::uint8_t>                   m_visible;
+		SceneChanges                                m_changes;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/EditHistory.h"
+#include "Core/Mesh.h"
+#include "Core/Scene.h"
+#include "Core/SceneLight.h"
+#include "Core/SceneFile.h"
+
+namespace VenusEngine
+{
+	/// \brief The edits the editor makes to the scene, applied and recorded in an
+	///   EditHistory.
+	/// Entries refer to meshes and lights by name: entities are recreated when
+	///   a removal is undone, but names are unique and every rename is itself
+	///   in the history, so a name always resolves to the same object when its
+	///   entry is replayed.
+	class SceneEdits
+	{
+	public:
+		static void setTransform(EditHistory& history, Scene& scene, Scene::MeshHandle handle, Transform const& transform)
+		{
+			Transform before = scene.getTransform(handle);
+			scene.setTransform(handle, transform);
+			recordTransform(history, scene, handle, before);
+		}
+
+		/// \brief Moves a mesh so that its world matrix becomes world, e.g. from
+		///   the gizmo.
+		static void setWorldMatrix(EditHistory& history, Scene& scene, Scene::MeshHandle handle, Mat4 const& world)
+		{
+			Transform before = scene.getTransform(handle);
+			scene.setWorldMatrix(handle, world);
+			recordTransform(history, scene, handle, before);
+		}
+
+		/// \param[in] parentName The new parent, or an empty string for none.
+		/// \return false if the parent does not exist or is a descendant.
+		static bool setParent(EditHistory& history, Scene& scene, Scene::MeshHandle handle, std::string const& parentName)
+		{
+			std::string name           = scene.getName(handle);
+			std::string beforeParent   = scene.getName(scene.getParent(handle));
+			Transform   beforeTransform = scene.getTransform(handle);
+			Scene::MeshHandle parent   = scene.getHandle(parentName);
+			if ((!parentName.empty() && !parent.valid()) || !scene.setParent(handle, parent))
+			{
+				return false;
+			}
+			Transform afterTransform = scene.getTransform(handle);
+			history.record({
+				[&scene, name, beforeParent, beforeTransform]
+				{
+					reparent(scene, name, beforeParent, beforeTransform);
+				},
+				[&scene, name, parentName, afterTransform]
+				{
+					reparent(scene, name, parentName, afterTransform);
+				},
+				2 * (name.size() + sizeof(Transform)) + beforeParent.size() + parentName.size() });
+			return true;
+		}
+
+		static void setOpacity(EditHistory& history, Scene& scene, Scene::MeshHandle handle, float opacity)
+		{
+			std::string name = scene.getName(handle);
+			float before = scene.getOpacity(handle);
+			scene.setOpacity(handle, opacity);
+			history.record({
+				[&scene, name, before] { scene.setOpacity(scene.getHandle(name), before); },
+				[&scene, name, opacity] { scene.setOpacity(scene.getHandle(name), opacity); },
+				2 * name.size() },
+				mergeKey(OPACITY, name));
+		}
+
+		static void setOccluder(EditHistory& history, Scene& scene, Scene::MeshHandle handle, bool occluder)
+		{
+			std::string name = scene.getName(handle);
+			scene.setOccluder(handle, occluder);
+			history.record({
+				[&scene, name, occluder] { scene.setOccluder(scene.getHandle(name), !occluder); },
+				[&scene, name, occluder] { scene.setOccluder(scene.getHandle(name), occluder); },
+				2 * name.size() });
+		}
+
+		/// \brief Colors the mesh of an entity; other entities that shared the
+		///   mesh keep their color.
+		static void setColor(EditHistory& history, Scene& scene, Scene::MeshHandle handle, Vec3 const& color)
+		{
+			std::string name = scene.getName(handle);
+			Vec3 before = scene.getMesh(handle)->getColor();
+			setColor(scene, name, color);
+			history.record({
+				[&scene, name, before] { setColor(scene, name, before); },
+				[&scene, name, color] { setColor(scene, name, color); },
+				2 * name.size() },
+				mergeKey(COLOR, name));
+		}
+
+		/// \return false if the name is taken.
+		static bool rename(EditHistory& history, Scene& scene, Scene::MeshHandle handle, std::string const& newName)
+		{
+			std::string name = scene.getName(handle);
+			if (!scene.rename(handle, newName))
+			{
+				return false;
+			}
+			history.record({
+				[&scene, name, newName] { scene.rename(scene.getHandle(newName), name); },
+				[&scene, name, newName] { scene.rename(scene.getHandle(name), newName); },
+				2 * (name.size() + newName.size()) });
+			return true;
+		}
+
+		static void addMesh(EditHistory& history, Scene& scene, std::string const& name, std::shared_ptr<Mesh> mesh)
+		{
+			scene.add(name, mesh);
+			std::size_t bytes = meshBytes(*mesh) + name.size();
+			history.record({
+				[&scene, name] { scene.remove(name); },
+				[&scene, name, mesh] { scene.add(name, mesh); },
+				bytes });
+		}
+
+		/// \brief Removes a mesh.  Undoing it puts the mesh back where it was,
+		///   with the children it had.
+		static void removeMesh(EditHistory& history, Scene& scene, Scene::MeshHandle handle)
+		{
+			Removed removed;
+			removed.name      = scene.getName(handle);
+			removed.parent    = scene.getName(scene.getParent(handle));
+			removed.mesh      = scene.getMesh(handle);
+			removed.transform = scene.getTransform(handle);
+			removed.opacity   = scene.getOpacity(handle);
+			removed.occluder  = scene.isOccluder(handle);
+			for (Scene::MeshHandle child : scene.getChildren(handle))
+			{
+				removed.children.push_back({ scene.getName(child), scene.getTransform(child) });
+			}
+			scene.remove(removed.name);
+
+			std::size_t bytes = meshBytes(*removed.mesh) + removed.children.size() * sizeof(Removed::Child);
+			auto shared = std::make_shared<Removed const>(std::move(removed));
+			history.record({
+				[&scene, shared]
+				{
+					Removed const& entry = *shared;
+					Scene::MeshHandle restored = scene.add(entry.name, entry.mesh);
+					scene.setParent(restored, scene.getHandle(entry.parent));
+					scene.setTransform(restored, entry.transform);
+					scene.setOpacity(restored, entry.opacity);
+					scene.setOccluder(restored, entry.occluder);
+					for (Removed::Child const& child : entry.children)
+					{
+						reparent(scene, child.name, entry.name, child.transform);
+					}
+				},
+				[&scene, shared] { scene.remove(shared->name); },
+				bytes });
+		}
+
+		/// \return false if the light limit has been reached.
+		static bool addLight(EditHistory& history, SceneLight& sceneLight, std::string const& name, std::shared_ptr<LightSource> light)
+		{
+			if (!sceneLight.add(name, light))
+			{
+				return false;
+			}
+			// The light widgets edit the light in place, so the entry keeps a
+			// copy of it rather than the light itself
+			SceneFile::LightRecord record = SceneFile::makeLightRecord(*light);
+			history.record({
+				[&sceneLight, name] { sceneLight.remove(name); },
+				[&sceneLight, name, record] { setLight(sceneLight, name, record); },
+				name.size() + sizeof(SceneFile::LightRecord) });
+			return true;
+		}
+
+		static void removeLight(EditHistory& history, SceneLight& sceneLight, std::string const& name)
+		{
+			SceneFile::LightRecord record = SceneFile::makeLightRecord(*sceneLight.getLightSource(name));
+			sceneLight.remove(name);
+			history.record({
+				[&sceneLight, name, record] { setLight(sceneLight, name, record); },
+				[&sceneLight, name] { sceneLight.remove(name); },
+				name.size() + sizeof(SceneFile::LightRecord) });
+		}
+
+		/// \return false if the name is taken.
+		static bool renameLight(EditHistory& history, SceneLight& sceneLight, std::string const& name, std::string const& newName)
+		{
+			if (!sceneLight.rename(name, newName))
+			{
+				return false;
+			}
+			history.record({
+				[&sceneLight, name, newName] { sceneLight.rename(newName, name); },
+				[&sceneLight, name, newName] { sceneLight.rename(name, newName); },
+				2 * (name.size() + newName.size()) });
+			return true;
+		}
+
+		/// \brief Records the changes the light widgets made to a light source
+		///   since before was taken with SceneFile::makeLightRecord; does nothing
+		///   if there are none.
+		static void recordLight(EditHistory& history, SceneLight& sceneLight, std::string const& name,
+			SceneFile::LightRecord const& before)
+		{
+			SceneFile::LightRecord after = SceneFile::makeLightRecord(*sceneLight.getLightSource(name));
+			if (std::memcmp(&before, &after, sizeof(before)) == 0)
+			{
+				return;
+			}
+			history.record({
+				[&sceneLight, name, before] { setLight(sceneLight, name, before); },
+				[&sceneLight, name, after] { setLight(sceneLight, name, after); },
+				name.size() + 2 * sizeof(SceneFile::LightRecord) },
+				mergeKey(LIGHT, name));
+		}
+
+	private:
+		// Kinds of edits that are merged while a widget is dragged
+		enum MergeKind : std::uint64_t
+		{
+			TRANSFORM = 1,
+			OPACITY   = 2,
+			COLOR     = 3,
+			LIGHT     = 4
+		};
+
+		// What is needed to put a removed mesh back
+		struct Removed
+		{
+			struct Child
+			{
+				std::string name;
+				Transform   transform;
+			};
+
+			std::string           name;
+			std::string           parent;
+			std::shared_ptr<Mesh> mesh;
+			Transform             transform;
+			float                 opacity  = 1.0f;
+			bool                  occluder = false;
+			std::vector<Child>    children;
+		};
+
+		static std::uint64_t mergeKey(MergeKind kind, std::string const& name)
+		{
+			return (std::hash<std::string>{}(name) << 3) ^ kind;
+		}
+
+		static void recordTransform(EditHistory& history, Scene& scene, Scene::MeshHandle handle, Transform const& before)
+		{
+			std::string name = scene.getName(handle);
+			Transform after = scene.getTransform(handle);
+			history.record({
+				[&scene, name, before] { scene.setTransform(scene.getHandle(name), before); },
+				[&scene, name, after] { scene.setTransform(scene.getHandle(name), after); },
+				2 * (name.size() + sizeof(Transform)) },
+				mergeKey(TRANSFORM, name));
+		}
+
+		// Moves a mesh under a parent, then restores the local transform it had
+		static void reparent(Scene& scene, std::string const& name, std::string const& parent, Transform const& transform)
+		{
+			Scene::MeshHandle handle = scene.getHandle(name);
+			scene.setParent(handle, scene.getHandle(parent));
+			scene.setTransform(handle, transform);
+		}
+
+		static void setColor(Scene& scene, std::string const& name, Vec3 const& color)
+		{
+			scene.getOwnMesh(scene.getHandle(name))->setColor(color);
+		}
+
+		static void setLight(SceneLight& sceneLight, std::string const& name, SceneFile::LightRecord const& record)
+		{
+			sceneLight.add(name, SceneFile::makeLightSource(record));
+		}
+
+		// A removed mesh is kept alive by the history; meshes still drawn by
+		// other entities are counted too
+		static std::size_t meshBytes(Mesh const& mesh)
+		{
+			return mesh.getVertices().size() * sizeof(float) + mesh.getIndices().size() * sizeof(unsigned int);
+		}
+	};
+}
@@ -0,0 +1,494 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/MappedFile.h"
+#include "Core/Mesh.h"
+#include "Core/LightSource.h"
+#include "Core/Scene.h"
+#include "Core/SceneLight.h"
+
+namespace VenusEngine
+{
+	/// \brief Reads and writes binary scene files.
+	/// A file is a fixed header, a set of sections and a table of contents
+	///   listing them.  Every section starts on a 64-byte boundary and carries its
+	///   own checksum.  Names, the transform hierarchy and the lights are small
+	///   arrays of fixed-size records; each vertex and index buffer is a section
+	///   of its own, stored exactly as the GPU takes it, so a mapped file is
+	///   handed to glBufferData without being parsed.  Meshes shared by several
+	///   entities are stored once.
+	/// Numbers are stored in the byte order of the machine, which is little
+	///   endian on every platform the engine runs on.
+	/// SceneStreamer loads the files, over several frames.
+	class SceneFile
+	{
+	public:
+		static constexpr std::uint32_t VERSION   = 1;
+		// Sections start on a multiple of this many bytes
+		static constexpr std::uint64_t ALIGNMENT = 64;
+		// Stands for "none" in section, parent and string references
+		static constexpr std::uint32_t NONE      = 0xFFFFFFFFu;
+
+		enum class SectionType : std::uint32_t
+		{
+			Strings    = 0,
+			Geometries = 1,
+			Nodes      = 2,
+			Lights     = 3,
+			Vertices   = 4,
+			Indices    = 5
+		};
+
+		struct Header
+		{
+			char          magic[8];
+			std::uint32_t version;
+			std::uint32_t sectionCount;
+			std::uint64_t tocOffset;
+			std::uint64_t fileSize;
+			std::uint64_t tocChecksum;
+			std::uint8_t  reserved[24];
+		};
+
+		// An entry of the table of contents
+		struct Section
+		{
+			SectionType   type;
+			std::uint32_t reserved;
+			std::uint64_t offset;
+			std::uint64_t size;
+			std::uint64_t checksum;
+		};
+
+		// A Mesh; its vertices and indices are sections of their own
+		struct GeometryRecord
+		{
+			std::uint32_t vertexSection;
+			std::uint32_t indexSection;
+			float         localMin[3];
+			float         localMax[3];
+		};
+
+		// An entity drawing a geometry
+		struct NodeRecord
+		{
+			// byte offset of the name in the string section
+			std::uint32_t name;
+			std::uint32_t geometry;
+			// index of the parent node, which always comes earlier, or NONE
+			std::uint32_t parent;
+			std::uint32_t flags;
+			float         position[3];
+			float         rotation[4];
+			float         scale[3];
+			float         opacity;
+		};
+
+		struct LightRecord
+		{
+			std::uint32_t name;
+			std::uint32_t type;
+			float         diffuseIntensity[3];
+			float         specularIntensity[3];
+			float         position[3];
+			float         attenuationCoefficients[3];
+			float         direction[3];
+			float         cutoffCosAngle;
+			float         falloff;
+		};
+
+		static constexpr std::uint32_t NODE_OCCLUDER = 1u << 0;
+
+		static_assert(sizeof(Header) == 64 && sizeof(Section) == 32, "Scene file layout changed");
+
+		/// \brief A mapped scene file.  Opening it checks the header and the table
+		///   of contents only; the other sections are checked and read when first
+		///   asked for, so a reader may look at the nodes without touching any
+		///   vertex data.
+		class Reader
+		{
+		public:
+			/// \return false if the file cannot be mapped or is not a valid scene
+			///   file of a supported version; error() tells why.
+			bool open(std::string const& path)
+			{
+				m_verified.clear();
+				if (!m_file.open(path))
+				{
+					return fail("cannot be opened");
+				}
+				if (m_file.size() < sizeof(Header))
+				{
+					return fail("is too small");
+				}
+				std::memcpy(&m_header, m_file.data(), sizeof(Header));
+				if (std::memcmp(m_header.magic, MAGIC, sizeof(m_header.magic)) != 0)
+				{
+					return fail("is not a scene file");
+				}
+				if (m_header.version > VERSION)
+				{
+					return fail("was written by a newer version");
+				}
+				std::uint64_t tocSize = std::uint64_t(m_header.sectionCount) * sizeof(Section);
+				if (m_header.fileSize != m_file.size() || m_header.tocOffset % ALIGNMENT != 0 ||
+					m_header.tocOffset > m_file.size() || tocSize > m_file.size() - m_header.tocOffset)
+				{
+					return fail("is truncated");
+				}
+				if (checksum(m_file.data() + m_header.tocOffset, tocSize) != m_header.tocChecksum)
+				{
+					return fail("has a corrupt table of contents");
+				}
+				for (std::uint32_t i = 0; i < m_header.sectionCount; ++i)
+				{
+					Section const& entry = section(i);
+					if (entry.offset % ALIGNMENT != 0 || entry.offset > m_file.size() ||
+						entry.size > m_file.size() - entry.offset)
+					{
+						return fail("has a section outside the file");
+					}
+				}
+				m_verified.assign(m_header.sectionCount, false);
+				return true;
+			}
+
+			std::string const& error() const
+			{
+				return m_error;
+			}
+
+			std::uint32_t sectionCount() const
+			{
+				return m_header.sectionCount;
+			}
+
+			Section const& section(std::uint32_t index) const
+			{
+				return reinterpret_cast<Section const*>(m_file.data() + m_header.tocOffset)[index];
+			}
+
+			/// \brief Gets the records of the first section of a type.
+			/// \param[out] count The number of records.
+			/// \return The records, or nullptr if the section is missing, corrupt or
+			///   not a whole number of records.
+			template<typename Record>
+			Record const* records(SectionType type, std::size_t& count)
+			{
+				count = 0;
+				std::uint32_t index = find(type);
+				if (index == NONE || section(index).size % sizeof(Record) != 0)
+				{
+					return nullptr;
+				}
+				count = static_cast<std::size_t>(section(index).size / sizeof(Record));
+				return static_cast<Record const*>(data(index));
+			}
+
+			/// \return The string at a byte offset of the string section, or an
+			///   empty string if there is none.
+			std::string string(std::uint32_t offset)
+			{
+				std::uint32_t index = find(SectionType::Strings);
+				if (index == NONE || offset >= section(index).size)
+				{
+					return {};
+				}
+				char const* begin = static_cast<char const*>(data(index));
+				if (!begin)
+				{
+					return {};
+				}
+				char const* end = static_cast<char const*>(std::memchr(begin + offset, '\0', section(index).size - offset));
+				return end ? std::string(begin + offset, end) : std::string();
+			}
+
+			/// \brief Gets the contents of a section, checking them the first time.
+			/// \return The 64-byte aligned contents, or nullptr if they are corrupt.
+			void const* data(std::uint32_t index)
+			{
+				if (index >= m_header.sectionCount)
+				{
+					return nullptr;
+				}
+				if (!m_verified[index])
+				{
+					if (!verify(index))
+					{
+						fail("has a corrupt section");
+						return nullptr;
+					}
+					m_verified[index] = true;
+				}
+				return bytes(index);
+			}
+
+			/// \brief Checks a section against its checksum, reading all of it.
+			/// Unlike data(), nothing is cached, so worker threads may call it at
+			///   the same time.
+			bool verify(std::uint32_t index) const
+			{
+				return index < m_header.sectionCount && checksum(bytes(index), section(index).size) == section(index).checksum;
+			}
+
+			/// \return The contents of a section, unchecked.
+			/// \pre index < sectionCount().
+			void const* bytes(std::uint32_t index) const
+			{
+				return m_file.data() + section(index).offset;
+			}
+
+		private:
+			std::uint32_t find(SectionType type) const
+			{
+				for (std::uint32_t i = 0; i < m_header.sectionCount; ++i)
+				{
+					if (section(i).type == type)
+					{
+						return i;
+					}
+				}
+				return NONE;
+			}
+
+			bool fail(char const* reason)
+			{
+				m_error = reason;
+				return false;
+			}
+
+		private:
+			MappedFile        m_file;
+			Header            m_header{};
+			std::vector<bool> m_verified;
+			std::string       m_error;
+		};
+
+		/// \brief Writes the meshes and lights of a scene to a file.
+		/// \return false if the file cannot be written.
+		static bool save(std::string const& path, Scene& scene, SceneLight& sceneLight)
+		{
+			std::vector<char>                       strings;
+			std::vector<GeometryRecord>             geometries;
+			std::vector<NodeRecord>                 nodes;
+			std::vector<LightRecord>                lights;
+			std::vector<Mesh const*>                meshes;
+			std::unordered_map<Mesh const*, std::uint32_t> geometryByMesh;
+			std::unordered_map<std::uint64_t, std::uint32_t> nodeByHandle;
+
+			auto addString = [&strings](std::string const& string)
+			{
+				std::uint32_t offset = static_cast<std::uint32_t>(strings.size());
+				strings.insert(strings.end(), string.begin(), string.end());
+				strings.push_back('\0');
+				return offset;
+			};
+
+			// Sections 0 to 3 are the record arrays; the blobs follow
+			std::uint32_t nextSection = 4;
+			for (Scene::MeshHandle handle : scene.allMeshHandles())
+			{
+				std::shared_ptr<Mesh> mesh = scene.getMesh(handle);
+				auto [iter, isNew] = geometryByMesh.emplace(mesh.get(), static_cast<std::uint32_t>(geometries.size()));
+				if (isNew)
+				{
+					GeometryRecord geometry{};
+					geometry.vertexSection = nextSection++;
+					geometry.indexSection  = mesh->getIndices().empty() ? NONE : nextSection++;
+					toFloats(mesh->getLocalMin(), geometry.localMin);
+					toFloats(mesh->getLocalMax(), geometry.localMax);
+					geometries.push_back(geometry);
+					meshes.push_back(mesh.get());
+				}
+
+				Transform const& transform = scene.getTransform(handle);
+				Scene::MeshHandle parent   = scene.getParent(handle);
+				NodeRecord node{};
+				node.name     = addString(scene.getName(handle));
+				node.geometry = iter->second;
+				// Parents come first, so their index is known
+				node.parent   = parent.valid() ? nodeByHandle.at(key(parent)) : NONE;
+				node.flags    = scene.isOccluder(handle) ? NODE_OCCLUDER : 0;
+				toFloats(transform.m_position, node.position);
+				toFloats(transform.m_scale, node.scale);
+				node.rotation[0] = transform.m_rotation.w;
+				node.rotation[1] = transform.m_rotation.x;
+				node.rotation[2] = transform.m_rotation.y;
+				node.rotation[3] = transform.m_rotation.z;
+				node.opacity  = scene.getOpacity(handle);
+				nodeByHandle[key(handle)] = static_cast<std::uint32_t>(nodes.size());
+				nodes.push_back(node);
+			}
+
+			for (auto const& [name, entity] : sceneLight.outliner())
+			{
+				LightRecord record = makeLightRecord(*sceneLight.getLightSource(entity));
+				record.name = addString(name.str());
+				lights.push_back(record);
+			}
+
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				std::cout << "Scene file " << path << " cannot be written" << std::endl;
+				return false;
+			}
+			std::vector<Section> toc;
+			Header header{};
+			file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+			auto writeSection = [&](SectionType type, void const* bytes, std::uint64_t size)
+			{
+				Section entry{};
+				entry.type     = type;
+				entry.offset   = pad(file);
+				entry.size     = size;
+				entry.checksum = checksum(bytes, size);
+				file.write(static_cast<char const*>(bytes), static_cast<std::streamsize>(size));
+				toc.push_back(entry);
+			};
+			writeSection(SectionType::Strings, strings.data(), strings.size());
+			writeSection(SectionType::Geometries, geometries.data(), geometries.size() * sizeof(GeometryRecord));
+			writeSection(SectionType::Nodes, nodes.data(), nodes.size() * sizeof(NodeRecord));
+			writeSection(SectionType::Lights, lights.data(), lights.size() * sizeof(LightRecord));
+			for (Mesh const* mesh : meshes)
+			{
+				writeSection(SectionType::Vertices, mesh->getVertices().data(), mesh->getVertices().size() * sizeof(float));
+				if (!mesh->getIndices().empty())
+				{
+					writeSection(SectionType::Indices, mesh->getIndices().data(), mesh->getIndices().size() * sizeof(unsigned int));
+				}
+			}
+
+			std::memcpy(header.magic, MAGIC, sizeof(header.magic));
+			header.version      = VERSION;
+			header.sectionCount = static_cast<std::uint32_t>(toc.size());
+			header.tocOffset    = pad(file);
+			header.tocChecksum  = checksum(toc.data(), toc.size() * sizeof(Section));
+			file.write(reinterpret_cast<char const*>(toc.data()), static_cast<std::streamsize>(toc.size() * sizeof(Section)));
+			header.fileSize     = static_cast<std::uint64_t>(file.tellp());
+			file.seekp(0);
+			file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+			if (!file)
+			{
+				std::cout << "Scene file " << path << " cannot be written" << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		/// \brief Sets the transform, opacity and occluder flag of a mesh to those
+		///   of a node record.
+		static void applyNode(NodeRecord const& node, Scene& scene, Scene::MeshHandle handle)
+		{
+			Quaternion rotation(node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]);
+			scene.setTransform(handle, Transform(Vec3(node.position), rotation, Vec3(node.scale)));
+			scene.setOpacity(handle, node.opacity);
+			scene.setOccluder(handle, (node.flags & NODE_OCCLUDER) != 0);
+		}
+
+		/// \return The record of a light source; its name is left empty.
+		static LightRecord makeLightRecord(LightSource& light)
+		{
+			LightRecord record{};
+			record.name = NONE;
+			toFloats(light.getDiffuseIntensity(), record.diffuseIntensity);
+			toFloats(light.getSpecularIntensity(), record.specularIntensity);
+			if (auto location = dynamic_cast<LocationLightSource*>(&light))
+			{
+				record.type = LightType::POINT;
+				toFloats(location->getPosition(), record.position);
+				toFloats(location->getAttenuationCoefficients(), record.attenuationCoefficients);
+			}
+			if (auto spot = dynamic_cast<SpotLightSource*>(&light))
+			{
+				record.type           = LightType::SPOT;
+				record.cutoffCosAngle = spot->getCutoffCosAngle();
+				record.falloff        = spot->getFalloff();
+				toFloats(spot->getDirection(), record.direction);
+			}
+			else if (auto directional = dynamic_cast<DirectionalLightSource*>(&light))
+			{
+				record.type = LightType::DIRECTIONAL;
+				toFloats(directional->getDirection(), record.direction);
+			}
+			return record;
+		}
+
+		/// \return The light source of a light record, or nullptr if its type is
+		///   unknown.
+		static std::shared_ptr<LightSource> makeLightSource(LightRecord const& light)
+		{
+			Vec3 diffuse(light.diffuseIntensity), specular(light.specularIntensity);
+			switch (light.type)
+			{
+			case LightType::DIRECTIONAL:
+				return std::make_shared<DirectionalLightSource>(diffuse, specular, Vec3(light.direction));
+			case LightType::POINT:
+				return std::make_shared<PointLightSource>(diffuse, specular, Vec3(light.position),
+					Vec3(light.attenuationCoefficients));
+			case LightType::SPOT:
+				return std::make_shared<SpotLightSource>(diffuse, specular, Vec3(light.position),
+					Vec3(light.attenuationCoefficients), Vec3(light.direction), light.cutoffCosAngle, light.falloff);
+			default:
+				return nullptr;
+			}
+		}
+
+		/// \brief 64-bit FNV-1a over 8-byte words, so that checking a section runs
+		///   at close to memory speed.
+		static std::uint64_t checksum(void const* bytes, std::uint64_t size)
+		{
+			constexpr std::uint64_t PRIME = 0x100000001B3ull;
+			std::uint64_t hash = 0xCBF29CE484222325ull;
+			auto const* begin = static_cast<std::uint8_t const*>(bytes);
+			std::uint64_t i = 0;
+			for (; i + 8 <= size; i += 8)
+			{
+				std::uint64_t word;
+				std::memcpy(&word, begin + i, sizeof(word));
+				hash = (hash ^ word) * PRIME;
+			}
+			for (; i < size; ++i)
+			{
+				hash = (hash ^ begin[i]) * PRIME;
+			}
+			return hash;
+		}
+
+	private:
+		static constexpr char MAGIC[8] = { 'V', 'E', 'N', 'U', 'S', 'S', 'C', 'N' };
+
+		static std::uint64_t key(Scene::MeshHandle handle)
+		{
+			return (std::uint64_t(handle.index) << 32) | handle.generation;
+		}
+
+		static void toFloats(Vec3 const& vector, float* floats)
+		{
+			floats[0] = vector.x;
+			floats[1] = vector.y;
+			floats[2] = vector.z;
+		}
+
+		// Pads the file with zeros up to the next multiple of ALIGNMENT
+		static std::uint64_t pad(std::ofstream& file)
+		{
+			static char const zeros[ALIGNMENT] = {};
+			std::uint64_t position = static_cast<std::uint64_t>(file.tellp());
+			std::uint64_t padding  = (ALIGNMENT - position % ALIGNMENT) % ALIGNMENT;
+			file.write(zeros, static_cast<std::streamsize>(padding));
+			return position + padding;
+		}
+	};
+}
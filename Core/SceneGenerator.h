@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/Geometry.h"
+#include "Core/Mesh.h"
+#include "Core/LightSource.h"
+#include "Core/Scene.h"
+#include "Core/SceneLight.h"
+
+namespace VenusEngine
+{
+	/// \brief Fills a scene with many randomly placed primitives and lights, to
+	///   stress the editor.
+	class SceneGenerator
+	{
+	public:
+		struct Settings
+		{
+			std::size_t  meshCount  = 10000;
+			std::size_t  lightCount = 16;
+			// Meshes are placed in a cube of this half size around the origin
+			float        halfExtent = 40.0f;
+			unsigned int seed       = 42;
+		};
+
+		/// \brief Replaces the contents of a scene with generated meshes and
+		///   lights.  Entities share one Mesh per primitive, as duplicated
+		///   objects in a real scene would.
+		/// \return The number of lights added, which the light limit may cap.
+		static std::size_t generate(Settings const& settings, Scene& scene, SceneLight& sceneLight)
+		{
+			scene.clear();
+			sceneLight.clear();
+
+			std::vector<std::pair<std::string, std::shared_ptr<Mesh>>> primitives;
+			primitives.emplace_back("Cube", makeMesh(Geometry::buildCube()));
+			primitives.emplace_back("Sphere", makeMesh(Geometry::buildSphere(2)));
+			primitives.emplace_back("Cylinder", makeMesh(Geometry::buildCylinder(24, 2.0f, 1.0f)));
+			primitives.emplace_back("Cone", makeMesh(Geometry::buildCone(24, 2.0f, 1.0f)));
+			primitives.emplace_back("Torus", makeMesh(Geometry::buildTorus(24, 12, 1.5f, 0.5f)));
+			primitives.emplace_back("Pyramid", makeMesh(Geometry::buildPyramid(1.0f, 2.0f)));
+
+			std::mt19937 random(settings.seed);
+			std::uniform_real_distribution<float> position(-settings.halfExtent, settings.halfExtent);
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+			std::uniform_real_distribution<float> angle(0.0f, Math::TWO_PI);
+			std::uniform_real_distribution<float> scale(0.2f, 1.0f);
+			std::uniform_int_distribution<std::size_t> primitive(0, primitives.size() - 1);
+
+			for (std::size_t i = 0; i < settings.meshCount; ++i)
+			{
+				auto const& [name, mesh] = primitives[primitive(random)];
+				Vec3 axis(unit(random), unit(random), unit(random));
+				axis = axis.squaredLength() > 0.0f ? axis.normalisedCopy() : Vec3::UNIT_Y;
+				float size = scale(random);
+				Scene::MeshHandle handle = scene.add(name + std::to_string(i), mesh);
+				scene.setTransform(handle, Transform(Vec3(position(random), position(random), position(random)),
+					Quaternion(Radian(angle(random)), axis), Vec3(size, size, size)));
+				scene.setOccluder(handle, size >= OCCLUDER_SIZE);
+			}
+
+			std::size_t lightCount = 0;
+			for (std::size_t i = 0; i < settings.lightCount; ++i)
+			{
+				Vec3 lightPosition(position(random), position(random), position(random));
+				// Attenuated to a range of about 12, so each light only reaches
+				// its own part of the scene
+				auto light = std::make_shared<PointLightSource>(Vec3(1.0f, 0.9f, 0.8f), Vec3(1.0f, 1.0f, 1.0f),
+					lightPosition, Vec3(1.0f, 0.35f, 0.44f));
+				if (!sceneLight.add("Point" + std::to_string(i), light))
+				{
+					break;
+				}
+				++lightCount;
+			}
+			return lightCount;
+		}
+
+	private:
+		// Meshes scaled at least this much, about the largest eighth, are
+		// occluders
+		static constexpr float OCCLUDER_SIZE = 0.9f;
+
+		static std::shared_ptr<Mesh> makeMesh(std::vector<Geometry::Triangle> const& faces)
+		{
+			auto mesh = std::make_shared<Mesh>();
+			mesh->addGeometry(Geometry::dataWithFaceNormalsANDColors(faces,
+				Geometry::computeFaceNormals(faces), Geometry::generateRandomColors(faces)));
+			mesh->prepareVao();
+			return mesh;
+		}
+	};
+}
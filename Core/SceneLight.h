@@ -1,17 +1,38 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "Core/LightSource.h"
+#include "Core/Symbol.h"
+#include "Core/NameIndex.h"
+#include "Render/LightBlock.h"
+#include "Render/UniformBuffer.h"
+#include "Render/RingBuffer.h"
+#include "Render/TextureBuffer.h"
+#include "Core/LightClusters.h"
+#include "Core/LightSelector.h"
+#include "Core/ShadowMaps.h"
+#include "Render/RenderQueue.h"
+#include "Render/ShaderVariants.h"
+#include "Core/Registry.h"
+#include "Core/Components.h"
 
 namespace VenusEngine
 {
+	/// \brief The light sources of the world, as a view over the entities of a
+	///   Registry that have a LightComponent.
 	class SceneLight
 	{
 	public:
-		SceneLight()
+		explicit SceneLight(Registry& registry)
+			: m_registry(registry)
 		{
+			m_registry.pool<LightComponent>();
 		}
 
 		~SceneLight()
@@ -24,110 +45,300 @@ namespace VenusEngine
 
 		bool add(std::string const& name, std::shared_ptr<LightSource> lightSource)
 		{
-			if (size() >= 16)
+			Symbol symbol(name);
+			Entity existing = m_names.find(symbol);
+			if (existing.valid())
+			{
+				m_registry.get<LightComponent>(existing)->light = lightSource;
+				return true;
+			}
+			if (size() >= LightBlock::MAX_LIGHTS)
 			{
 				return false;
 			}
-			m_lightSources[name] = lightSource;
+			Entity entity = m_registry.create();
+			m_registry.add(entity, NameComponent{ symbol });
+			m_registry.add(entity, LightComponent{ lightSource });
+			m_names.insert(symbol, entity);
 			return true;
 		}
 
 		void remove(std::string const& name)
 		{
-			m_lightSources.erase(name);
-			if (name == m_activeLightSourceName)
+			Symbol symbol = Symbol::find(name);
+			Entity entity = m_names.find(symbol);
+			if (m_names.erase(symbol))
+			{
+				m_registry.destroy(entity);
+			}
+			if (entity == m_activeLight)
 			{
-				m_activeLightSourceName.clear();
+				m_activeLight = {};
 			}
 		}
 
 		void clear()
 		{
-			m_lightSources.clear();
+			for (NameIndex<Entity>::Entry const& entry : m_names.sorted())
+			{
+				m_registry.destroy(entry.handle);
+			}
+			m_names.clear();
+			m_activeLight = {};
 		}
 
-		void draw(ShaderProgram& shaderProgram)
+		/// \brief Makes the lights available to the shaders: the LightBlock
+		///   uniform buffer, the light data, and the lights of each cluster of
+		///   the view frustum.  The shadow maps are assigned to their lights,
+		///   to be rendered by ShadowMaps::render.
+		/// Everything is rebuilt on the CPU every frame, since the editor changes
+		///   lights in place and the clusters follow the camera, but each buffer
+		///   is only uploaded when it differs from what the GPU has; the
+		///   LightBlock is staged in streamBuffer.
+		void draw(Mat4 const& view, Mat4 const& projection, float nearDistance, float farDistance,
+			ShadowMaps& shadowMaps, RingBuffer& streamBuffer)
 		{
-			shaderProgram.enable();
+			if (!m_uniformBuffer)
+			{
+				m_uniformBuffer = std::make_unique<UniformBuffer>();
+				m_uniformBuffer->bind();
+				m_uniformBuffer->bufferData(sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+				m_uniformBuffer->unbind();
+				m_uploaded.lightCount = -1;
+				m_lightBuffer   = std::make_unique<TextureBuffer>(GL_RGBA32F);
+				m_clusterBuffer = std::make_unique<TextureBuffer>(GL_RG32UI);
+				m_indexBuffer   = std::make_unique<TextureBuffer>(GL_R32UI);
+				m_maxIndices    = static_cast<std::size_t>(TextureBuffer::maxTexels());
+			}
+
+			// Directional lights first, as they are not in the clusters
+			m_lights.clear();
+			for (LightComponent const& light : m_registry.pool<LightComponent>().components())
+			{
+				m_lights.emplace_back();
+				light.light->write(m_lights.back());
+			}
+			auto directionalEnd = std::partition(m_lights.begin(), m_lights.end(),
+				[](LightData const& light) { return light.type == LightType::DIRECTIONAL; });
+			std::size_t directionalCount = directionalEnd - m_lights.begin();
+			shadowMaps.assign(m_lights, directionalCount, view, projection, nearDistance, farDistance);
+			m_features = LightFeatures();
+			m_features.lit         = !m_lights.empty();
+			m_features.directional = directionalCount > 0;
+			m_features.spot        = std::any_of(m_lights.begin(), m_lights.end(),
+				[](LightData const& light) { return light.type == LightType::SPOT; });
+			m_features.shadows     = std::any_of(m_lights.begin(), m_lights.end(),
+				[](LightData const& light) { return light.shadow >= 0; });
+			m_clusters.build(m_lights, directionalCount, view, projection, nearDistance, farDistance, m_maxIndices);
+			// The selector bins lights in world space, so it only changes with them
+			if (m_perObjectLights && (!m_selectorCurrent || !same(m_lights, m_uploadedLights)))
+			{
+				m_selector.build(m_lights, directionalCount);
+				m_selectorCurrent = true;
+			}
+
+			m_staging = LightBlock();
+			copy(Vec3(0.9f, 0.9f, 0.9f), m_staging.ambientIntensity);
+			copy(Vec3(0.5f, 0.5f, 0.5f), m_staging.ambientReflection);
+			copy(Vec3(0.8f, 0.8f, 0.8f), m_staging.diffuseReflection);
+			copy(Vec3(1.0f, 1.0f, 1.0f), m_staging.specularReflection);
+			copy(Vec3(0.0f, 0.0f, 0.0f), m_staging.emissiveIntensity);
+			m_staging.specularPower    = 32.0f;
+			m_staging.lightCount       = static_cast<std::int32_t>(m_lights.size());
+			m_staging.directionalCount = static_cast<std::int32_t>(directionalCount);
+			m_staging.clusterCount[0]  = LightClusters::GRID_X;
+			m_staging.clusterCount[1]  = LightClusters::GRID_Y;
+			m_staging.clusterCount[2]  = LightClusters::GRID_Z;
+			m_staging.sliceScale       = m_clusters.sliceScale();
+			m_staging.sliceBias        = m_clusters.sliceBias();
+
+			if (std::memcmp(&m_staging, &m_uploaded, sizeof(LightBlock)) != 0)
+			{
+				m_uniformBuffer->stream(streamBuffer, &m_staging, sizeof(LightBlock));
+				m_uploaded = m_staging;
+			}
+			upload(*m_lightBuffer, m_lights, m_uploadedLights);
+			upload(*m_clusterBuffer, m_clusters.clusters(), m_uploadedClusters);
+			upload(*m_indexBuffer, m_clusters.indices(), m_uploadedIndices);
+
+			m_uniformBuffer->bindBase(LightBlock::BINDING);
+			m_lightBuffer->bindUnit(LightBlock::LIGHT_DATA_UNIT);
+			m_clusterBuffer->bindUnit(LightBlock::CLUSTER_UNIT);
+			m_indexBuffer->bindUnit(LightBlock::LIGHT_INDEX_UNIT);
+		}
 
-			shaderProgram.setUniformInt("uNumLights", size());
-			shaderProgram.setUniformVec3("uAmbientIntensity", Vec3(0.9f, 0.9f, 0.9f));
-			shaderProgram.setUniformVec3("uAmbientReflection", Vec3(0.5f, 0.5f, 0.5f));
-			shaderProgram.setUniformVec3("uDiffuseReflection", Vec3(0.8f, 0.8f, 0.8f));
-			shaderProgram.setUniformVec3("uSpecularReflection", Vec3(1.0f, 1.0f, 1.0f));
-			shaderProgram.setUniformFloat("uSpecularPower", 32.0f);
-			shaderProgram.setUniformVec3("uEmissiveIntensity", Vec3(0.0f, 0.0f, 0.0f));
-			
-			int index = 0;
-			for (auto& pair : m_lightSources)
+		/// \brief Picks the lights of every queued object, so that each reached
+		///   by at most ObjectLights::MAX_LIGHTS lights is lit by those rather
+		///   than by its cluster; does nothing if per-object lights are off.
+		/// \pre draw() has been called this frame.
+		void selectLights(RenderQueue& queue) const
+		{
+			if (!m_perObjectLights)
 			{
-				pair.second->setUniforms(shaderProgram, index);
-				++index;
+				return;
 			}
+			std::vector<RenderCommand>& commands = queue.commands();
+			JobSystem::get().parallelFor(0, commands.size(), SELECT_GRAIN, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i = begin; i < end; ++i)
+					{
+						m_selector.select(commands[i].boundsMin, commands[i].boundsMax, commands[i].lights);
+					}
+				});
+		}
 
-			shaderProgram.disable();
+		/// \return What the lights of the last draw() ask of the shaders.
+		LightFeatures const& features() const
+		{
+			return m_features;
+		}
+
+		void setPerObjectLights(bool enabled)
+		{
+			m_perObjectLights = enabled;
+			m_selectorCurrent = false;
+		}
+
+		bool perObjectLights() const
+		{
+			return m_perObjectLights;
 		}
 
 		bool hasLightSource(std::string const& name)
 		{
-			return m_lightSources.count(name);
+			return m_names.contains(Symbol::find(name));
 		}
 
 		std::shared_ptr<LightSource> getLightSource(std::string const& name)
 		{
-			return m_lightSources[name];
+			return getLightSource(m_names.find(Symbol::find(name)));
+		}
+
+		/// \return The light source of an entity, or nullptr if it is stale.
+		std::shared_ptr<LightSource> getLightSource(Entity entity)
+		{
+			LightComponent* light = m_registry.get<LightComponent>(entity);
+			return light ? light->light : nullptr;
 		}
 
 		void setActiveLightSource(std::string const& activeLightSourceName)
 		{
-			m_activeLightSourceName = activeLightSourceName;
+			m_activeLight = m_names.find(Symbol::find(activeLightSourceName));
+		}
+
+		/// \brief Makes a light source active, or none if the entity is invalid.
+		void setActiveEntity(Entity entity)
+		{
+			m_activeLight = entity;
 		}
 
 		bool hasActiveLightSource() const
 		{
-			return !m_activeLightSourceName.empty();
+			return m_registry.valid(m_activeLight);
 		}
 
 		std::shared_ptr<LightSource> getActiveLightSource()
 		{
-			return m_lightSources[m_activeLightSourceName];
+			return getLightSource(m_activeLight);
 		}
 
-		void changeActiveLightSourceName(std::string const& newActiveLightSourceName)
+		/// \return The active light source, or an invalid entity.
+		Entity activeEntity() const
 		{
-			if (!hasActiveLightSource())
+			return hasActiveLightSource() ? m_activeLight : Entity();
+		}
+
+		/// \brief Renames a light source; the active light source stays active.
+		/// \return false if there is no light source named name or newName is
+		///   taken.
+		bool rename(std::string const& name, std::string const& newName)
+		{
+			Symbol symbol = Symbol::find(name);
+			Entity entity = m_names.find(symbol);
+			if (!entity.valid() || hasLightSource(newName))
 			{
-				return;
+				return false;
 			}
-			auto activeLightSource = getActiveLightSource();
-			remove(m_activeLightSourceName);
-			add(newActiveLightSourceName, activeLightSource);
-			setActiveLightSource(newActiveLightSourceName);
+			Symbol newSymbol(newName);
+			m_names.rename(symbol, newSymbol);
+			m_registry.get<NameComponent>(entity)->name = newSymbol;
+			return true;
 		}
 
+		void changeActiveLightSourceName(std::string const& newActiveLightSourceName)
+		{
+			rename(activeLightSourceName(), newActiveLightSourceName);
+		}
+
+		/// \return The name of the active light source, or an empty string.
 		std::string const& activeLightSourceName() const
 		{
-			return m_activeLightSourceName;
+			static std::string const noName;
+			Registry const& registry = m_registry;
+			NameComponent const* name = registry.get<NameComponent>(m_activeLight);
+			return name ? name->name.str() : noName;
+		}
+
+		/// \return Every light source, sorted by name, without copies.
+		std::vector<NameIndex<Entity>::Entry> const& outliner() const
+		{
+			return m_names.sorted();
+		}
+
+		int size() const
+		{
+			return static_cast<int>(m_names.size());
 		}
 
-		std::vector<std::string> allLightSourceNames() const
+	private:
+		static constexpr std::size_t SELECT_GRAIN = 64;
+
+		template <typename T>
+		static bool same(std::vector<T> const& a, std::vector<T> const& b)
 		{
-			std::vector<std::string> names;
-			names.reserve(m_lightSources.size());
-			for (auto iter = m_lightSources.begin(); iter != m_lightSources.end(); ++iter)
+			return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+		}
+
+		// Uploads data unless it equals what was uploaded last.  An empty buffer
+		// is never read, as nothing counts entries in it
+		template <typename T>
+		static void upload(TextureBuffer& buffer, std::vector<T> const& data, std::vector<T>& uploaded)
+		{
+			if (!same(data, uploaded))
 			{
-				names.push_back(iter->first);
+				buffer.bufferData(data.size() * sizeof(T), data.data());
+				uploaded = data;
 			}
-			return names;
 		}
 
-		int size() const
+		static void copy(Vec3 const& vector, float* floats)
 		{
-			return static_cast<int>(m_lightSources.size());
+			floats[0] = vector.x;
+			floats[1] = vector.y;
+			floats[2] = vector.z;
 		}
 
 	private:
-		std::unordered_map<std::string, std::shared_ptr<LightSource>> m_lightSources;
-		std::string                                                   m_activeLightSourceName;
+		Registry&         m_registry;
+		NameIndex<Entity> m_names;
+		Entity            m_activeLight;
+		LightClusters                  m_clusters;
+		LightSelector                  m_selector;
+		bool                           m_perObjectLights = true;
+		bool                           m_selectorCurrent = false;
+		LightFeatures                  m_features;
+		// What is being built, and what the GPU has.  The buffers are created
+		// by the first draw, so that a SceneLight needs no GL context until then
+		LightBlock                     m_staging;
+		LightBlock                     m_uploaded;
+		std::vector<LightData>         m_lights;
+		std::vector<LightData>         m_uploadedLights;
+		std::vector<std::uint32_t>     m_uploadedClusters;
+		std::vector<std::uint32_t>     m_uploadedIndices;
+		std::unique_ptr<UniformBuffer> m_uniformBuffer;
+		std::unique_ptr<TextureBuffer> m_lightBuffer;
+		std::unique_ptr<TextureBuffer> m_clusterBuffer;
+		std::unique_ptr<TextureBuffer> m_indexBuffer;
+		std::size_t                    m_maxIndices = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/Mesh.h"
+#include "Core/Scene.h"
+#include "Core/SceneLight.h"
+#include "Core/SceneFile.h"
+#include "Core/JobSystem.h"
+#include "Core/Time.h"
+#include "Render/RingBuffer.h"
+
+namespace VenusEngine
+{
+	/// \brief Loads a scene file in the background.
+	/// Tasks on the JobSystem check and decode the geometry of the file; the GL
+	///   thread calls update() once per frame, which starts more decoding and
+	///   streams at most a fixed number of bytes to the GPU through the frame's
+	///   ring buffer region, whose fences keep it from waiting on the GPU.
+	///   Meshes are added to the scene as soon as their vertices are on the
+	///   GPU, in file order, so parents always come before their children.
+	class SceneStreamer
+	{
+	public:
+		// Bytes streamed to the GPU per frame, at most; less when the ring
+		// buffer has less room left
+		static constexpr GLsizeiptr UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+		/// \brief How far the current load is, and what it costs the frame.
+		struct Progress
+		{
+			std::size_t meshesLoaded  = 0;
+			std::size_t meshesTotal   = 0;
+			std::size_t bytesUploaded = 0;
+			std::size_t bytesTotal    = 0;
+			// Time spent in update() during the last frame, and the slowest whole
+			// frame since the load started
+			float       uploadMilliseconds    = 0.0f;
+			float       worstFrameMilliseconds = 0.0f;
+		};
+
+		SceneStreamer() = default;
+
+		~SceneStreamer()
+		{
+			cancel();
+		}
+
+		SceneStreamer(SceneStreamer const&) = delete;
+
+		void operator=(SceneStreamer const&) = delete;
+
+		/// \brief Clears the scene and starts loading a file into it.  The lights
+		///   are added at once; the meshes appear over the next frames.
+		/// \return false if the file cannot be opened; the scene is then left
+		///   unchanged.
+		bool begin(std::string const& path, Scene& scene, SceneLight& sceneLight)
+		{
+			cancel();
+			m_reader = std::make_unique<SceneFile::Reader>();
+			std::size_t lightCount = 0;
+			SceneFile::LightRecord const* lights = nullptr;
+			if (m_reader->open(path))
+			{
+				m_geometries = m_reader->records<SceneFile::GeometryRecord>(SceneFile::SectionType::Geometries, m_geometryCount);
+				m_nodes      = m_reader->records<SceneFile::NodeRecord>(SceneFile::SectionType::Nodes, m_nodeCount);
+				lights       = m_reader->records<SceneFile::LightRecord>(SceneFile::SectionType::Lights, lightCount);
+			}
+			if (!m_geometries || !m_nodes || !lights)
+			{
+				std::cout << "Scene file " << path << " " << m_reader->error() << std::endl;
+				m_reader.reset();
+				return false;
+			}
+
+			scene.clear();
+			sceneLight.clear();
+			for (std::size_t i = 0; i < lightCount; ++i)
+			{
+				if (std::shared_ptr<LightSource> light = SceneFile::makeLightSource(lights[i]))
+				{
+					sceneLight.add(m_reader->string(lights[i].name), light);
+				}
+			}
+
+			m_progress = Progress();
+			m_progress.meshesTotal = m_nodeCount;
+			for (std::size_t i = 0; i < m_geometryCount; ++i)
+			{
+				std::uint32_t section = m_geometries[i].vertexSection;
+				m_progress.bytesTotal += section < m_reader->sectionCount() ? m_reader->section(section).size : 0;
+			}
+			m_meshes.assign(m_geometryCount, {});
+			m_geometryState.assign(m_geometryCount, GeometryState::Pending);
+			// Read by the decoding tasks, which extract occluder positions only
+			// for geometry that an occluder draws
+			m_occluderGeometry.assign(m_geometryCount, false);
+			for (std::size_t i = 0; i < m_nodeCount; ++i)
+			{
+				if ((m_nodes[i].flags & SceneFile::NODE_OCCLUDER) && m_nodes[i].geometry < m_geometryCount)
+				{
+					m_occluderGeometry[m_nodes[i].geometry] = true;
+				}
+			}
+			m_handles.assign(m_nodeCount, {});
+			m_nextNode = 0;
+			m_nextGeometry = 0;
+			m_queuedBytes = 0;
+			m_cancelled = false;
+			startDecoding();
+			return true;
+		}
+
+		/// \brief Stops the current load; the meshes added so far stay in the
+		///   scene.
+		void cancel()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_cancelled = true;
+			}
+			for (JobSystem::TaskHandle const& task : m_decoding)
+			{
+				JobSystem::get().wait(task);
+			}
+			m_decoding.clear();
+			m_decoded.clear();
+			m_upload = {};
+			m_reader.reset();
+		}
+
+		bool isLoading() const
+		{
+			return m_reader != nullptr;
+		}
+
+		/// \brief Streams decoded geometry to the GPU and adds the meshes whose
+		///   geometry is complete.  Call once per frame on the GL thread.
+		/// \param[in] streamBuffer The ring buffer of the frame being recorded.
+		/// \param[in] frameMilliseconds The duration of the last frame, recorded
+		///   while loading.
+		void update(Scene& scene, RingBuffer& streamBuffer, float frameMilliseconds)
+		{
+			if (!isLoading())
+			{
+				return;
+			}
+			Timer timer;
+			m_progress.worstFrameMilliseconds = std::max(m_progress.worstFrameMilliseconds, frameMilliseconds);
+			startDecoding();
+
+			GLsizeiptr budget = std::min(UPLOAD_BUDGET, streamBuffer.available());
+			while (budget > 0)
+			{
+				if (!m_upload.mesh && !startUpload())
+				{
+					break;
+				}
+				GLsizeiptr size = static_cast<GLsizeiptr>(m_upload.mesh->getVertices().size() * sizeof(float));
+				GLsizeiptr chunk = std::min(budget, size - m_upload.offset);
+				if (chunk > 0 && !m_upload.mesh->streamVertices(streamBuffer, m_upload.offset, chunk))
+				{
+					// The alignment of a later chunk took the last bytes of the
+					// ring buffer region; the first chunk always fits
+					break;
+				}
+				m_upload.offset += chunk;
+				budget -= chunk;
+				m_progress.bytesUploaded += static_cast<std::size_t>(chunk);
+				if (m_upload.offset == size)
+				{
+					m_meshes[m_upload.geometry] = std::move(m_upload.mesh);
+					m_geometryState[m_upload.geometry] = GeometryState::Ready;
+					m_upload = {};
+				}
+			}
+
+			addReadyNodes(scene);
+			m_progress.uploadMilliseconds = timer.elapsedMilliseconds();
+			if (m_nextNode == m_nodeCount)
+			{
+				cancel();
+			}
+		}
+
+		/// \return The progress of the current load, or of the last one.
+		Progress const& progress() const
+		{
+			return m_progress;
+		}
+
+	private:
+		// Decoding tasks running at the same time, leaving the other workers to
+		// the frame
+		static constexpr std::size_t MAX_DECODING = 4;
+		// No more decoding starts while this many bytes of decoded geometry wait
+		// for upload, so decoding cannot run far ahead of the GPU
+		static constexpr std::size_t MAX_QUEUED_BYTES = 256 * 1024 * 1024;
+
+		enum class GeometryState
+		{
+			Pending,
+			Ready,
+			Failed
+		};
+
+		// The mesh whose vertices are being streamed, maybe over several frames
+		struct Upload
+		{
+			std::shared_ptr<Mesh> mesh;
+			std::size_t           geometry = 0;
+			GLsizeiptr            offset   = 0;
+		};
+
+		// Replaces the decoding tasks that stopped, while geometry is left
+		void startDecoding()
+		{
+			m_decoding.erase(std::remove_if(m_decoding.begin(), m_decoding.end(),
+				[](JobSystem::TaskHandle const& task) { return task->isDone(); }), m_decoding.end());
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_queuedBytes >= MAX_QUEUED_BYTES)
+				{
+					return;
+				}
+			}
+			while (m_decoding.size() < MAX_DECODING && m_nextGeometry.load() < m_geometryCount)
+			{
+				m_decoding.push_back(JobSystem::get().submit([this] { decodeGeometries(); }));
+			}
+		}
+
+		// Task: decodes geometries until all are taken, or until too many bytes
+		// wait for upload; it never blocks a worker
+		void decodeGeometries()
+		{
+			for (;;)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (m_cancelled || m_queuedBytes >= MAX_QUEUED_BYTES)
+					{
+						return;
+					}
+				}
+				std::size_t index = m_nextGeometry.fetch_add(1);
+				if (index >= m_geometryCount)
+				{
+					return;
+				}
+				decode(index);
+			}
+		}
+
+		// Checks and decodes one geometry
+		void decode(std::size_t index)
+		{
+			SceneFile::GeometryRecord const& geometry = m_geometries[index];
+			std::unique_ptr<Mesh::Data> data;
+			bool hasIndices = geometry.indexSection != SceneFile::NONE;
+			if (m_reader->verify(geometry.vertexSection) && (!hasIndices || m_reader->verify(geometry.indexSection)))
+			{
+				data = std::make_unique<Mesh::Data>();
+				auto const* vertices = static_cast<float const*>(m_reader->bytes(geometry.vertexSection));
+				std::size_t floatCount = m_reader->section(geometry.vertexSection).size / sizeof(float);
+				data->vertices.assign(vertices, vertices + floatCount);
+				if (hasIndices)
+				{
+					auto const* indices = static_cast<unsigned int const*>(m_reader->bytes(geometry.indexSection));
+					data->indices.assign(indices, indices + m_reader->section(geometry.indexSection).size / sizeof(unsigned int));
+				}
+				data->localMin          = Vec3(geometry.localMin);
+				data->localMax          = Vec3(geometry.localMax);
+				if (m_occluderGeometry[index])
+				{
+					data->occluderPositions = Mesh::extractPositions(vertices, floatCount);
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_cancelled)
+			{
+				m_queuedBytes += data ? data->vertices.size() * sizeof(float) : 0;
+				m_decoded[index] = std::move(data);
+			}
+		}
+
+		// Takes the decoded geometry with the lowest index and allocates its
+		// buffer; geometries that failed to decode are skipped
+		bool startUpload()
+		{
+			std::unique_ptr<Mesh::Data> data;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				while (!m_decoded.empty() && !data)
+				{
+					auto first = m_decoded.begin();
+					m_upload.geometry = first->first;
+					data = std::move(first->second);
+					m_decoded.erase(first);
+					if (!data)
+					{
+						m_geometryState[m_upload.geometry] = GeometryState::Failed;
+						std::cout << "Scene file has a corrupt mesh; it was skipped" << std::endl;
+					}
+				}
+				if (data)
+				{
+					m_queuedBytes -= data->vertices.size() * sizeof(float);
+				}
+			}
+			if (!data)
+			{
+				return false;
+			}
+			m_upload.mesh = std::make_shared<Mesh>();
+			m_upload.mesh->allocateVao(std::move(*data));
+			m_upload.offset = 0;
+			return true;
+		}
+
+		// Adds nodes in file order until one waits for its geometry
+		void addReadyNodes(Scene& scene)
+		{
+			for (; m_nextNode < m_nodeCount; ++m_nextNode)
+			{
+				SceneFile::NodeRecord const& node = m_nodes[m_nextNode];
+				GeometryState state = node.geometry < m_geometryCount ? m_geometryState[node.geometry] : GeometryState::Failed;
+				if (state == GeometryState::Pending)
+				{
+					return;
+				}
+				++m_progress.meshesLoaded;
+				if (state == GeometryState::Failed)
+				{
+					continue;
+				}
+				// The editor stays usable while loading: a mesh the user made
+				// meanwhile keeps its name, and a parent they deleted is skipped
+				Scene::MeshHandle handle = scene.add(freeName(scene, m_reader->string(node.name)), m_meshes[node.geometry]);
+				if (node.parent < m_nextNode && scene.contains(m_handles[node.parent]))
+				{
+					scene.setParent(handle, m_handles[node.parent]);
+				}
+				SceneFile::applyNode(node, scene, handle);
+				m_handles[m_nextNode] = handle;
+			}
+		}
+
+		// name, or name with the first free suffix if the scene has it
+		static std::string freeName(Scene const& scene, std::string const& name)
+		{
+			if (!scene.hasMesh(name))
+			{
+				return name;
+			}
+			for (int suffix = 1;; ++suffix)
+			{
+				std::string candidate = name + "_" + std::to_string(suffix);
+				if (!scene.hasMesh(candidate))
+				{
+					std::cout << "Mesh " << name << " is already in the scene; loaded as " << candidate << std::endl;
+					return candidate;
+				}
+			}
+		}
+
+	private:
+		std::unique_ptr<SceneFile::Reader> m_reader;
+		SceneFile::GeometryRecord const*   m_geometries    = nullptr;
+		SceneFile::NodeRecord const*       m_nodes         = nullptr;
+		std::size_t                        m_geometryCount = 0;
+		std::size_t                        m_nodeCount     = 0;
+
+		// Shared with the decoding tasks
+		std::atomic<std::size_t>                              m_nextGeometry{ 0 };
+		std::mutex                                            m_mutex;
+		std::map<std::size_t, std::unique_ptr<Mesh::Data>>    m_decoded;
+		std::size_t                                           m_queuedBytes = 0;
+		bool                                                  m_cancelled   = false;
+
+		// GL thread only
+		std::vector<JobSystem::TaskHandle> m_decoding;
+		Upload                             m_upload;
+		std::vector<std::shared_ptr<Mesh>> m_meshes;
+		std::vector<GeometryState>         m_geometryState;
+		std::vector<bool>                  m_occluderGeometry;
+		std::vector<Scene::MeshHandle>     m_handles;
+		std::size_t                        m_nextNode     = 0;
+		Progress                           m_progress;
+	};
+}
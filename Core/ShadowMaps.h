@@ -0,0 +1,556 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Math/MathHeaders.h"
+#include "Core/Components.h"
+#include "Core/Frustum.h"
+#include "Core/LightSource.h"
+#include "Core/Registry.h"
+#include "Core/Scene.h"
+#include "Render/GLState.h"
+#include "Render/LightBlock.h"
+#include "Render/RenderStats.h"
+#include "Render/RingBuffer.h"
+#include "Render/ShaderProgram.h"
+#include "Render/ShadowAtlas.h"
+#include "Render/UniformBuffer.h"
+
+namespace VenusEngine
+{
+	/// \brief Shadow maps of the directional and spot lights, in the tiles of
+	///   one ShadowAtlas.
+	/// The first directional light gets ShadowBlock::CASCADES maps, fitted to
+	///   consecutive slices of the camera frustum; the spot lights nearest the
+	///   camera get one map each, as long as tiles are left.  Point lights
+	///   cast no shadows.
+	/// A mesh that has not moved for SETTLE_FRAMES frames is a static caster.
+	///   Static casters are drawn into the static layer of the atlas, which
+	///   keeps a map until its light moves, or a static caster among the
+	///   casters of that map moves, appears or disappears.  Every frame the maps that need it are copied to the
+	///   live layer and the moving casters are drawn over them.
+	class ShadowMaps
+	{
+	public:
+		ShadowMaps(Registry& registry, std::string const& vertexShaderName, std::string const& fragmentShaderName)
+			: m_registry(registry)
+		{
+			m_registry.pool<MovingComponent>();
+			m_registry.pool<StaticCasterComponent>();
+			if (!m_program.build(vertexShaderName, fragmentShaderName))
+			{
+				throw std::runtime_error("failed to build the shadow map program " + vertexShaderName + " + " +
+					fragmentShaderName);
+			}
+			m_worldUniform               = m_program.uniform<Mat4>("uWorld");
+			m_lightViewProjectionUniform = m_program.uniform<Mat4>("uLightViewProjection");
+		}
+
+		ShadowMaps(ShadowMaps const&) = delete;
+
+		void operator=(ShadowMaps const&) = delete;
+
+		/// \brief Sorts the meshes into static and moving casters, and marks
+		///   the cached maps whose static casters changed for a redraw.
+		/// \param[in] changed The entities whose world matrix changed this frame.
+		/// \param[in,out] sceneChanges The removals and opacity edits since the
+		///   last update; cleared.
+		void update(std::vector<Entity> const& changed, SceneChanges& sceneChanges)
+		{
+			if (sceneChanges.everything)
+			{
+				for (Tile& tile : m_tiles)
+				{
+					tile.cached = false;
+				}
+			}
+			for (std::pair<Vec3, Vec3> const& bounds : sceneChanges.bounds)
+			{
+				invalidate(bounds.first, bounds.second);
+			}
+			sceneChanges.clear();
+
+			ComponentPool<MovingComponent>& moving = m_registry.pool<MovingComponent>();
+			for (Entity entity : changed)
+			{
+				if (!m_registry.get<RenderableComponent>(entity))
+				{
+					continue;
+				}
+				if (MovingComponent* component = moving.get(entity))
+				{
+					component->idleFrames = 0;
+				}
+				else
+				{
+					// It leaves the static layer, which still shows it where it was
+					if (StaticCasterComponent const* cached = m_registry.get<StaticCasterComponent>(entity))
+					{
+						invalidate(cached->worldMin, cached->worldMax);
+						m_registry.remove<StaticCasterComponent>(entity);
+					}
+					m_registry.add(entity, MovingComponent());
+				}
+			}
+
+			// Meshes that stopped moving join the static layer
+			m_settled.clear();
+			for (std::size_t i = 0; i < moving.size(); ++i)
+			{
+				if (++moving.components()[i].idleFrames > SETTLE_FRAMES)
+				{
+					m_settled.push_back(moving.entities()[i]);
+				}
+			}
+			for (Entity entity : m_settled)
+			{
+				m_registry.remove<MovingComponent>(entity);
+				if (BoundsComponent const* bounds = m_registry.get<BoundsComponent>(entity))
+				{
+					invalidate(bounds->worldMin, bounds->worldMax);
+					m_registry.add(entity, StaticCasterComponent{ bounds->worldMin, bounds->worldMax });
+				}
+			}
+		}
+
+		/// \brief Gives shadow maps to the lights that get one, and sets the
+		///   shadow index of every light.
+		/// \param[in,out] lights The directional lights, then the point and spot
+		///   lights.
+		void assign(std::vector<LightData>& lights, std::size_t directionalCount, Mat4 const& view,
+			Mat4 const& projection, float nearDistance, float farDistance)
+		{
+			m_block = ShadowBlock();
+			m_block.texelSize = 1.0f / ShadowAtlas::SIZE;
+			for (Tile& tile : m_tiles)
+			{
+				tile.used = false;
+			}
+			for (LightData& light : lights)
+			{
+				light.shadow = -1;
+			}
+			if (!m_enabled)
+			{
+				return;
+			}
+
+			int firstSpotTile = 0;
+			Mat4 inverseView = view.inverse();
+			if (directionalCount > 0 && fitCascades(lights[0], inverseView, projection, nearDistance, farDistance))
+			{
+				lights[0].shadow  = 0;
+				firstSpotTile     = ShadowBlock::CASCADES;
+			}
+			assignSpotLights(lights, directionalCount, inverseView.getTrans(), Frustum(projection * view), firstSpotTile);
+
+			for (int tile = 0; tile < ShadowAtlas::TILE_COUNT; ++tile)
+			{
+				if (m_tiles[tile].used)
+				{
+					writeTile(tile);
+				}
+			}
+		}
+
+		/// \brief Brings the shadow maps assigned this frame up to date, and
+		///   makes them available to the shaders.  The ShadowBlock is only
+		///   uploaded when it changes, staged in streamBuffer.
+		/// \post The framebuffer and viewport are those bound before.
+		void render(Scene& scene, RingBuffer& streamBuffer, RenderStats& stats)
+		{
+			if (!m_atlas)
+			{
+				m_atlas         = std::make_unique<ShadowAtlas>();
+				m_uniformBuffer = std::make_unique<UniformBuffer>();
+				m_uniformBuffer->bind();
+				m_uniformBuffer->bufferData(sizeof(ShadowBlock), nullptr, GL_DYNAMIC_DRAW);
+				m_uniformBuffer->unbind();
+				m_uploaded.cascadeCount = -1;
+			}
+			if (std::memcmp(&m_block, &m_uploaded, sizeof(ShadowBlock)) != 0)
+			{
+				m_uniformBuffer->stream(streamBuffer, &m_block, sizeof(ShadowBlock));
+				m_uploaded = m_block;
+			}
+			m_uniformBuffer->bindBase(ShadowBlock::BINDING);
+
+			GLint framebuffer = 0;
+			GLint viewport[4];
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			// The slope of a surface pushes it back against acne, and the
+			// cascades clamp casters in front of their near plane onto it
+			GLState& state = GLState::get();
+			state.setEnabled(GL_POLYGON_OFFSET_FILL, true);
+			glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+			state.setEnabled(GL_BLEND, false);
+			state.depthMask(true);
+			m_program.enable();
+
+			for (int index = 0; index < ShadowAtlas::TILE_COUNT; ++index)
+			{
+				Tile& tile = m_tiles[index];
+				if (!tile.used)
+				{
+					continue;
+				}
+				if (tile.cascade)
+				{
+					state.setEnabled(GL_DEPTH_CLAMP, true);
+				}
+				m_program.set(m_lightViewProjectionUniform, tile.viewProjection);
+
+				bool redraw = !tile.cached || tile.cachedViewProjection != tile.viewProjection;
+				if (redraw)
+				{
+					m_atlas->beginTile(ShadowAtlas::Layer::Static, index);
+					for (Entity entity : scene.queryFrustum(tile.casters))
+					{
+						if (!m_registry.get<MovingComponent>(entity))
+						{
+							drawCaster(entity, streamBuffer, stats);
+						}
+					}
+					tile.cached               = true;
+					tile.cachedViewProjection = tile.viewProjection;
+					tile.cachedCasters        = tile.casters;
+					++stats.shadowMapsRedrawn;
+				}
+
+				m_movingCasters.clear();
+				ComponentPool<MovingComponent> const& moving = m_registry.pool<MovingComponent>();
+				for (Entity entity : moving.entities())
+				{
+					BoundsComponent const* bounds = m_registry.get<BoundsComponent>(entity);
+					if (bounds && tile.casters.classify(bounds->worldMin, bounds->worldMax) != Frustum::Containment::Outside)
+					{
+						m_movingCasters.push_back(entity);
+					}
+				}
+				// The live map equals the static one until moving casters are drawn into it
+				if (redraw || tile.hadMovingCasters || !m_movingCasters.empty())
+				{
+					m_atlas->copyStaticTile(index);
+					for (Entity entity : m_movingCasters)
+					{
+						drawCaster(entity, streamBuffer, stats);
+					}
+					tile.hadMovingCasters = !m_movingCasters.empty();
+				}
+				state.setEnabled(GL_DEPTH_CLAMP, false);
+			}
+
+			state.bindVertexArray(0);
+			m_program.disable();
+			state.setEnabled(GL_POLYGON_OFFSET_FILL, false);
+			state.setEnabled(GL_BLEND, true);
+			state.bindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(framebuffer));
+			state.viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			m_atlas->bindUnit(ShadowBlock::ATLAS_UNIT);
+		}
+
+		void setEnabled(bool enabled)
+		{
+			m_enabled = enabled;
+		}
+
+		bool enabled() const
+		{
+			return m_enabled;
+		}
+
+	private:
+		// Frames a mesh must stand still before it is cached as a static caster
+		static constexpr std::uint32_t SETTLE_FRAMES = 30;
+		// Weight of the logarithmic split of the cascades, against the uniform one
+		static constexpr float CASCADE_SPLIT_LAMBDA = 0.75f;
+		// How far towards a directional light casters are looked for, beyond
+		// the slice of the camera frustum
+		static constexpr float CASTER_REACH = 100.0f;
+		// Spot lights wider than this cannot be covered by one map
+		static constexpr float MAX_SPOT_HALF_ANGLE = 1.4f;
+		static constexpr float SPOT_NEAR           = 0.1f;
+		static constexpr float MAX_SPOT_RANGE      = 100.0f;
+		// Depth bias of the shadow casters, and normal offset of the lookups
+		static constexpr float SLOPE_BIAS           = 2.0f;
+		static constexpr float CONSTANT_BIAS        = 4.0f;
+		static constexpr float NORMAL_OFFSET_TEXELS = 1.5f;
+
+		struct Tile
+		{
+			bool    used    = false;
+			bool    cascade = false;
+			// World space to the clip space of the light
+			Mat4    viewProjection;
+			// Where casters are looked for; for cascades it reaches back
+			// towards the light
+			Frustum casters;
+			float   offsets[2] = {};
+			// What the static layer holds; update() clears cached when a
+			// static caster appears or disappears inside cachedCasters
+			bool          cached        = false;
+			Mat4          cachedViewProjection;
+			Frustum       cachedCasters;
+			// Whether moving casters were drawn over the live copy
+			bool          hadMovingCasters = false;
+		};
+
+		// Fits the cascades of a directional light around slices of the
+		// camera frustum
+		// \return false if the light has no direction
+		bool fitCascades(LightData const& light, Mat4 const& inverseView, Mat4 const& projection,
+			float nearDistance, float farDistance)
+		{
+			Vec3 direction(light.direction);
+			if (direction.squaredLength() <= 0.0f)
+			{
+				return false;
+			}
+			direction.normalise();
+			Vec3 up = std::fabs(direction.y) < 0.99f ? Vec3(0.0f, 1.0f, 0.0f) : Vec3(1.0f, 0.0f, 0.0f);
+			Mat4 lightView = Math::makeLookAtMatrix(Vec3(0.0f, 0.0f, 0.0f), direction, up);
+			// Half extent of the frustum per unit of view depth
+			float tanX = 1.0f / projection[0][0];
+			float tanY = 1.0f / projection[1][1];
+			float spread = tanX * tanX + tanY * tanY;
+
+			float sliceNear = nearDistance;
+			for (int cascade = 0; cascade < ShadowBlock::CASCADES; ++cascade)
+			{
+				float fraction  = static_cast<float>(cascade + 1) / ShadowBlock::CASCADES;
+				float sliceFar  = CASCADE_SPLIT_LAMBDA * nearDistance * std::pow(farDistance / nearDistance, fraction)
+					+ (1.0f - CASCADE_SPLIT_LAMBDA) * (nearDistance + (farDistance - nearDistance) * fraction);
+
+				// A sphere around the slice, centered on the view axis, does not
+				// change as the camera turns
+				float centerDepth = 0.5f * (sliceNear + sliceFar);
+				float nearReach = sliceNear * sliceNear * spread + (centerDepth - sliceNear) * (centerDepth - sliceNear);
+				float farReach  = sliceFar * sliceFar * spread + (sliceFar - centerDepth) * (sliceFar - centerDepth);
+				float radius = std::ceil(std::sqrt(std::max(nearReach, farReach)) * 16.0f) / 16.0f;
+				Vec3 center = lightView.transformAffine(inverseView.transformAffine(Vec3(0.0f, 0.0f, -centerDepth)));
+
+				// Moving the map by whole texels keeps shadow edges from
+				// crawling as the camera moves
+				float texel = 2.0f * radius / ShadowAtlas::TILE_SIZE;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					center[axis] = std::floor(center[axis] / texel) * texel;
+				}
+				float depth = -center.z;
+				Mat4 projectionMap = Math::makeOrthographicProjectionMatrix01(center.x - radius, center.x + radius,
+					center.y - radius, center.y + radius, depth - radius, depth + radius);
+				Mat4 projectionCasters = Math::makeOrthographicProjectionMatrix01(center.x - radius, center.x + radius,
+					center.y - radius, center.y + radius, depth - radius - CASTER_REACH, depth + radius);
+
+				Tile& tile = m_tiles[cascade];
+				tile.used           = true;
+				tile.cascade        = true;
+				tile.viewProjection = projectionMap * lightView;
+				tile.casters        = Frustum(projectionCasters * lightView);
+				tile.offsets[0]     = NORMAL_OFFSET_TEXELS * texel;
+				tile.offsets[1]     = 0.0f;
+				m_block.cascadeSplits[cascade] = sliceFar;
+				sliceNear = sliceFar;
+			}
+			m_block.cascadeCount = ShadowBlock::CASCADES;
+			return true;
+		}
+
+		// Gives the free tiles to the spot lights nearest the camera.  A light
+		// keeps the tile that has its map cached
+		void assignSpotLights(std::vector<LightData>& lights, std::size_t directionalCount,
+			Vec3 const& cameraPosition, Frustum const& cameraFrustum, int firstTile)
+		{
+			m_candidates.clear();
+			for (std::size_t i = directionalCount; i < lights.size(); ++i)
+			{
+				LightData const& light = lights[i];
+				if (light.type != LightType::SPOT || light.range <= 0.0f)
+				{
+					continue;
+				}
+				Vec3 position(light.position);
+				float reach = std::min(light.range, MAX_SPOT_RANGE);
+				if (cameraFrustum.classify(position - Vec3(reach, reach, reach), position + Vec3(reach, reach, reach))
+					== Frustum::Containment::Outside)
+				{
+					continue;
+				}
+				m_candidates.emplace_back((position - cameraPosition).length() - reach, static_cast<std::uint32_t>(i));
+			}
+			std::size_t count = std::min<std::size_t>(m_candidates.size(), ShadowAtlas::TILE_COUNT - firstTile);
+			std::partial_sort(m_candidates.begin(), m_candidates.begin() + count, m_candidates.end());
+
+			m_spots.clear();
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				Spot spot;
+				spot.light = m_candidates[i].second;
+				if (fitSpot(lights[spot.light], spot))
+				{
+					m_spots.push_back(spot);
+				}
+			}
+			// First the lights whose map is cached, then the others in the free tiles
+			for (Spot& spot : m_spots)
+			{
+				for (int tile = firstTile; tile < ShadowAtlas::TILE_COUNT; ++tile)
+				{
+					if (!m_tiles[tile].used && m_tiles[tile].cached && m_tiles[tile].cachedViewProjection == spot.viewProjection)
+					{
+						placeSpot(lights, spot, tile);
+						break;
+					}
+				}
+			}
+			int tile = firstTile;
+			for (Spot& spot : m_spots)
+			{
+				if (lights[spot.light].shadow >= 0)
+				{
+					continue;
+				}
+				while (m_tiles[tile].used)
+				{
+					++tile;
+				}
+				placeSpot(lights, spot, tile);
+			}
+		}
+
+		struct Spot
+		{
+			std::uint32_t light = 0;
+			Mat4          viewProjection;
+			float         perDistanceOffset = 0.0f;
+		};
+
+		// \return false if the light is too wide or has no direction
+		static bool fitSpot(LightData const& light, Spot& spot)
+		{
+			// The shader compares against the unnormalized direction, which
+			// scales the cutoff
+			Vec3 direction(light.direction);
+			float length = direction.length();
+			if (length <= 0.0f)
+			{
+				return false;
+			}
+			float cosAngle = std::min(light.cutoffCosAngle / length, 1.0f);
+			if (cosAngle <= std::cos(MAX_SPOT_HALF_ANGLE))
+			{
+				return false;
+			}
+			// Slightly wider than the cone, so that filtering stays inside
+			float halfAngle = std::acos(cosAngle) + 4.0f / ShadowAtlas::TILE_SIZE;
+			direction /= length;
+			Vec3 position(light.position);
+			Vec3 up = std::fabs(direction.y) < 0.99f ? Vec3(0.0f, 1.0f, 0.0f) : Vec3(1.0f, 0.0f, 0.0f);
+			spot.viewProjection = Math::makePerspectiveMatrix(Radian(2.0f * halfAngle), 1.0f, SPOT_NEAR,
+				std::max(std::min(light.range, MAX_SPOT_RANGE), 2.0f * SPOT_NEAR))
+				* Math::makeLookAtMatrix(position, position + direction, up);
+			spot.perDistanceOffset = NORMAL_OFFSET_TEXELS * 2.0f * std::tan(halfAngle) / ShadowAtlas::TILE_SIZE;
+			return true;
+		}
+
+		void placeSpot(std::vector<LightData>& lights, Spot const& spot, int index)
+		{
+			Tile& tile = m_tiles[index];
+			tile.used           = true;
+			tile.cascade        = false;
+			tile.viewProjection = spot.viewProjection;
+			tile.casters        = Frustum(spot.viewProjection);
+			tile.offsets[0]     = 0.0f;
+			tile.offsets[1]     = spot.perDistanceOffset;
+			lights[spot.light].shadow = index;
+		}
+
+		// Redraws the static layer of the cached maps whose casters a static
+		// caster at these bounds was, or now is, among
+		void invalidate(Vec3 const& worldMin, Vec3 const& worldMax)
+		{
+			for (Tile& tile : m_tiles)
+			{
+				if (tile.cached && tile.cachedCasters.classify(worldMin, worldMax) != Frustum::Containment::Outside)
+				{
+					tile.cached = false;
+				}
+			}
+		}
+
+		// Fills the ShadowBlock entry of a tile; entry i is tile i
+		void writeTile(int index)
+		{
+			Tile const& tile = m_tiles[index];
+			// Clip space to the texture coordinates of the tile, and the depth
+			// range of the window
+			float scale = 1.0f / ShadowAtlas::TILES_PER_ROW;
+			float x = static_cast<float>(ShadowAtlas::tileX(index)) / ShadowAtlas::SIZE;
+			float y = static_cast<float>(ShadowAtlas::tileY(index)) / ShadowAtlas::SIZE;
+			Mat4 toTile = Mat4::IDENTITY;
+			toTile[0][0] = 0.5f * scale;
+			toTile[0][3] = x + 0.5f * scale;
+			toTile[1][1] = 0.5f * scale;
+			toTile[1][3] = y + 0.5f * scale;
+			toTile[2][2] = 0.5f;
+			toTile[2][3] = 0.5f;
+			Mat4 matrix = toTile * tile.viewProjection;
+			for (int row = 0; row < 4; ++row)
+			{
+				for (int col = 0; col < 4; ++col)
+				{
+					m_block.matrices[index][row * 4 + col] = matrix[row][col];
+				}
+			}
+			float margin = 1.5f / ShadowAtlas::SIZE;
+			m_block.tiles[index][0]   = x + margin;
+			m_block.tiles[index][1]   = y + margin;
+			m_block.tiles[index][2]   = x + scale - margin;
+			m_block.tiles[index][3]   = y + scale - margin;
+			m_block.offsets[index][0] = tile.offsets[0];
+			m_block.offsets[index][1] = tile.offsets[1];
+		}
+
+		void drawCaster(Entity entity, RingBuffer& streamBuffer, RenderStats& stats)
+		{
+			RenderableComponent* renderable = m_registry.get<RenderableComponent>(entity);
+			// Blended meshes let light through
+			if (renderable->opacity < 1.0f)
+			{
+				return;
+			}
+			renderable->mesh->uploadVertices(streamBuffer);
+			renderable->mesh->getVertexArray().bind();
+			m_program.set(m_worldUniform, m_registry.get<WorldMatrixComponent>(entity)->matrix);
+			glDrawArrays(GL_TRIANGLES, 0, renderable->mesh->getVertexCount());
+			++stats.shadowDrawCalls;
+		}
+
+	private:
+		Registry&     m_registry;
+		ShaderProgram m_program;
+		Uniform<Mat4> m_worldUniform;
+		Uniform<Mat4> m_lightViewProjectionUniform;
+		bool          m_enabled       = true;
+		Tile          m_tiles[ShadowAtlas::TILE_COUNT];
+		ShadowBlock   m_block;
+		ShadowBlock   m_uploaded;
+		// Created by the first render, so that ShadowMaps needs no atlas until then
+		std::unique_ptr<ShadowAtlas>   m_atlas;
+		std::unique_ptr<UniformBuffer> m_uniformBuffer;
+		// Scratch, kept to reuse the allocations
+		std::vector<Entity>                          m_settled;
+		std::vector<Entity>                          m_movingCasters;
+		std::vector<std::pair<float, std::uint32_t>> m_candidates;
+		std::vector<Spot>                            m_spots;
+	};
+}
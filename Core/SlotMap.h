@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace VenusEngine
+{
+	/// \brief A generational handle into a SlotMap.
+	/// A handle stays valid until its element is erased; after that every lookup
+	///   with it fails, even if the slot has been reused.
+	struct SlotHandle
+	{
+		static constexpr std::uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+		std::uint32_t index      = INVALID_INDEX;
+		std::uint32_t generation = 0;
+
+		bool valid() const
+		{
+			return index != INVALID_INDEX;
+		}
+
+		bool operator==(SlotHandle const& rhs) const
+		{
+			return index == rhs.index && generation == rhs.generation;
+		}
+
+		bool operator!=(SlotHandle const& rhs) const
+		{
+			return !(*this == rhs);
+		}
+	};
+
+	/// \brief Stores values densely with O(1) insert, erase and handle lookup.
+	/// Values are kept contiguous (erase swaps the last value into the hole), so
+	///   iteration touches no holes and no hash nodes.
+	template<typename T>
+	class SlotMap
+	{
+	public:
+		using Handle = SlotHandle;
+
+		SlotMap() = default;
+
+		/// \brief Adds a value.
+		/// \return The handle of the new value.
+		Handle insert(T value)
+		{
+			std::uint32_t slotIndex;
+			if (m_freeHead != Handle::INVALID_INDEX)
+			{
+				slotIndex  = m_freeHead;
+				m_freeHead = m_slots[slotIndex].denseIndex;
+			}
+			else
+			{
+				slotIndex = static_cast<std::uint32_t>(m_slots.size());
+				m_slots.push_back({ 0, 0 });
+			}
+			m_slots[slotIndex].denseIndex = static_cast<std::uint32_t>(m_values.size());
+			m_values.push_back(std::move(value));
+			m_denseToSlot.push_back(slotIndex);
+			return { slotIndex, m_slots[slotIndex].generation };
+		}
+
+		/// \brief Removes the value of a handle.
+		/// \return Whether the handle was valid.
+		/// \post Every handle to the value is stale.
+		bool erase(Handle handle)
+		{
+			if (!contains(handle))
+			{
+				return false;
+			}
+			Slot& slot = m_slots[handle.index];
+			std::uint32_t denseIndex = slot.denseIndex;
+			std::uint32_t lastIndex  = static_cast<std::uint32_t>(m_values.size() - 1);
+			if (denseIndex != lastIndex)
+			{
+				m_values[denseIndex]      = std::move(m_values[lastIndex]);
+				m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+				m_slots[m_denseToSlot[denseIndex]].denseIndex = denseIndex;
+			}
+			m_values.pop_back();
+			m_denseToSlot.pop_back();
+
+			++slot.generation;
+			slot.denseIndex = m_freeHead;
+			m_freeHead      = handle.index;
+			return true;
+		}
+
+		void clear()
+		{
+			for (std::uint32_t denseIndex = 0; denseIndex < m_denseToSlot.size(); ++denseIndex)
+			{
+				std::uint32_t slotIndex = m_denseToSlot[denseIndex];
+				++m_slots[slotIndex].generation;
+				m_slots[slotIndex].denseIndex = m_freeHead;
+				m_freeHead = slotIndex;
+			}
+			m_values.clear();
+			m_denseToSlot.clear();
+		}
+
+		/// \return Whether the handle refers to a live value.
+		bool contains(Handle handle) const
+		{
+			return handle.index < m_slots.size() &&
+				m_slots[handle.index].generation == handle.generation &&
+				m_slots[handle.index].denseIndex < m_values.size() &&
+				m_denseToSlot[m_slots[handle.index].denseIndex] == handle.index;
+		}
+
+		/// \return The value of a handle, or nullptr if the handle is stale.
+		T* get(Handle handle)
+		{
+			return contains(handle) ? &m_values[m_slots[handle.index].denseIndex] : nullptr;
+		}
+
+		T const* get(Handle handle) const
+		{
+			return contains(handle) ? &m_values[m_slots[handle.index].denseIndex] : nullptr;
+		}
+
+		/// \return The handle of the value stored at a dense position.
+		Handle handleAt(std::size_t denseIndex) const
+		{
+			std::uint32_t slotIndex = m_denseToSlot[denseIndex];
+			return { slotIndex, m_slots[slotIndex].generation };
+		}
+
+		std::size_t size() const
+		{
+			return m_values.size();
+		}
+
+		bool empty() const
+		{
+			return m_values.empty();
+		}
+
+		// Dense iteration in storage order
+		typename std::vector<T>::iterator begin() { return m_values.begin(); }
+		typename std::vector<T>::iterator end() { return m_values.end(); }
+		typename std::vector<T>::const_iterator begin() const { return m_values.begin(); }
+		typename std::vector<T>::const_iterator end() const { return m_values.end(); }
+
+		T& operator[](std::size_t denseIndex) { return m_values[denseIndex]; }
+		T const& operator[](std::size_t denseIndex) const { return m_values[denseIndex]; }
+
+	private:
+		struct Slot
+		{
+			// position in m_values while live, next free slot while free
+			std::uint32_t denseIndex;
+			std::uint32_t generation;
+		};
+
+		std::vector<T>             m_values;
+		std::vector<std::uint32_t> m_denseToSlot;
+		std::vector<Slot>          m_slots;
+		std::uint32_t              m_freeHead = Handle::INVALID_INDEX;
+	};
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace VenusEngine
+{
+	/// \brief An interned string: every distinct text is stored once and gets a
+	///   stable ID, so names are compared and hashed as integers and passed
+	///   around without copies.
+	/// Interned texts live until the program ends; they are the names of
+	///   objects, so there are few of them.  The table is not thread-safe and is
+	///   only used on the main thread.
+	class Symbol
+	{
+	public:
+		using Id = std::uint32_t;
+
+		/// \brief The empty string.
+		Symbol() = default;
+
+		/// \brief Interns text, storing it if it is new.
+		explicit Symbol(std::string_view text)
+			: m_id(table().intern(text))
+		{
+		}
+
+		/// \brief Looks up text without storing it.
+		/// \return The symbol of text, or the empty symbol if text has never been
+		///   interned.
+		static Symbol find(std::string_view text)
+		{
+			Table const& symbols = table();
+			auto iter = symbols.ids.find(text);
+			Symbol symbol;
+			symbol.m_id = iter == symbols.ids.end() ? 0 : iter->second;
+			return symbol;
+		}
+
+		std::string const& str() const
+		{
+			return table().strings[m_id];
+		}
+
+		char const* c_str() const
+		{
+			return str().c_str();
+		}
+
+		bool empty() const
+		{
+			return m_id == 0;
+		}
+
+		Id id() const
+		{
+			return m_id;
+		}
+
+		bool operator==(Symbol other) const
+		{
+			return m_id == other.m_id;
+		}
+
+		bool operator!=(Symbol other) const
+		{
+			return m_id != other.m_id;
+		}
+
+	private:
+		struct Table
+		{
+			Table()
+			{
+				strings.emplace_back();
+				ids.emplace(strings.back(), 0);
+			}
+
+			Id intern(std::string_view text)
+			{
+				auto iter = ids.find(text);
+				if (iter != ids.end())
+				{
+					return iter->second;
+				}
+				Id id = static_cast<Id>(strings.size());
+				// A deque never moves its elements, so the views stay valid
+				strings.emplace_back(text);
+				ids.emplace(strings.back(), id);
+				return id;
+			}
+
+			std::deque<std::string>                   strings;
+			std::unordered_map<std::string_view, Id>  ids;
+		};
+
+		static Table& table()
+		{
+			static Table symbols;
+			return symbols;
+		}
+
+	private:
+		Id m_id = 0;
+	};
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Core/Registry.h"
+#include "Core/JobSystem.h"
+
+namespace VenusEngine
+{
+	/// \brief Runs per-frame systems over a Registry.
+	/// Each system declares which component types it reads and writes. Systems
+	///   are grouped into stages: a system runs after every earlier system it
+	///   conflicts with (one writes what the other reads or writes), and the
+	///   systems of one stage run in parallel.
+	/// The pools a system touches must exist before run() is called, because
+	///   creating a pool is not thread-safe.
+	class SystemScheduler
+	{
+	public:
+		using SystemFunction = std::function<void(Registry&)>;
+
+		/// \brief Adds a system; systems keep the order in which they were added
+		///   whenever they conflict.
+		/// \param[in] reads Mask of the component types the system only reads.
+		/// \param[in] writes Mask of the component types the system modifies.
+		void add(std::string const& name, ComponentMask reads, ComponentMask writes, SystemFunction function)
+		{
+			System system{ name, reads, writes, std::move(function), 0 };
+			for (System const& earlier : m_systems)
+			{
+				if (conflicts(earlier, system))
+				{
+					system.stage = std::max(system.stage, earlier.stage + 1);
+				}
+			}
+			m_stageCount = std::max(m_stageCount, system.stage + 1);
+			m_systems.push_back(std::move(system));
+		}
+
+		/// \brief Runs every system once, stage by stage, on the JobSystem.
+		void run(Registry& registry)
+		{
+			JobSystem& jobSystem = JobSystem::get();
+			std::vector<JobSystem::TaskHandle> pending;
+			for (std::size_t stage = 0; stage < m_stageCount; ++stage)
+			{
+				System* inlineSystem = nullptr;
+				for (System& system : m_systems)
+				{
+					if (system.stage != stage)
+					{
+						continue;
+					}
+					if (inlineSystem)
+					{
+						pending.push_back(jobSystem.submit([&system, &registry] { system.function(registry); }));
+					}
+					else
+					{
+						inlineSystem = &system;
+					}
+				}
+				// The calling thread runs one system of the stage itself
+				if (inlineSystem)
+				{
+					inlineSystem->function(registry);
+				}
+				for (JobSystem::TaskHandle const& task : pending)
+				{
+					jobSystem.wait(task);
+				}
+				pending.clear();
+			}
+		}
+
+		std::size_t stageCount() const
+		{
+			return m_stageCount;
+		}
+
+	private:
+		struct System
+		{
+			std::string    name;
+			ComponentMask  reads;
+			ComponentMask  writes;
+			SystemFunction function;
+			std::size_t    stage;
+		};
+
+		static bool conflicts(System const& a, System const& b)
+		{
+			return (a.writes & (b.reads | b.writes)) || (b.writes & (a.reads | a.writes));
+		}
+
+	private:
+		std::vector<System> m_systems;
+		std::size_t         m_stageCount = 0;
+	};
+}
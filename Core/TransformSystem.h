@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "Core/Registry.h"
+#include "Core/Components.h"
+#include "Core/JobSystem.h"
+
+namespace VenusEngine
+{
+	/// \brief Maintains the transform hierarchy and the world matrices.
+	/// Only entities marked dirty, and their descendants, are updated. They are
+	///   updated breadth first, one depth level at a time, so every parent is
+	///   done before its children; the entities of a large level are split
+	///   across threads. A frame in which nothing moved costs one empty check.
+	class TransformSystem
+	{
+	public:
+		static ComponentMask reads()
+		{
+			return Registry::componentMask<TransformComponent, HierarchyComponent>();
+		}
+
+		static ComponentMask writes()
+		{
+			return Registry::componentMask<WorldMatrixComponent>();
+		}
+
+		/// \brief Queues the world matrix of an entity and of all its descendants
+		///   for an update.
+		void markDirty(Entity entity)
+		{
+			m_dirty.push_back(entity);
+		}
+
+		void run(Registry& registry)
+		{
+			m_changed.clear();
+			if (m_dirty.empty())
+			{
+				return;
+			}
+
+			ComponentPool<HierarchyComponent>& hierarchies = registry.pool<HierarchyComponent>();
+			for (Entity entity : m_dirty)
+			{
+				collect(hierarchies, entity);
+			}
+			m_dirty.clear();
+
+			for (std::vector<Entity>& level : m_levels)
+			{
+				updateLevel(registry, level);
+				for (Entity entity : level)
+				{
+					hierarchies.get(entity)->worldDirty = false;
+				}
+				m_changed.insert(m_changed.end(), level.begin(), level.end());
+				level.clear();
+			}
+		}
+
+		/// \return The entities whose world matrix changed during the last run.
+		std::vector<Entity> const& changed() const
+		{
+			return m_changed;
+		}
+
+		/// \brief Moves an entity under a new parent, keeping its world transform.
+		/// \param[in] parent The new parent, or an invalid handle to make child a
+		///   root.
+		/// \return false if parent is child itself or one of its descendants,
+		///   or an entity without a hierarchy, e.g. one that was destroyed.
+		bool setParent(Registry& registry, Entity child, Entity parent)
+		{
+			HierarchyComponent* childNode = registry.get<HierarchyComponent>(child);
+			if (!childNode || childNode->parent == parent)
+			{
+				return childNode != nullptr;
+			}
+			if (parent.valid() && !registry.get<HierarchyComponent>(parent))
+			{
+				return false;
+			}
+			for (Entity ancestor = parent; ancestor.valid(); ancestor = registry.get<HierarchyComponent>(ancestor)->parent)
+			{
+				if (ancestor == child)
+				{
+					return false;
+				}
+			}
+
+			Mat4 world = computeWorldMatrix(registry, child);
+			unlink(registry, child);
+			if (parent.valid())
+			{
+				HierarchyComponent* parentNode = registry.get<HierarchyComponent>(parent);
+				childNode->parent      = parent;
+				childNode->nextSibling = parentNode->firstChild;
+				if (parentNode->firstChild.valid())
+				{
+					registry.get<HierarchyComponent>(parentNode->firstChild)->prevSibling = child;
+				}
+				parentNode->firstChild = child;
+			}
+			setDepth(registry, child, parent.valid() ? registry.get<HierarchyComponent>(parent)->depth + 1 : 0);
+			setWorldMatrix(registry, child, world);
+			return true;
+		}
+
+		/// \brief Unlinks an entity before it is destroyed. Its children become
+		///   children of its parent and keep their world transforms.
+		void detach(Registry& registry, Entity entity)
+		{
+			HierarchyComponent* node = registry.get<HierarchyComponent>(entity);
+			if (!node)
+			{
+				return;
+			}
+			Entity parent = node->parent;
+			while (node->firstChild.valid())
+			{
+				setParent(registry, node->firstChild, parent);
+			}
+			unlink(registry, entity);
+		}
+
+		/// \brief Sets the local transform of an entity so that its world matrix
+		///   becomes world.
+		void setWorldMatrix(Registry& registry, Entity entity, Mat4 const& world)
+		{
+			Entity parent = registry.get<HierarchyComponent>(entity)->parent;
+			Mat4 local = parent.valid() ? computeWorldMatrix(registry, parent).inverse() * world : world;
+			Transform& transform = registry.get<TransformComponent>(entity)->transform;
+			local.decomposition(transform.m_position, transform.m_scale, transform.m_rotation);
+			markDirty(entity);
+		}
+
+		/// \brief Computes the current world matrix by walking up the hierarchy,
+		///   without waiting for the next run.
+		static Mat4 computeWorldMatrix(Registry& registry, Entity entity)
+		{
+			Mat4 world = registry.get<TransformComponent>(entity)->transform.getMatrix();
+			for (Entity ancestor = registry.get<HierarchyComponent>(entity)->parent; ancestor.valid();
+				ancestor = registry.get<HierarchyComponent>(ancestor)->parent)
+			{
+				world = registry.get<TransformComponent>(ancestor)->transform.getMatrix() * world;
+			}
+			return world;
+		}
+
+	private:
+		// Entities updated per task; smaller levels are updated on the calling
+		// thread
+		static constexpr std::size_t PARALLEL_GRAIN = 1024;
+
+		// Adds the subtree of entity to the levels, unless it has already been added
+		void collect(ComponentPool<HierarchyComponent>& hierarchies, Entity root)
+		{
+			HierarchyComponent* rootNode = hierarchies.get(root);
+			if (!rootNode || rootNode->worldDirty)
+			{
+				return;
+			}
+			m_stack.push_back(root);
+			while (!m_stack.empty())
+			{
+				Entity entity = m_stack.back();
+				m_stack.pop_back();
+				HierarchyComponent* node = hierarchies.get(entity);
+				// A marked descendant was collected with its whole subtree
+				if (node->worldDirty)
+				{
+					continue;
+				}
+				node->worldDirty = true;
+				if (node->depth >= m_levels.size())
+				{
+					m_levels.resize(node->depth + 1);
+				}
+				m_levels[node->depth].push_back(entity);
+				for (Entity child = node->firstChild; child.valid(); child = hierarchies.get(child)->nextSibling)
+				{
+					m_stack.push_back(child);
+				}
+			}
+		}
+
+		static void updateLevel(Registry& registry, std::vector<Entity> const& level)
+		{
+			ComponentPool<TransformComponent>& transforms   = registry.pool<TransformComponent>();
+			ComponentPool<HierarchyComponent>& hierarchies  = registry.pool<HierarchyComponent>();
+			ComponentPool<WorldMatrixComponent>& worlds     = registry.pool<WorldMatrixComponent>();
+
+			auto update = [&](std::size_t begin, std::size_t end)
+			{
+				for (std::size_t i = begin; i < end; ++i)
+				{
+					Entity entity = level[i];
+					Mat4 local = transforms.get(entity)->transform.getMatrix();
+					Entity parent = hierarchies.get(entity)->parent;
+					worlds.get(entity)->matrix = parent.valid() ? worlds.get(parent)->matrix * local : local;
+				}
+			};
+
+			JobSystem::get().parallelFor(0, level.size(), PARALLEL_GRAIN, update);
+		}
+
+		static void unlink(Registry& registry, Entity entity)
+		{
+			HierarchyComponent* node = registry.get<HierarchyComponent>(entity);
+			if (node->prevSibling.valid())
+			{
+				registry.get<HierarchyComponent>(node->prevSibling)->nextSibling = node->nextSibling;
+			}
+			else if (node->parent.valid())
+			{
+				registry.get<HierarchyComponent>(node->parent)->firstChild = node->nextSibling;
+			}
+			if (node->nextSibling.valid())
+			{
+				registry.get<HierarchyComponent>(node->nextSibling)->prevSibling = node->prevSibling;
+			}
+			node->parent      = {};
+			node->nextSibling = {};
+			node->prevSibling = {};
+		}
+
+		// Sets the depth of entity and updates the depths of its subtree
+		void setDepth(Registry& registry, Entity entity, std::uint32_t depth)
+		{
+			registry.get<HierarchyComponent>(entity)->depth = depth;
+			for (Entity child = registry.get<HierarchyComponent>(entity)->firstChild; child.valid();
+				child = registry.get<HierarchyComponent>(child)->nextSibling)
+			{
+				setDepth(registry, child, depth + 1);
+			}
+		}
+
+	private:
+		std::vector<Entity>              m_dirty;
+		std::vector<Entity>              m_changed;
+		std::vector<std::vector<Entity>> m_levels;
+		std::vector<Entity>              m_stack;
+	};
+}
@@ -4,24 +4,57 @@
 #include "Editor/Gui.h"
 #include "Core/Scene.h"
 #include "Core/SceneLight.h"
+#include "Core/ShadowMaps.h"
+#include "Core/SceneFile.h"
+#include "Core/SceneStreamer.h"
+#include "Core/SceneEdits.h"
+#include "Core/EditHistory.h"
+#include "Core/SceneGenerator.h"
+#include "Core/Time.h"
+#include "Core/Registry.h"
+#include "Core/SystemScheduler.h"
+#include "Core/TransformSystem.h"
+#include "Core/BoundsSystem.h"
 #include "Core/Camera.h"
 #include "Core/Controller.h"
 #include "Core/MouseBuffer.h"
 #include "Core/WorldAxis.h"
+#include "Render/GLState.h"
 #include "Render/Renderer.h"
 #include "Render/Framebuffer.h"
 #include "Render/Texture.h"
-#include "Render/Renderbuffer.h"
+#include "Render/GBuffer.h"
 
 namespace VenusEngine
 {
 	class World
 	{
 	public:
+        // CPU time of the phases of the last draw(), in milliseconds
+        struct FrameTimings
+        {
+            // picking, editor windows and streamed loads
+            float editor  = 0.0f;
+            // transform, bounds and spatial index updates
+            float update  = 0.0f;
+            // frustum query and start of occlusion rasterization
+            float culling = 0.0f;
+            // camera, lights and render queue building, including the wait for
+            // occlusion culling
+            float queue   = 0.0f;
+            // render queue sorting and submission
+            float submit  = 0.0f;
+            float total   = 0.0f;
+        };
+
         World()
-            // : m_renderer("../Render/Vec3.vert", "../Render/Vec3.frag"),
-            : m_renderer("../Render/GeneralShader.vert", "../Render/GeneralShader.frag"),
+            : m_renderer("GeneralShader.vert", "GeneralShader.frag", "GBuffer.frag",
+                "DeferredLighting.vert", "DeferredLighting.frag"),
               m_camera(Vec3(0.0f, 0.0f, 10.0f), Vec3(), 0.1f, 100.0f, 1200.0f / 900.0f, 60.0f),
+              m_boundsSystem(m_transformSystem),
+              m_scene(m_registry, m_transformSystem),
+              m_sceneLight(m_registry),
+              m_shadowMaps(m_registry, "ShadowDepth.vert", "ShadowDepth.frag"),
               m_worldAxisEnabled(false)
 		{
             m_framebuffer.bind();
@@ -43,16 +76,99 @@ namespace VenusEngine
 
             glReadBuffer(GL_COLOR_ATTACHMENT1);
 
-            m_depthbuffer.bind();
-            m_depthbuffer.storage(Window::get().getWidth(), Window::get().getHeight());
-            m_framebuffer.renderbuffer(GL_DEPTH_ATTACHMENT, m_depthbuffer.id());
-            m_depthbuffer.unbind();
+            // A texture rather than a renderbuffer, as the deferred lighting
+            // pass reads it
+            m_depthTexture.bind();
+            m_depthTexture.image2D(GL_DEPTH_COMPONENT24, Window::get().getWidth(), Window::get().getHeight(), GL_DEPTH_COMPONENT, GL_FLOAT);
+            m_depthTexture.filter(GL_NEAREST);
+            m_depthTexture.unbind();
+            m_framebuffer.texture2D(GL_DEPTH_ATTACHMENT, m_depthTexture.id());
 
             m_framebuffer.unbind();
+
+            m_gBuffer.create(Window::get().getWidth(), Window::get().getHeight(), m_IDTexture.id(), m_depthTexture.id());
+
+            m_systems.add("Transform", TransformSystem::reads(), TransformSystem::writes(),
+                [this](Registry& registry) { m_transformSystem.run(registry); });
+            m_systems.add("Bounds", BoundsSystem::reads(), BoundsSystem::writes(),
+                [this](Registry& registry) { m_boundsSystem.run(registry); });
 		}
 
+        /// \brief Removes every mesh and light.
+        void newScene()
+        {
+            m_sceneStreamer.cancel();
+            m_history.clear();
+            m_scene.clear();
+            m_sceneLight.clear();
+        }
+
+        /// \brief Replaces the scene with the one stored in a scene file.  The
+        ///   meshes are streamed in over the following frames.
+        /// \return false if the file cannot be read.
+        bool openScene(std::string const& path)
+        {
+            if (!m_sceneStreamer.begin(path, m_scene, m_sceneLight))
+            {
+                return false;
+            }
+            m_history.clear();
+            return true;
+        }
+
+        bool saveScene(std::string const& path)
+        {
+            return SceneFile::save(path, m_scene, m_sceneLight);
+        }
+
+        /// \brief Replaces the scene with a generated stress scene.
+        /// \return The number of lights added.
+        std::size_t generateScene(SceneGenerator::Settings const& settings)
+        {
+            m_sceneStreamer.cancel();
+            m_history.clear();
+            return SceneGenerator::generate(settings, m_scene, m_sceneLight);
+        }
+
+        /// \brief Places the camera, e.g. along a scripted path.
+        void setCameraPose(Vec3 const& position, Vec3 const& target)
+        {
+            m_camera.lookAt(position, target);
+        }
+
+        FrameTimings const& getFrameTimings() const
+        {
+            return m_frameTimings;
+        }
+
+        void setShadingPath(Renderer::ShadingPath path)
+        {
+            m_renderer.setShadingPath(path);
+        }
+
+        void setShaderVariants(bool enabled)
+        {
+            m_renderer.setShaderVariants(enabled);
+        }
+
+        RenderStats const& getRenderStats() const
+        {
+            return m_renderer.getStats();
+        }
+
+        void undo()
+        {
+            m_history.undo();
+        }
+
+        void redo()
+        {
+            m_history.redo();
+        }
+
 		void tick(float deltaTime)
 		{
+            m_frameMilliseconds = deltaTime;
             // Check for quit
             if (m_controller.shouldExitWorld())
             {
@@ -70,6 +186,17 @@ namespace VenusEngine
                 }
             }
 
+            // Undo/Redo, unless a text field has the keyboard
+            bool control = Input::IsKeyPressed(GLFW_KEY_LEFT_CONTROL) || Input::IsKeyPressed(GLFW_KEY_RIGHT_CONTROL);
+            if (KeyBuffer::getPressedKey(GLFW_KEY_Z) && control && !Gui::wantsTextInput())
+            {
+                undo();
+            }
+            if (KeyBuffer::getPressedKey(GLFW_KEY_Y) && control && !Gui::wantsTextInput())
+            {
+                redo();
+            }
+
             // Enable/Disable World Axis
             if (KeyBuffer::getPressedKey(GLFW_KEY_A))
             {
@@ -81,6 +208,8 @@ namespace VenusEngine
 
 		void draw()
 		{
+            Timer frameTimer, phaseTimer;
+            m_renderer.beginFrame();
             m_framebuffer.bind();
 
             // update active Mesh by selection
@@ -101,12 +230,12 @@ namespace VenusEngine
                 if (id != -1)
                 {
                     m_scene.setActiveMeshByID(id);
-                    m_sceneLight.setActiveLightSource({});
+                    m_sceneLight.setActiveEntity({});
                 }
             }
 
             // update glviewport pos and size
-            glViewport(0, m_tabBarHeight, m_viewportSize.first, m_viewportSize.second);
+            GLState::get().viewport(0, m_tabBarHeight, m_viewportSize.first, m_viewportSize.second);
             
             m_texture.bind();
             m_texture.image2D(GL_RGBA, GLsizei(m_viewportSize.first), GLsizei(m_viewportSize.second), GL_RGBA, GL_UNSIGNED_BYTE);
@@ -116,48 +245,86 @@ namespace VenusEngine
             m_IDTexture.image2D(GL_R32I, GLsizei(m_viewportSize.first), GLsizei(m_viewportSize.second), GL_RED_INTEGER, GL_INT);
             m_IDTexture.unbind();
 
-            m_depthbuffer.bind();
-            m_depthbuffer.storage(GLsizei(m_viewportSize.first), GLsizei(m_viewportSize.second));
-            m_depthbuffer.unbind();
+            m_depthTexture.bind();
+            m_depthTexture.image2D(GL_DEPTH_COMPONENT24, GLsizei(m_viewportSize.first), GLsizei(m_viewportSize.second), GL_DEPTH_COMPONENT, GL_FLOAT);
+            m_depthTexture.unbind();
+
+            m_gBuffer.resize(GLsizei(m_viewportSize.first), GLsizei(m_viewportSize.second));
+
+            // Add the meshes of a scene being loaded whose geometry reached the GPU
+            m_sceneStreamer.update(m_scene, m_renderer.getStreamBuffer(), m_frameMilliseconds);
 
             // Draw all meshes window
-            auto const& [isMeshSelected, selectedObjectName] = Gui::allObjectWindow(m_scene, m_sceneLight);
-            // Handle case when user input empty name
-            if (!selectedObjectName.empty())
+            auto const& [isMeshSelected, selectedObject] = Gui::allObjectWindow(m_scene, m_sceneLight, m_history);
+            // Nothing was clicked unless the entity is valid
+            if (selectedObject.valid())
             {
                 if (isMeshSelected)
                 {
-                    m_scene.setActiveMesh(selectedObjectName);
-                    m_sceneLight.setActiveLightSource({});
+                    m_scene.setActiveHandle(selectedObject);
+                    m_sceneLight.setActiveEntity({});
                 }
                 else
                 {
-                    m_scene.setActiveMesh({});
-                    m_sceneLight.setActiveLightSource(selectedObjectName);
+                    m_scene.setActiveHandle({});
+                    m_sceneLight.setActiveEntity(selectedObject);
                 }
             }
 
             // Draw active mesh window
-            Gui::activeObjectWindow(m_scene, m_sceneLight);
+            Gui::activeObjectWindow(m_scene, m_sceneLight, m_history);
+            m_frameTimings.editor = lap(phaseTimer);
+            // Update world matrices and bounds from this frame's edits
+            m_systems.run(m_registry);
+            m_scene.updateSpatialIndex();
+            m_shadowMaps.update(m_transformSystem.changed(), m_scene.changes());
+            m_frameTimings.update = lap(phaseTimer);
+            // Occluders are rasterized on worker threads while the frame is set up
+            Mat4 viewProjection = m_camera.getViewProjectionMatrix();
+            m_scene.beginCulling(Frustum(viewProjection), viewProjection);
+            m_frameTimings.culling = lap(phaseTimer);
             // Clear buffer bit
 			m_renderer.clearBuffer();
             // Render camera
 			m_camera.draw(m_renderer.getShaderProgram());
+            m_renderer.getShaderVariants().forEachReady([this](ShaderProgram& program) { m_camera.draw(program); });
+            bool deferred = m_renderer.shadingPath() == Renderer::ShadingPath::Deferred;
+            if (deferred)
+            {
+                m_camera.draw(m_renderer.getGeometryProgram());
+                m_camera.draw(m_renderer.getLightingProgram());
+            }
             // Render World Axis
             if (m_worldAxisEnabled)
             {
                 m_worldAxis.draw(m_renderer.getShaderProgram());
             }
             // Render Light
-            m_sceneLight.draw(m_renderer.getShaderProgram());
+            m_sceneLight.draw(m_camera.getViewMatrix(), m_camera.getProjectionMatrix(),
+                m_camera.getNearClipPlaneDistance(), m_camera.getFarClipPlaneDistance(), m_shadowMaps,
+                m_renderer.getStreamBuffer());
+            m_shadowMaps.render(m_scene, m_renderer.getStreamBuffer(), m_renderer.getFrameStats());
             // Render Mesh
-			m_scene.draw(m_renderer.getShaderProgram());
+			m_scene.draw(m_renderer.getRenderQueue(), m_renderer.getShaderProgram(), m_renderer.getStreamBuffer(),
+                m_camera.getPosition(), m_renderer.getFrameStats());
+            m_sceneLight.selectLights(m_renderer.getRenderQueue());
+            m_renderer.setLightFeatures(m_sceneLight.features());
+            m_frameTimings.queue = lap(phaseTimer);
+            if (deferred)
+            {
+                m_renderer.drawRenderQueueDeferred(m_gBuffer, m_framebuffer, viewProjection.inverse());
+            }
+            else
+            {
+                m_renderer.drawRenderQueue();
+            }
+            m_frameTimings.submit = lap(phaseTimer);
 
             if (m_scene.hasActiveMesh())
             {
                 m_camera.getViewMatrix().transpose().toData(m_temp_view);
                 m_camera.getProjectionMatrix().transpose().toData(m_temp_proj);
-                m_scene.getActiveMesh()->getTransform().getMatrix().transpose().toData(m_temp_trans);
+                m_scene.getActiveWorldMatrix().transpose().toData(m_temp_trans);
             }
 
             // Draw viewport window
@@ -168,27 +335,56 @@ namespace VenusEngine
             m_viewportPos     = viewportPos;
             m_tabBarHeight    = tabBarHeight;
 
-            if (m_scene.hasActiveMesh())
+            // The gizmo edits the world matrix; the scene converts it back to a
+            // transform local to the parent
+            if (m_scene.hasActiveMesh() && Gui::gizmoIsUsing())
+            {
+                SceneEdits::setWorldMatrix(m_history, m_scene, m_scene.activeHandle(), Mat4(m_temp_trans).transpose());
+            }
+            // A drag in progress keeps adding to the same undo step
+            if (!Gui::isEditing())
             {
-                Transform& trans = m_scene.getActiveMesh()->getTransform();
-                Mat4(m_temp_trans).transpose().decomposition(trans.m_position, trans.m_scale, trans.m_rotation);
+                m_history.seal();
             }
 
             m_framebuffer.unbind();
+            m_renderer.endFrame();
+            m_frameTimings.total = frameTimer.elapsedMilliseconds();
+
+            // Draw statistics of the last finished frame
+            Gui::statisticsWindow(m_renderer.getStats(), m_sceneStreamer);
+            Gui::renderingWindow(m_renderer, m_sceneLight, m_shadowMaps);
 		}
 
+	private:
+        static float lap(Timer& timer)
+        {
+            float milliseconds = timer.elapsedMilliseconds();
+            timer.reset();
+            return milliseconds;
+        }
+
 	private:
 		Renderer   m_renderer;
 		Controller m_controller;
 		Camera     m_camera;
         WorldAxis  m_worldAxis;
+        // Must outlive the Scene and SceneLight views
+        Registry        m_registry;
+        SystemScheduler m_systems;
+        TransformSystem m_transformSystem;
+        BoundsSystem    m_boundsSystem;
 		Scene      m_scene;
         SceneLight m_sceneLight;
+        ShadowMaps m_shadowMaps;
+        SceneStreamer m_sceneStreamer;
+        EditHistory   m_history;
 
         Framebuffer  m_framebuffer;
         Texture      m_texture;
         Texture      m_IDTexture;
-        Renderbuffer m_depthbuffer;
+        Texture      m_depthTexture;
+        GBuffer      m_gBuffer;
 
         bool                    m_viewportFocused;
         std::pair<float, float> m_viewportSize;
@@ -196,6 +392,8 @@ namespace VenusEngine
         float                   m_tabBarHeight;
 
         bool m_worldAxisEnabled;
+        float m_frameMilliseconds = 0.0f;
+        FrameTimings m_frameTimings;
 
     public:
         // This is a temporary fix
@@ -33,32 +33,26 @@ namespace VenusEngine
 			m_vertexBuffer.bufferData(sizeof(lineVertices), lineVertices, GL_STATIC_DRAW);
 
 			// position, normal, color
-			glEnableVertexAttribArray(0);
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), reinterpret_cast<void*>(0));
+			m_vertexArray.setLayout<MeshVertexLayout>();
 
-			glEnableVertexAttribArray(1);
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
-
-			glEnableVertexAttribArray(2);
-			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), reinterpret_cast<void*>(6 * sizeof(float)));
-			
 			m_vertexBuffer.unbind();
 			m_vertexArray.unbind();
 		}
 
-		// draw world axis
-		// call this after camera draw and before light draw
+		// draw world axis, unlit
+		// call this after camera draw
 		void draw(ShaderProgram& shaderProgram)
 		{
 			shaderProgram.enable();
 
-			shaderProgram.setUniformInt("uNumLights", 0);
+			shaderProgram.setUniformInt("uUnlit", 1);
 			shaderProgram.setUniformMat4("uWorld", Mat4::IDENTITY);
 
 			m_vertexArray.bind();
 			glDrawArrays(GL_LINES, 0, 6);
 			m_vertexArray.unbind();
 
+			shaderProgram.setUniformInt("uUnlit", 0);
 			shaderProgram.disable();
 		}
 
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
 #include "Editor/Window.h"
 #include "Editor/Gui.h"
+#include "Editor/FrameBenchmark.h"
 #include "Core/World.h"
 #include "Core/Time.h"
 
@@ -22,21 +27,99 @@ namespace VenusEngine
 
 		void run()
 		{
+			ProgramCache::Stats const& programs = ProgramCache::stats();
+			std::cout << "Built " << programs.programs << " shader programs in " << programs.buildMilliseconds
+				<< " ms, " << programs.loaded << " from the program cache, saving about "
+				<< programs.savedMilliseconds() << " ms" << std::endl;
 			m_timer.reset();
 			while (!m_window.shouldClose())
 			{
 				float deltaTime = m_timer.elapsedMilliseconds();
 				m_timer.reset();
-				Gui::newFrame();
-				Gui::beginDockspace();
-				m_world.tick(deltaTime);
-				m_world.draw();
-				Gui::endDockspace();
-				Gui::draw();
+				frame(deltaTime);
 				m_window.update();
 			}
 		}
 
+		/// \brief Draws a generated scene along a scripted camera path and
+		///   writes a report.  Frames are not synchronized to the display.
+		/// \return The process exit code.
+		int runBenchmark(FrameBenchmark::Settings const& settings)
+		{
+			m_window.setVSync(false);
+			m_world.setShadingPath(settings.shading);
+			m_world.setShaderVariants(settings.shaderVariants);
+			std::size_t lightCount = m_world.generateScene(settings.scene);
+			if (lightCount < settings.scene.lightCount)
+			{
+				std::cout << "Only " << lightCount << " of " << settings.scene.lightCount
+					<< " lights fit in the scene" << std::endl;
+			}
+
+			std::vector<FrameBenchmark::Sample> samples;
+			samples.reserve(settings.frameCount);
+			m_timer.reset();
+			for (int i = -settings.warmupCount; i < settings.frameCount && !m_window.shouldClose(); ++i)
+			{
+				float deltaTime = m_timer.elapsedMilliseconds();
+				m_timer.reset();
+				Vec3 position, target;
+				FrameBenchmark::cameraPose(settings, i, position, target);
+				frame(deltaTime, &position, &target);
+				float cpuMilliseconds = m_timer.elapsedMilliseconds();
+				m_window.update();
+				if (i >= 0)
+				{
+					FrameBenchmark::Sample sample;
+					sample.cpuMilliseconds   = cpuMilliseconds;
+					sample.frameMilliseconds = m_timer.elapsedMilliseconds();
+					sample.phases            = m_world.getFrameTimings();
+					sample.render            = m_world.getRenderStats();
+					samples.push_back(sample);
+				}
+			}
+			return FrameBenchmark::report(settings, lightCount, samples) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+
+	private:
+		// Runs the editor and draws the world once; a camera pose, if given,
+		// overrides the camera controls
+		void frame(float deltaTime, Vec3 const* cameraPosition = nullptr, Vec3 const* cameraTarget = nullptr)
+		{
+			// GL work handed over by tasks
+			JobSystem::get().runMainThreadJobs();
+			Gui::newFrame();
+			auto [menuAction, scenePath] = Gui::beginDockspace();
+			switch (menuAction)
+			{
+			case Gui::MenuAction::NewScene:
+				m_world.newScene();
+				break;
+			case Gui::MenuAction::OpenScene:
+				m_world.openScene(scenePath);
+				break;
+			case Gui::MenuAction::SaveScene:
+				m_world.saveScene(scenePath);
+				break;
+			case Gui::MenuAction::Undo:
+				m_world.undo();
+				break;
+			case Gui::MenuAction::Redo:
+				m_world.redo();
+				break;
+			default:
+				break;
+			}
+			m_world.tick(deltaTime);
+			if (cameraPosition && cameraTarget)
+			{
+				m_world.setCameraPose(*cameraPosition, *cameraTarget);
+			}
+			m_world.draw();
+			Gui::endDockspace();
+			Gui::draw();
+		}
+
 	private:
 		Timer  m_timer;
 		Window m_window;
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <sstream>
+#endif
+
+#include "Math/MathHeaders.h"
+#include "Core/World.h"
+#include "Render/RenderStats.h"
+
+namespace VenusEngine
+{
+	/// \brief The end-to-end frame benchmark: a generated scene is drawn for a
+	///   fixed number of frames along a scripted camera path, and frame times,
+	///   phase times, render counters and memory are written as JSON.
+	/// Run it with "--benchmark frame [--meshes N] [--lights M] [--frames F]
+	///   [--seed S] [--shading forward|deferred] [--variants on|off]
+	///   [--output path]"; runs that differ only in --shading compare the two
+	///   paths on the same frames, and likewise --variants the general forward
+	///   shader with its permutations.
+	class FrameBenchmark
+	{
+	public:
+		struct Settings
+		{
+			SceneGenerator::Settings scene;
+			// Frames measured, after warm-up frames that are drawn but not counted
+			int         frameCount  = 600;
+			int         warmupCount = 60;
+			Renderer::ShadingPath shading = Renderer::ShadingPath::Forward;
+			bool        shaderVariants = true;
+			// The JSON report; it is printed to standard output if empty
+			std::string outputPath  = "frame_benchmark.json";
+		};
+
+		// What was measured in one frame
+		struct Sample
+		{
+			// CPU time from the start of the frame to the buffer swap, and with it
+			float                cpuMilliseconds   = 0.0f;
+			float                frameMilliseconds = 0.0f;
+			World::FrameTimings  phases;
+			RenderStats          render;
+		};
+
+		/// \brief Reads the options that follow "--benchmark frame".
+		/// \return false if an option is unknown or lacks its value.
+		static bool parse(int argc, char* argv[], Settings& settings)
+		{
+			for (int i = 0; i < argc; ++i)
+			{
+				std::string option = argv[i];
+				if (i + 1 >= argc)
+				{
+					std::cerr << "Missing value for " << option << std::endl;
+					return false;
+				}
+				char const* value = argv[++i];
+				if (option == "--meshes")
+				{
+					settings.scene.meshCount = std::strtoul(value, nullptr, 10);
+				}
+				else if (option == "--lights")
+				{
+					settings.scene.lightCount = std::strtoul(value, nullptr, 10);
+				}
+				else if (option == "--frames")
+				{
+					settings.frameCount = std::max(1, std::atoi(value));
+				}
+				else if (option == "--seed")
+				{
+					settings.scene.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+				}
+				else if (option == "--shading")
+				{
+					if (std::string(value) == "forward")
+					{
+						settings.shading = Renderer::ShadingPath::Forward;
+					}
+					else if (std::string(value) == "deferred")
+					{
+						settings.shading = Renderer::ShadingPath::Deferred;
+					}
+					else
+					{
+						std::cerr << "Unknown shading path: " << value << std::endl;
+						return false;
+					}
+				}
+				else if (option == "--variants")
+				{
+					if (std::string(value) == "on" || std::string(value) == "off")
+					{
+						settings.shaderVariants = std::string(value) == "on";
+					}
+					else
+					{
+						std::cerr << "Unknown variants setting: " << value << std::endl;
+						return false;
+					}
+				}
+				else if (option == "--output")
+				{
+					settings.outputPath = value;
+				}
+				else
+				{
+					std::cerr << "Unknown benchmark option: " << option << std::endl;
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// \brief The camera of a frame: one orbit around the scene over the
+		///   measured frames, rising and falling so that both dense and sparse
+		///   views are drawn.  Warm-up frames use negative frames.
+		static void cameraPose(Settings const& settings, int frame, Vec3& position, Vec3& target)
+		{
+			float t      = static_cast<float>(frame) / static_cast<float>(settings.frameCount);
+			float angle  = t * Math::TWO_PI;
+			float radius = settings.scene.halfExtent * 1.5f;
+			position = Vec3(radius * std::cos(angle), settings.scene.halfExtent * 0.5f * std::sin(2.0f * angle),
+				radius * std::sin(angle));
+			target   = Vec3::ZERO;
+		}
+
+		/// \brief Writes the report of a run.
+		/// \return false if the output file cannot be written.
+		static bool report(Settings const& settings, std::size_t lightCount, std::vector<Sample> const& samples)
+		{
+			std::ofstream file;
+			if (!settings.outputPath.empty())
+			{
+				file.open(settings.outputPath);
+				if (!file)
+				{
+					std::cerr << "Cannot write " << settings.outputPath << std::endl;
+					return false;
+				}
+			}
+			std::ostream& out = settings.outputPath.empty() ? std::cout : file;
+
+			std::vector<float> cpu, frame;
+			World::FrameTimings phases;
+			RenderStats render;
+			for (Sample const& sample : samples)
+			{
+				cpu.push_back(sample.cpuMilliseconds);
+				frame.push_back(sample.frameMilliseconds);
+				phases.editor  += sample.phases.editor;
+				phases.update  += sample.phases.update;
+				phases.culling += sample.phases.culling;
+				phases.queue   += sample.phases.queue;
+				phases.submit  += sample.phases.submit;
+				phases.total   += sample.phases.total;
+				render.drawCalls       += sample.render.drawCalls;
+				render.stateChanges    += sample.render.stateChanges;
+				render.visibleObjects  += sample.render.visibleObjects;
+				render.culledObjects   += sample.render.culledObjects;
+				render.occludedObjects += sample.render.occludedObjects;
+				render.streamedBytes   += sample.render.streamedBytes;
+				render.streamStalls    += sample.render.streamStalls;
+				render.shadowMapsRedrawn += sample.render.shadowMapsRedrawn;
+				render.shadowDrawCalls   += sample.render.shadowDrawCalls;
+				render.uniformCalls        += sample.render.uniformCalls;
+				render.uniformCallsSkipped += sample.render.uniformCallsSkipped;
+				render.stateCalls          += sample.render.stateCalls;
+				render.stateCallsSkipped   += sample.render.stateCallsSkipped;
+				render.variantDraws        += sample.render.variantDraws;
+			}
+			float count = static_cast<float>(std::max<std::size_t>(samples.size(), 1));
+
+			out << "{\n";
+			out << "  \"meshes\": " << settings.scene.meshCount << ",\n";
+			out << "  \"lights\": " << lightCount << ",\n";
+			out << "  \"shading\": \"" << (settings.shading == Renderer::ShadingPath::Deferred ? "deferred" : "forward") << "\",\n";
+			out << "  \"shaderVariants\": " << (settings.shaderVariants ? "true" : "false") << ",\n";
+			out << "  \"frames\": " << samples.size() << ",\n";
+			out << "  \"cpuMilliseconds\": ";
+			writeDistribution(out, cpu);
+			out << ",\n  \"frameMilliseconds\": ";
+			writeDistribution(out, frame);
+			out << ",\n  \"phaseMilliseconds\": { "
+				<< "\"editor\": " << phases.editor / count
+				<< ", \"update\": " << phases.update / count
+				<< ", \"culling\": " << phases.culling / count
+				<< ", \"queue\": " << phases.queue / count
+				<< ", \"submit\": " << phases.submit / count
+				<< ", \"draw\": " << phases.total / count << " },\n";
+			out << "  \"perFrame\": { "
+				<< "\"drawCalls\": " << render.drawCalls / count
+				<< ", \"stateChanges\": " << render.stateChanges / count
+				<< ", \"visibleObjects\": " << render.visibleObjects / count
+				<< ", \"culledObjects\": " << render.culledObjects / count
+				<< ", \"occludedObjects\": " << render.occludedObjects / count
+				<< ", \"streamedBytes\": " << render.streamedBytes / count
+				<< ", \"streamStalls\": " << render.streamStalls / count
+				<< ", \"shadowMapsRedrawn\": " << render.shadowMapsRedrawn / count
+				<< ", \"shadowDrawCalls\": " << render.shadowDrawCalls / count
+				<< ", \"uniformCalls\": " << render.uniformCalls / count
+				<< ", \"uniformCallsSkipped\": " << render.uniformCallsSkipped / count
+				<< ", \"stateCalls\": " << render.stateCalls / count
+				<< ", \"stateCallsSkipped\": " << render.stateCallsSkipped / count
+				<< ", \"variantDraws\": " << render.variantDraws / count << " },\n";
+			ProgramCache::Stats const& programs = ProgramCache::stats();
+			out << "  \"programs\": { "
+				<< "\"built\": " << programs.programs
+				<< ", \"fromCache\": " << programs.loaded
+				<< ", \"buildMilliseconds\": " << programs.buildMilliseconds
+				<< ", \"savedMilliseconds\": " << programs.savedMilliseconds()
+				<< ", \"variantsReady\": " << (samples.empty() ? 0 : samples.back().render.variantsReady) << " },\n";
+			std::size_t residentBytes = 0, peakBytes = 0;
+			memoryUsage(residentBytes, peakBytes);
+			out << "  \"memory\": { \"residentBytes\": " << residentBytes << ", \"peakBytes\": " << peakBytes << " }\n";
+			out << "}" << std::endl;
+			return true;
+		}
+
+	private:
+		// Nearest-rank percentile of sorted values
+		static float percentile(std::vector<float> const& sorted, float p)
+		{
+			if (sorted.empty())
+			{
+				return 0.0f;
+			}
+			std::size_t rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+			return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+		}
+
+		static void writeDistribution(std::ostream& out, std::vector<float> values)
+		{
+			std::sort(values.begin(), values.end());
+			float sum = 0.0f;
+			for (float value : values)
+			{
+				sum += value;
+			}
+			out << "{ \"mean\": " << (values.empty() ? 0.0f : sum / values.size())
+				<< ", \"p50\": " << percentile(values, 0.50f)
+				<< ", \"p90\": " << percentile(values, 0.90f)
+				<< ", \"p95\": " << percentile(values, 0.95f)
+				<< ", \"p99\": " << percentile(values, 0.99f)
+				<< ", \"max\": " << (values.empty() ? 0.0f : values.back()) << " }";
+		}
+
+		// The resident and peak resident memory of the process, or zeros where
+		// the platform is not supported
+		static void memoryUsage(std::size_t& residentBytes, std::size_t& peakBytes)
+		{
+			residentBytes = peakBytes = 0;
+#if defined(_WIN32)
+			PROCESS_MEMORY_COUNTERS counters;
+			if (K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			{
+				residentBytes = counters.WorkingSetSize;
+				peakBytes     = counters.PeakWorkingSetSize;
+			}
+#elif defined(__linux__)
+			std::ifstream status("/proc/self/status");
+			std::string line;
+			while (std::getline(status, line))
+			{
+				std::istringstream fields(line);
+				std::string key;
+				std::size_t kilobytes = 0;
+				fields >> key >> kilobytes;
+				if (key == "VmRSS:")
+				{
+					residentBytes = kilobytes * 1024;
+				}
+				else if (key == "VmHWM:")
+				{
+					peakBytes = kilobytes * 1024;
+				}
+			}
+#endif
+		}
+	};
+}
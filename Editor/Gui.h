@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <glad/glad.h>
@@ -12,16 +14,33 @@
 
 #include "Core/Scene.h"
 #include "Core/SceneLight.h"
+#include "Core/ShadowMaps.h"
+#include "Core/SceneStreamer.h"
+#include "Core/SceneEdits.h"
+#include "Core/EditHistory.h"
 #include "Core/Geometry.h"
 #include "Core/KeyBuffer.h"
 #include "Editor/Window.h"
 #include "Math/Transform.h"
+#include "Render/RenderStats.h"
+#include "Render/Renderer.h"
 
 namespace VenusEngine
 {
 	class Gui
 	{
 	public:
+		// What the menu bar asked for during a frame
+		enum class MenuAction
+		{
+			None,
+			NewScene,
+			OpenScene,
+			SaveScene,
+			Undo,
+			Redo
+		};
+
 		static void init(GLFWwindow* window)
 		{
 			IMGUI_CHECKVERSION();
@@ -73,8 +92,14 @@ namespace VenusEngine
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		}
 
-		static void beginDockspace()
+		/// \return The menu action chosen this frame, and the path of the scene
+		///   file it applies to.
+		static std::pair<MenuAction, std::string> beginDockspace()
 		{
+			static char scenePath[256] = "scene.venus";
+			MenuAction action = MenuAction::None;
+			// Open and Save As ask for a path first
+			MenuAction pathAction = MenuAction::None;
 			static bool dockspaceOpen = true;
 			static bool opt_fullscreen_persistant = true;
 			bool opt_fullscreen = opt_fullscreen_persistant;
@@ -117,18 +142,22 @@ namespace VenusEngine
 			{
 				if (ImGui::BeginMenu("File"))
 				{
-					if (ImGui::MenuItem("Open Project..."))
+					if (ImGui::MenuItem("Open Scene..."))
 					{
+						pathAction = MenuAction::OpenScene;
 					}
 					ImGui::Separator();
 					if (ImGui::MenuItem("New Scene"))
 					{
+						action = MenuAction::NewScene;
 					}
 					if (ImGui::MenuItem("Save Scene"))
 					{
+						action = MenuAction::SaveScene;
 					}
 					if (ImGui::MenuItem("Save Scene As..."))
 					{
+						pathAction = MenuAction::SaveScene;
 					}
 					ImGui::Separator();
 					if (ImGui::MenuItem("Exit", "Esc"))
@@ -137,8 +166,41 @@ namespace VenusEngine
 					}
 					ImGui::EndMenu();
 				}
+				if (ImGui::BeginMenu("Edit"))
+				{
+					if (ImGui::MenuItem("Undo", "Ctrl+Z"))
+					{
+						action = MenuAction::Undo;
+					}
+					if (ImGui::MenuItem("Redo", "Ctrl+Y"))
+					{
+						action = MenuAction::Redo;
+					}
+					ImGui::EndMenu();
+				}
 				ImGui::EndMenuBar();
 			}
+
+			// Popups cannot be opened from inside the menu's ID scope
+			static MenuAction pendingAction = MenuAction::None;
+			if (pathAction != MenuAction::None)
+			{
+				pendingAction = pathAction;
+				ImGui::OpenPopup("Scene File");
+			}
+			if (ImGui::BeginPopupModal("Scene File", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+			{
+				bool confirmed = ImGui::InputText("Path", scenePath, sizeof(scenePath), ImGuiInputTextFlags_EnterReturnsTrue);
+				confirmed |= ImGui::Button(pendingAction == MenuAction::OpenScene ? "Open" : "Save");
+				ImGui::SameLine();
+				if (confirmed || ImGui::Button("Cancel"))
+				{
+					action = confirmed ? pendingAction : MenuAction::None;
+					ImGui::CloseCurrentPopup();
+				}
+				ImGui::EndPopup();
+			}
+			return { action, scenePath };
 		}
 
 		static void endDockspace()
@@ -195,12 +257,25 @@ namespace VenusEngine
 			return ImGuizmo::IsUsing();
 		}
 
+		/// \return Whether a widget or the gizmo is being dragged or typed into;
+		///   edits made meanwhile are merged into one undo step.
+		static bool isEditing()
+		{
+			return ImGui::IsAnyItemActive() || ImGuizmo::IsUsing();
+		}
+
+		/// \return Whether keyboard input goes to a text field.
+		static bool wantsTextInput()
+		{
+			return ImGui::GetIO().WantTextInput;
+		}
+
 		static bool gizmoIsOver()
 		{
 			return ImGuizmo::IsOver();
 		}
 
-		static void activeObjectWindow(Scene& scene, SceneLight& sceneLight)
+		static void activeObjectWindow(Scene& scene, SceneLight& sceneLight, EditHistory& history)
 		{
 			ImGui::Begin("Active Object");
 
@@ -221,27 +296,61 @@ namespace VenusEngine
 				if (ImGui::InputText("##", buffer, sizeof(buffer), ImGuiInputTextFlags_EnterReturnsTrue) &&
 					std::strlen(buffer) > 0)
 				{
-					scene.changeActiveMeshName(buffer);
+					SceneEdits::rename(history, scene, scene.activeHandle(), buffer);
 				}
 				ImGui::PopItemWidth();
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
 				ImGui::Text("ID:");
-				ImGui::Text(std::to_string(scene.getActiveMesh()->getID()).c_str());
+				ImGui::Text(std::to_string(scene.activePickID()).c_str());
+
+				ImGui::Dummy(ImVec2(0.0f, 5.0f));
+
+				ImGui::Text("Parent:");
+				std::string const& parentName = scene.activeParentName();
+				ImGui::PushItemWidth(totalWidth);
+				if (ImGui::BeginCombo("##Parent", parentName.empty() ? "None" : parentName.c_str()))
+				{
+					if (ImGui::Selectable("None", parentName.empty()))
+					{
+						SceneEdits::setParent(history, scene, scene.activeHandle(), {});
+					}
+					auto const& meshes = scene.outliner();
+					Scene::MeshHandle parent = scene.getParent(scene.activeHandle());
+					ImGuiListClipper clipper;
+					clipper.Begin(static_cast<int>(meshes.size()));
+					while (clipper.Step())
+					{
+						for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+						{
+							auto const& [name, handle] = meshes[i];
+							if (handle != scene.activeHandle() && ImGui::Selectable(name.c_str(), handle == parent))
+							{
+								// Refused if name is a descendant of the active mesh
+								SceneEdits::setParent(history, scene, scene.activeHandle(), name.str());
+							}
+						}
+					}
+					ImGui::EndCombo();
+				}
+				ImGui::PopItemWidth();
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
-				Transform& transform = scene.getActiveMesh()->getTransform();
+				// Edited on a copy so that the hierarchy is only updated on change
+				Transform transform = scene.getActiveTransform();
+				bool transformChanged = false;
 
 				ImGui::Text("Translation:");
 				ImGui::PushItemWidth(totalWidth);
-				ImGui::InputFloat3("##Translation", transform.m_position.ptr(),
+				transformChanged |= ImGui::InputFloat3("##Translation", transform.m_position.ptr(),
 					"%.3f", ImGuiInputTextFlags_EnterReturnsTrue);
 				ImGui::PopItemWidth();
 				if (ImGui::Button("Reset Translation"))
 				{
 					transform.m_position = Vec3::ZERO;
+					transformChanged = true;
 				}
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
@@ -267,38 +376,66 @@ namespace VenusEngine
 				if (changedX || changedY || changedZ)
 				{
 					transform.m_rotation.fromYawPitchRoll(angleY, angleX, angleZ);
+					transformChanged = true;
 				}
 				if (ImGui::Button("Reset Rotation"))
 				{
 					transform.m_rotation = Quaternion::IDENTITY;
+					transformChanged = true;
 				}
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 				
 				ImGui::Text("Scale:");
 				ImGui::PushItemWidth(totalWidth);
-				ImGui::InputFloat3("##Scale", transform.m_scale.ptr(),
+				transformChanged |= ImGui::InputFloat3("##Scale", transform.m_scale.ptr(),
 					"%.3f", ImGuiInputTextFlags_EnterReturnsTrue);
 				ImGui::PopItemWidth();
 				if (ImGui::Button("Reset Scale"))
 				{
 					transform.m_scale = Vec3::UNIT_SCALE;
+					transformChanged = true;
+				}
+				if (transformChanged)
+				{
+					SceneEdits::setTransform(history, scene, scene.activeHandle(), transform);
 				}
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
 				ImGui::Text("Color:");
-				float* color = scene.getActiveMesh()->getFirstColorPtr();
+				Vec3 meshColor = scene.getActiveMesh()->getColor();
+				float color[3] = { meshColor.x, meshColor.y, meshColor.z };
 				ImGui::PushItemWidth(totalWidth);
-				ImGui::ColorPicker3("##Color", color, ImGuiColorEditFlags_NoSidePreview);
+				bool colorChanged = ImGui::ColorPicker3("##Color", color, ImGuiColorEditFlags_NoSidePreview);
 				ImGui::PopItemWidth();
-				scene.getActiveMesh()->resetColorToFirst();
+				if (colorChanged)
+				{
+					SceneEdits::setColor(history, scene, scene.activeHandle(), Vec3(color));
+				}
+
+				ImGui::Dummy(ImVec2(0.0f, 5.0f));
+
+				ImGui::Text("Opacity:");
+				float opacity = scene.getActiveOpacity();
+				ImGui::PushItemWidth(totalWidth);
+				if (ImGui::SliderFloat("##Opacity", &opacity, 0.0f, 1.0f, "%.2f"))
+				{
+					SceneEdits::setOpacity(history, scene, scene.activeHandle(), opacity);
+				}
+				ImGui::PopItemWidth();
+
+				bool occluder = scene.isActiveOccluder();
+				if (ImGui::Checkbox("Occluder", &occluder))
+				{
+					SceneEdits::setOccluder(history, scene, scene.activeHandle(), occluder);
+				}
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
 				if (ImGui::Button(("Delete##Delete")))
 				{
-					scene.remove(scene.activeMeshName());
+					SceneEdits::removeMesh(history, scene, scene.activeHandle());
 				}
 			}
 			else if (sceneLight.hasActiveLightSource())
@@ -311,13 +448,15 @@ namespace VenusEngine
 				if (ImGui::InputText("##", buffer, sizeof(buffer), ImGuiInputTextFlags_EnterReturnsTrue) &&
 					std::strlen(buffer) > 0)
 				{
-					sceneLight.changeActiveLightSourceName(buffer);
+					SceneEdits::renameLight(history, sceneLight, sceneLight.activeLightSourceName(), buffer);
 				}
 				ImGui::PopItemWidth();
 
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
 				std::shared_ptr<LightSource> activeLightPtr = sceneLight.getActiveLightSource();
+				// The widgets below edit the light in place; compared afterwards
+				SceneFile::LightRecord lightBefore = SceneFile::makeLightRecord(*activeLightPtr);
 
 				if (dynamic_cast<DirectionalLightSource*>(activeLightPtr.get()))
 				{
@@ -453,23 +592,25 @@ namespace VenusEngine
 					ImGui::PopItemWidth();
 				}
 
+				SceneEdits::recordLight(history, sceneLight, sceneLight.activeLightSourceName(), lightBefore);
+
 				ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
 				if (ImGui::Button(("Delete##Delete")))
 				{
-					sceneLight.remove(sceneLight.activeLightSourceName());
+					SceneEdits::removeLight(history, sceneLight, sceneLight.activeLightSourceName());
 				}
 			}
 
 			ImGui::End();
 		}
 
-		// return { isMeshSelected, selectedObjectName }
-		// 0 for Light, 1 for Mesh
-		static std::pair<bool, std::string> allObjectWindow(Scene& scene, SceneLight& sceneLight)
+		// return { isMeshSelected, selectedObject }
+		// 0 for Light, 1 for Mesh; selectedObject is invalid if nothing was clicked
+		static std::pair<bool, Entity> allObjectWindow(Scene& scene, SceneLight& sceneLight, EditHistory& history)
 		{
-			bool isMeshSelected;
-			std::string selectedObjectName;
+			bool isMeshSelected = false;
+			Entity selectedObject;
 
 			ImGui::Begin("All Objects");
 
@@ -499,7 +640,7 @@ namespace VenusEngine
 				std::shared_ptr<Mesh> cube_mesh_ptr(new Mesh());
 				cube_mesh_ptr->addGeometry(geometry);
 				cube_mesh_ptr->prepareVao();
-				scene.add(name, cube_mesh_ptr);
+				SceneEdits::addMesh(history, scene, name, cube_mesh_ptr);
 			}
 
 			static int sphereSubdivisions = 2;
@@ -524,7 +665,7 @@ namespace VenusEngine
 				std::shared_ptr<Mesh> sphere_mesh_ptr(new Mesh());
 				sphere_mesh_ptr->addGeometry(geometry);
 				sphere_mesh_ptr->prepareVao();
-				scene.add(name, sphere_mesh_ptr);
+				SceneEdits::addMesh(history, scene, name, sphere_mesh_ptr);
 			}
 
 			static int cylinderSegments = 50;
@@ -557,7 +698,7 @@ namespace VenusEngine
 				std::shared_ptr<Mesh> cylinder_mesh_ptr(new Mesh());
 				cylinder_mesh_ptr->addGeometry(geometry);
 				cylinder_mesh_ptr->prepareVao();
-				scene.add(name, cylinder_mesh_ptr);
+				SceneEdits::addMesh(history, scene, name, cylinder_mesh_ptr);
 			}
 
 			static int coneSegments = 50;
@@ -590,7 +731,7 @@ namespace VenusEngine
 				std::shared_ptr<Mesh> cone_mesh_ptr(new Mesh());
 				cone_mesh_ptr->addGeometry(geometry);
 				cone_mesh_ptr->prepareVao();
-				scene.add(name, cone_mesh_ptr);
+				SceneEdits::addMesh(history, scene, name, cone_mesh_ptr);
 			}
 
 			static int torusMajorSegments = 50;
@@ -629,7 +770,7 @@ namespace VenusEngine
 				std::shared_ptr<Mesh> torus_mesh_ptr(new Mesh());
 				torus_mesh_ptr->addGeometry(geometry);
 				torus_mesh_ptr->prepareVao();
-				scene.add(name, torus_mesh_ptr);
+				SceneEdits::addMesh(history, scene, name, torus_mesh_ptr);
 			}
 
 			static float pyramidHeight = 2.0f;
@@ -657,7 +798,7 @@ namespace VenusEngine
 				std::shared_ptr<Mesh> pyramid_mesh_ptr(new Mesh());
 				pyramid_mesh_ptr->addGeometry(geometry);
 				pyramid_mesh_ptr->prepareVao();
-				scene.add(name, pyramid_mesh_ptr);
+				SceneEdits::addMesh(history, scene, name, pyramid_mesh_ptr);
 			}
 			
 			ImGui::Dummy(ImVec2(0.0f, 5.0f));
@@ -679,7 +820,7 @@ namespace VenusEngine
 				Vec3 direction(0.0f, 0.0f, -1.0f);
 				std::shared_ptr<DirectionalLightSource> directional_light_ptr(
 					new DirectionalLightSource(diffuseIntensity, specularIntensity, direction));
-				if (!sceneLight.add(name, directional_light_ptr))
+				if (!SceneEdits::addLight(history, sceneLight, name, directional_light_ptr))
 				{
 					std::cout << "Reached light source number limits!" << std::endl;
 				}
@@ -704,7 +845,7 @@ namespace VenusEngine
 				std::shared_ptr<PointLightSource> point_light_ptr(
 					new PointLightSource(diffuseIntensity, specularIntensity, position,
 						attenuationCoefficients));
-				if (!sceneLight.add(name, point_light_ptr))
+				if (!SceneEdits::addLight(history, sceneLight, name, point_light_ptr))
 				{
 					std::cout << "Reached light source number limits!" << std::endl;
 				}
@@ -732,7 +873,7 @@ namespace VenusEngine
 				std::shared_ptr<SpotLightSource> spot_light_ptr(
 					new SpotLightSource(diffuseIntensity, specularIntensity, position,
 						attenuationCoefficients, direction, cutoffCosAngle, falloff));
-				if (!sceneLight.add(name, spot_light_ptr))
+				if (!SceneEdits::addLight(history, sceneLight, name, spot_light_ptr))
 				{
 					std::cout << "Reached light source number limits!" << std::endl;
 				}
@@ -745,20 +886,28 @@ namespace VenusEngine
 
 			ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
-			for (auto const& meshName : scene.allMeshNames())
+			// Only the visible rows are submitted, however many meshes there are
+			auto const& meshes = scene.outliner();
+			ImGuiListClipper meshClipper;
+			meshClipper.Begin(static_cast<int>(meshes.size()));
+			while (meshClipper.Step())
 			{
-				// Use a different color for the active mesh
-				if (meshName == scene.activeMeshName())
-				{
-					ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s (Active)", meshName.c_str());
-				}
-				else
+				for (int i = meshClipper.DisplayStart; i < meshClipper.DisplayEnd; ++i)
 				{
-					ImGui::Text("%-50s", meshName.c_str());
-					if (ImGui::IsItemClicked())
+					auto const& [meshName, handle] = meshes[i];
+					// Use a different color for the active mesh
+					if (handle == scene.activeHandle())
 					{
-						isMeshSelected = true;
-						selectedObjectName = meshName;
+						ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s (Active)", meshName.c_str());
+					}
+					else
+					{
+						ImGui::Text("%-50s", meshName.c_str());
+						if (ImGui::IsItemClicked())
+						{
+							isMeshSelected = true;
+							selectedObject = handle;
+						}
 					}
 				}
 			}
@@ -766,31 +915,106 @@ namespace VenusEngine
 			ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
 			// Display Lights
-			ImGui::Text("All Lights: (Maximum: 16)");
+			ImGui::Text("All Lights: (Maximum: %d)", LightBlock::MAX_LIGHTS);
 
 			ImGui::Dummy(ImVec2(0.0f, 5.0f));
 
-			for (auto const& lightName : sceneLight.allLightSourceNames())
+			auto const& lights = sceneLight.outliner();
+			ImGuiListClipper lightClipper;
+			lightClipper.Begin(static_cast<int>(lights.size()));
+			while (lightClipper.Step())
 			{
-				// Use a different color for the active light
-				if (lightName == sceneLight.activeLightSourceName())
+				for (int i = lightClipper.DisplayStart; i < lightClipper.DisplayEnd; ++i)
 				{
-					ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s (Active)", lightName.c_str());
-				}
-				else
-				{
-					ImGui::Text("%-50s", lightName.c_str());
-					if (ImGui::IsItemClicked())
+					auto const& [lightName, entity] = lights[i];
+					// Use a different color for the active light
+					if (entity == sceneLight.activeEntity())
+					{
+						ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "%s (Active)", lightName.c_str());
+					}
+					else
 					{
-						isMeshSelected = false;
-						selectedObjectName = lightName;
+						ImGui::Text("%-50s", lightName.c_str());
+						if (ImGui::IsItemClicked())
+						{
+							isMeshSelected = false;
+							selectedObject = entity;
+						}
 					}
 				}
 			}
 
 			ImGui::End();
 			
-			return { isMeshSelected, selectedObjectName };
+			return { isMeshSelected, selectedObject };
+		}
+
+		static void statisticsWindow(RenderStats const& stats, SceneStreamer const& sceneStreamer)
+		{
+			ImGui::Begin("Statistics");
+
+			ImGui::Text("Streamed Bytes: %zu", stats.streamedBytes);
+			ImGui::Text("Stream Stalls: %zu", stats.streamStalls);
+			ImGui::Text("Visible Objects: %zu", stats.visibleObjects);
+			ImGui::Text("Culled Objects: %zu", stats.culledObjects);
+			ImGui::Text("Occluded Objects: %zu", stats.occludedObjects);
+			ImGui::Text("Occluder Triangles: %zu", stats.occluderTriangles);
+			ImGui::Text("Draw Calls: %zu", stats.drawCalls);
+			ImGui::Text("State Changes: %zu", stats.stateChanges);
+			ImGui::Text("Shadow Maps Redrawn: %zu", stats.shadowMapsRedrawn);
+			ImGui::Text("Shadow Draw Calls: %zu", stats.shadowDrawCalls);
+			ImGui::Text("Uniform Calls: %zu (%zu skipped)", stats.uniformCalls, stats.uniformCallsSkipped);
+			ImGui::Text("GL State Calls: %zu (%zu skipped)", stats.stateCalls, stats.stateCallsSkipped);
+			ImGui::Text("Shader Variant Draws: %zu", stats.variantDraws);
+			ImGui::Text("Shader Variants: %zu ready, %zu building", stats.variantsReady, stats.variantsBuilding);
+
+			if (sceneStreamer.isLoading())
+			{
+				SceneStreamer::Progress const& progress = sceneStreamer.progress();
+				ImGui::Separator();
+				ImGui::Text("Loading: %zu / %zu meshes", progress.meshesLoaded, progress.meshesTotal);
+				ImGui::Text("Uploaded: %.1f / %.1f MB", progress.bytesUploaded / 1048576.0, progress.bytesTotal / 1048576.0);
+				ImGui::Text("Upload Time: %.2f ms/frame", progress.uploadMilliseconds);
+				ImGui::Text("Worst Frame: %.2f ms", progress.worstFrameMilliseconds);
+			}
+
+			ImGui::End();
+		}
+
+		static void renderingWindow(Renderer& renderer, SceneLight& sceneLight, ShadowMaps& shadowMaps)
+		{
+			ImGui::Begin("Rendering");
+
+			int path = static_cast<int>(renderer.shadingPath());
+			ImGui::Text("Shading:");
+			ImGui::SameLine();
+			bool changed = ImGui::RadioButton("Forward", &path, static_cast<int>(Renderer::ShadingPath::Forward));
+			ImGui::SameLine();
+			changed |= ImGui::RadioButton("Deferred", &path, static_cast<int>(Renderer::ShadingPath::Deferred));
+			if (changed)
+			{
+				renderer.setShadingPath(static_cast<Renderer::ShadingPath>(path));
+			}
+
+			bool shaderVariants = renderer.shaderVariants();
+			if (ImGui::Checkbox("Shader Variants", &shaderVariants))
+			{
+				renderer.setShaderVariants(shaderVariants);
+			}
+
+			bool perObjectLights = sceneLight.perObjectLights();
+			if (ImGui::Checkbox("Per-Object Lights", &perObjectLights))
+			{
+				sceneLight.setPerObjectLights(perObjectLights);
+			}
+
+			bool shadows = shadowMaps.enabled();
+			if (ImGui::Checkbox("Shadows", &shadows))
+			{
+				shadowMaps.setEnabled(shadows);
+			}
+
+			ImGui::End();
 		}
 
 		static std::tuple<bool, std::pair<float, float>, std::pair<float, float>, float> viewportWindow(Scene const& scene, uint64_t textureId, float const* view, float const* projection, float* transform)
@@ -7,6 +7,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Render/GLState.h"
+
 namespace VenusEngine
 {
 	class Window
@@ -56,13 +58,14 @@ namespace VenusEngine
 
 			// grey background color
 			glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-			glEnable(GL_DEPTH_TEST);
-			glEnable(GL_CULL_FACE);
+			GLState& state = GLState::get();
+			state.setEnabled(GL_DEPTH_TEST, true);
+			state.setEnabled(GL_CULL_FACE, true);
 			glFrontFace(GL_CCW);
 			glCullFace(GL_BACK);
-			glEnable(GL_PROGRAM_POINT_SIZE);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			state.setEnabled(GL_PROGRAM_POINT_SIZE, true);
+			state.setEnabled(GL_BLEND, true);
+			state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 			std::memset(m_keyWasPressed, 0, sizeof(m_keyWasPressed));
 
@@ -81,6 +84,13 @@ namespace VenusEngine
 			glfwPollEvents();
 		}
 
+		/// \brief Turns waiting for the display's refresh on buffer swaps on or
+		///   off.
+		void setVSync(bool enabled)
+		{
+			glfwSwapInterval(enabled ? 1 : 0);
+		}
+
 		void closeWindow()
 		{
 			glfwSetWindowShouldClose(m_window, GLFW_TRUE);
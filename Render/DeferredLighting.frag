@@ -0,0 +1,75 @@
+#version 330
+
+/*
+  Filename: DeferredLighting.frag
+  Description: The lighting pass of the deferred path.  Lights every pixel of
+    deferred geometry from the G-buffer with the directional lights and with
+    the point and spot lights of its cluster, the way GeneralShader.frag
+    lights forward geometry.
+*/
+
+precision highp float;
+
+#include "Lighting.glsl"
+
+// The G-buffer: world normal, albedo, and window depth.
+uniform sampler2D uNormal;
+uniform sampler2D uAlbedo;
+uniform sampler2D uDepth;
+
+// Transformation matrices, provided by C++ code.
+uniform mat4 uView;
+// Clip space back to world space.
+uniform mat4 uInverseViewProjection;
+// x, y, width and height of the viewport, in pixels.
+uniform vec4 uViewport;
+
+layout(location = 0) out vec4 fColor;
+
+// **
+
+void
+main ()
+{
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  vec4 albedo = texelFetch(uAlbedo, pixel, 0);
+  if (albedo.a == 0.0)
+  {
+    // Background, or drawn by the forward path
+    discard;
+  }
+  vec3 normalWorld = texelFetch(uNormal, pixel, 0).xyz;
+  float depth = texelFetch(uDepth, pixel, 0).r;
+
+  // Back from window coordinates to world space
+  vec2 ndc = (gl_FragCoord.xy - uViewport.xy) / uViewport.zw * 2.0 - 1.0;
+  vec4 positionWorld = uInverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+  positionWorld /= positionWorld.w;
+  float viewDepth = -(uView * positionWorld).z;
+
+  if (uNumLights == 0)
+  {
+    fColor = vec4(albedo.rgb, 1.0);
+    return;
+  }
+
+  // Handle ambient and emissive light
+  //   It's independent of any particular light
+  vec3 color = uAmbientReflection * uAmbientIntensity + uEmissiveIntensity;
+  // Directional lights reach everything
+  for (int i = 0; i < uNumDirectionalLights; ++i)
+  {
+    color += calculateLighting(fetchLight(i), positionWorld.xyz, normalWorld, viewDepth);
+  }
+  // Point and spot lights only reach the clusters they were assigned to
+  uvec2 cluster = texelFetch(uClusters, clusterIndex(ndc, viewDepth)).xy;
+  for (uint i = 0u; i < cluster.y; ++i)
+  {
+    int index = int(texelFetch(uLightIndices, int(cluster.x + i)).x);
+    color += calculateLighting(fetchLight(index), positionWorld.xyz, normalWorld, viewDepth);
+  }
+  // Stay in bounds [0, 1]
+  color = clamp(color, 0.0, 1.0);
+
+  fColor = vec4(color * albedo.rgb, 1.0);  // Combine vertex color with lighting
+}
@@ -0,0 +1,17 @@
+#version 330
+
+/*
+  Filename: DeferredLighting.vert
+  Description: Covers the screen with one triangle for the lighting pass of
+    the deferred path; it needs no vertex buffer.
+*/
+
+precision highp float;
+
+void
+main (void)
+{
+  // (-1, -1), (3, -1), (-1, 3)
+  vec2 position = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID >> 1) * 4 - 1);
+  gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Render/GLState.h"
+
 namespace VenusEngine
 {
 	class Framebuffer
@@ -15,17 +17,18 @@ namespace VenusEngine
 
 		~Framebuffer()
 		{
+			GLState::get().forgetFramebuffer(m_framebuffer);
 			glDeleteFramebuffers(1, &m_framebuffer);
 		}
 
 		void bind()
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
 		}
 
 		void unbind()
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			GLState::get().bindFramebuffer(GL_FRAMEBUFFER, 0);
 		}
 
 		void texture2D(GLenum attachment, GLuint textureId)
@@ -33,6 +36,11 @@ namespace VenusEngine
 			glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, textureId, 0);
 		}
 
+		GLuint id() const
+		{
+			return m_framebuffer;
+		}
+
 		void renderbuffer(GLenum attachment, GLuint renderbuffer)
 		{
 			glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, renderbuffer);
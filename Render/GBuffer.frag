@@ -0,0 +1,34 @@
+#version 330
+
+/*
+  Filename: GBuffer.frag
+  Description: The geometry pass of the deferred path.  Stores what
+    DeferredLighting.frag needs to light a pixel; GeneralShader.vert provides
+    the inputs.
+*/
+
+precision highp float;
+
+in vec3 vColor;
+in vec3 vPositionWorld;
+in vec3 vNormalWorld;
+in float vViewDepth;
+in vec4 vPositionClip;
+
+// World space normal
+layout(location = 0) out vec4 gNormal;
+// Vertex color; alpha 1 marks the pixel as deferred geometry
+layout(location = 1) out vec4 gAlbedo;
+// buffer to draw id
+layout(location = 2) out int IDColor;
+
+// ID of the object provided by c++ code
+uniform int objectID;
+
+void
+main ()
+{
+  gNormal = vec4(normalize(vNormalWorld), 0.0);
+  gAlbedo = vec4(vColor, 1.0);
+  IDColor = objectID;
+}
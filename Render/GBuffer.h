@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Render/Framebuffer.h"
+#include "Render/GLState.h"
+#include "Render/Texture.h"
+
+namespace VenusEngine
+{
+	/// \brief The geometry buffer of the deferred path: world normal, albedo,
+	///   the object ID and depth per pixel.
+	/// The ID and depth textures are those of the framebuffer the lighting
+	///   pass draws into, so picking reads the same IDs on either path, and
+	///   forward draws after the lighting pass are depth tested against the
+	///   deferred geometry.
+	class GBuffer
+	{
+	public:
+		// Texture units the lighting pass reads the G-buffer from; they follow
+		// the light buffers of LightBlock
+		static constexpr GLuint NORMAL_UNIT = 4;
+		static constexpr GLuint ALBEDO_UNIT = 5;
+		static constexpr GLuint DEPTH_UNIT  = 6;
+
+		/// \brief Allocates the normal and albedo textures and attaches them
+		///   with the shared ID and depth textures.
+		void create(GLsizei width, GLsizei height, GLuint idTexture, GLuint depthTexture)
+		{
+			m_depthTexture = depthTexture;
+			m_framebuffer.bind();
+
+			resize(width, height);
+			m_normalTexture.bind();
+			m_normalTexture.filter(GL_NEAREST);
+			m_normalTexture.unbind();
+			m_framebuffer.texture2D(GL_COLOR_ATTACHMENT0, m_normalTexture.id());
+
+			m_albedoTexture.bind();
+			m_albedoTexture.filter(GL_NEAREST);
+			m_albedoTexture.unbind();
+			m_framebuffer.texture2D(GL_COLOR_ATTACHMENT1, m_albedoTexture.id());
+
+			m_framebuffer.texture2D(GL_COLOR_ATTACHMENT2, idTexture);
+			m_framebuffer.texture2D(GL_DEPTH_ATTACHMENT, depthTexture);
+
+			GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+			glDrawBuffers(3, drawBuffers);
+
+			m_framebuffer.unbind();
+		}
+
+		/// \brief Reallocates normal and albedo if the size changed; the shared
+		///   ID and depth textures are resized by their owner.
+		void resize(GLsizei width, GLsizei height)
+		{
+			if (width == m_width && height == m_height)
+			{
+				return;
+			}
+			m_width  = width;
+			m_height = height;
+			m_normalTexture.bind();
+			m_normalTexture.image2D(GL_RGBA16F, width, height, GL_RGBA, GL_FLOAT);
+			m_normalTexture.unbind();
+			m_albedoTexture.bind();
+			m_albedoTexture.image2D(GL_RGBA8, width, height, GL_RGBA, GL_UNSIGNED_BYTE);
+			m_albedoTexture.unbind();
+		}
+
+		/// \brief Binds the G-buffer for the geometry pass and clears normal and
+		///   albedo; an albedo alpha of 0 marks pixels without deferred
+		///   geometry.  ID and depth keep what was drawn before.
+		void beginGeometryPass()
+		{
+			m_framebuffer.bind();
+			GLfloat const zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			glClearBufferfv(GL_COLOR, 0, zero);
+			glClearBufferfv(GL_COLOR, 1, zero);
+		}
+
+		/// \brief Binds normal, albedo and depth for the lighting pass.
+		void bindTextures()
+		{
+			m_normalTexture.bindUnit(NORMAL_UNIT);
+			m_albedoTexture.bindUnit(ALBEDO_UNIT);
+			GLState::get().bindTexture(DEPTH_UNIT, GL_TEXTURE_2D, m_depthTexture);
+		}
+
+	private:
+		Framebuffer m_framebuffer;
+		Texture     m_normalTexture;
+		Texture     m_albedoTexture;
+		GLuint      m_depthTexture = 0;
+		GLsizei     m_width        = 0;
+		GLsizei     m_height       = 0;
+	};
+}
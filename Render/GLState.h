@@ -0,0 +1,383 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+namespace VenusEngine
+{
+	/// \brief The GL state the engine sets: program, vertex array, buffer,
+	///   texture and framebuffer bindings, viewport, blending and depth.
+	///   Setting a value it already has makes no GL call.
+	/// The wrappers of Render/ set state through here.  Code that changes
+	///   state behind its back, e.g. the ImGui backend, must leave it as it
+	///   found it, or be followed by invalidate(); the renderer invalidates at
+	///   the start of every frame.  Values not known yet, or forgotten, are
+	///   always set.
+	class GLState
+	{
+	public:
+		// Texture units and indexed uniform buffer bindings tracked; higher
+		// ones are always set
+		static constexpr GLuint TEXTURE_UNITS    = 16;
+		static constexpr GLuint UNIFORM_BINDINGS = 16;
+
+		// GL calls made and skipped as redundant since the last reset
+		struct Counters
+		{
+			std::size_t calls   = 0;
+			std::size_t skipped = 0;
+		};
+
+		/// \brief The state of the one GL context of the engine.
+		static GLState& get()
+		{
+			static GLState state;
+			return state;
+		}
+
+		GLState(GLState const&) = delete;
+
+		void operator=(GLState const&) = delete;
+
+		/// \brief Forgets every value, so that the next setting of each is
+		///   made, e.g. after code that does not go through GLState.
+		void invalidate()
+		{
+			m_program     = UNKNOWN;
+			m_vertexArray = UNKNOWN;
+			m_buffers.fill(UNKNOWN);
+			m_uniformBindings.fill(UNKNOWN);
+			for (auto& unit : m_textures)
+			{
+				unit.fill(UNKNOWN);
+			}
+			m_activeTexture     = UNKNOWN;
+			m_drawFramebuffer   = UNKNOWN;
+			m_readFramebuffer   = UNKNOWN;
+			m_viewport          = { -1, -1, -1, -1 };
+			m_capabilities.fill(UNKNOWN_FLAG);
+			m_depthMask         = UNKNOWN_FLAG;
+			m_blendSource       = UNKNOWN;
+			m_blendDestination  = UNKNOWN;
+		}
+
+		Counters& counters()
+		{
+			return m_counters;
+		}
+
+		void useProgram(GLuint program)
+		{
+			if (change(m_program, program))
+			{
+				glUseProgram(program);
+			}
+		}
+
+		void bindVertexArray(GLuint vertexArray)
+		{
+			if (change(m_vertexArray, vertexArray))
+			{
+				glBindVertexArray(vertexArray);
+				// The element array binding belongs to the vertex array
+				m_buffers[bufferSlot(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+			}
+		}
+
+		void bindBuffer(GLenum target, GLuint buffer)
+		{
+			int slot = bufferSlot(target);
+			if (slot < 0 || change(m_buffers[slot], buffer))
+			{
+				glBindBuffer(target, buffer);
+			}
+		}
+
+		/// \brief Binds a whole uniform buffer to an indexed binding point,
+		///   which binds it to the GL_UNIFORM_BUFFER target too.
+		void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+		{
+			bool tracked = target == GL_UNIFORM_BUFFER && index < UNIFORM_BINDINGS;
+			if (tracked && !change(m_uniformBindings[index], buffer))
+			{
+				// Nor does the generic binding change
+				return;
+			}
+			glBindBufferBase(target, index, buffer);
+			if (!tracked)
+			{
+				++m_counters.calls;
+			}
+			int slot = bufferSlot(target);
+			if (slot >= 0)
+			{
+				m_buffers[slot] = buffer;
+			}
+		}
+
+		/// \brief Binds part of a buffer to an indexed binding point; the
+		///   ranges are not tracked, so this always makes the call.
+		void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+		{
+			glBindBufferRange(target, index, buffer, offset, size);
+			++m_counters.calls;
+			if (target == GL_UNIFORM_BUFFER && index < UNIFORM_BINDINGS)
+			{
+				m_uniformBindings[index] = UNKNOWN;
+			}
+			int slot = bufferSlot(target);
+			if (slot >= 0)
+			{
+				m_buffers[slot] = buffer;
+			}
+		}
+
+		/// \brief Binds a texture to a unit and leaves that unit active, so
+		///   that glTexImage2D and glTexParameter calls that follow apply to
+		///   the texture.
+		void bindTexture(GLuint unit, GLenum target, GLuint texture)
+		{
+			int slot = textureSlot(target);
+			bool tracked = slot >= 0 && unit < TEXTURE_UNITS;
+			if (tracked && m_textures[unit][slot] == texture && m_activeTexture == unit)
+			{
+				m_counters.skipped += 2;
+				return;
+			}
+			activeTexture(unit);
+			if (!tracked || change(m_textures[unit][slot], texture))
+			{
+				glBindTexture(target, texture);
+			}
+		}
+
+		/// \param target GL_FRAMEBUFFER binds both the draw and the read
+		///   framebuffer.
+		void bindFramebuffer(GLenum target, GLuint framebuffer)
+		{
+			bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+			bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+			if ((!draw || m_drawFramebuffer == framebuffer) && (!read || m_readFramebuffer == framebuffer))
+			{
+				++m_counters.skipped;
+				return;
+			}
+			glBindFramebuffer(target, framebuffer);
+			++m_counters.calls;
+			if (draw)
+			{
+				m_drawFramebuffer = framebuffer;
+			}
+			if (read)
+			{
+				m_readFramebuffer = framebuffer;
+			}
+		}
+
+		void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+		{
+			std::array<GLint, 4> viewport = { x, y, width, height };
+			if (viewport == m_viewport)
+			{
+				++m_counters.skipped;
+				return;
+			}
+			glViewport(x, y, width, height);
+			++m_counters.calls;
+			m_viewport = viewport;
+		}
+
+		/// \brief glEnable or glDisable.
+		void setEnabled(GLenum capability, bool enabled)
+		{
+			int slot = capabilitySlot(capability);
+			if (slot >= 0 && !change(m_capabilities[slot], flag(enabled)))
+			{
+				return;
+			}
+			if (slot < 0)
+			{
+				++m_counters.calls;
+			}
+			if (enabled)
+			{
+				glEnable(capability);
+			}
+			else
+			{
+				glDisable(capability);
+			}
+		}
+
+		void depthMask(bool enabled)
+		{
+			if (change(m_depthMask, flag(enabled)))
+			{
+				glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+			}
+		}
+
+		void blendFunc(GLenum source, GLenum destination)
+		{
+			if (m_blendSource == source && m_blendDestination == destination)
+			{
+				++m_counters.skipped;
+				return;
+			}
+			glBlendFunc(source, destination);
+			++m_counters.calls;
+			m_blendSource      = source;
+			m_blendDestination = destination;
+		}
+
+		// Called before an object is deleted, as its name may be reused.  A
+		// deleted program stays in use, so what it was bound to is unknown
+		// rather than 0
+
+		void forgetProgram(GLuint program)
+		{
+			forget(m_program, program);
+		}
+
+		void forgetVertexArray(GLuint vertexArray)
+		{
+			forget(m_vertexArray, vertexArray);
+		}
+
+		void forgetBuffer(GLuint buffer)
+		{
+			for (GLuint& bound : m_buffers)
+			{
+				forget(bound, buffer);
+			}
+			for (GLuint& bound : m_uniformBindings)
+			{
+				forget(bound, buffer);
+			}
+		}
+
+		void forgetTexture(GLuint texture)
+		{
+			for (auto& unit : m_textures)
+			{
+				for (GLuint& bound : unit)
+				{
+					forget(bound, texture);
+				}
+			}
+		}
+
+		void forgetFramebuffer(GLuint framebuffer)
+		{
+			forget(m_drawFramebuffer, framebuffer);
+			forget(m_readFramebuffer, framebuffer);
+		}
+
+	private:
+		static constexpr GLuint      UNKNOWN      = ~GLuint(0);
+		static constexpr std::int8_t UNKNOWN_FLAG = -1;
+
+		// The buffer targets, texture targets and capabilities tracked
+		static constexpr int BUFFER_TARGETS  = 6;
+		static constexpr int TEXTURE_TARGETS = 2;
+		static constexpr int CAPABILITIES    = 6;
+
+		GLState()
+		{
+			invalidate();
+		}
+
+		// Stores value and counts the call if it differs
+		template <typename T>
+		bool change(T& current, T value)
+		{
+			if (current == value)
+			{
+				++m_counters.skipped;
+				return false;
+			}
+			current = value;
+			++m_counters.calls;
+			return true;
+		}
+
+		static std::int8_t flag(bool enabled)
+		{
+			return enabled ? 1 : 0;
+		}
+
+		static void forget(GLuint& bound, GLuint name)
+		{
+			if (bound == name)
+			{
+				bound = UNKNOWN;
+			}
+		}
+
+		void activeTexture(GLuint unit)
+		{
+			if (change(m_activeTexture, unit))
+			{
+				glActiveTexture(GL_TEXTURE0 + unit);
+			}
+		}
+
+		static int bufferSlot(GLenum target)
+		{
+			switch (target)
+			{
+			case GL_ARRAY_BUFFER:         return 0;
+			case GL_ELEMENT_ARRAY_BUFFER: return 1;
+			case GL_COPY_READ_BUFFER:     return 2;
+			case GL_COPY_WRITE_BUFFER:    return 3;
+			case GL_UNIFORM_BUFFER:       return 4;
+			case GL_TEXTURE_BUFFER:       return 5;
+			default:                      return -1;
+			}
+		}
+
+		static int textureSlot(GLenum target)
+		{
+			switch (target)
+			{
+			case GL_TEXTURE_2D:     return 0;
+			case GL_TEXTURE_BUFFER: return 1;
+			default:                return -1;
+			}
+		}
+
+		static int capabilitySlot(GLenum capability)
+		{
+			switch (capability)
+			{
+			case GL_BLEND:               return 0;
+			case GL_DEPTH_TEST:          return 1;
+			case GL_CULL_FACE:           return 2;
+			case GL_SCISSOR_TEST:        return 3;
+			case GL_POLYGON_OFFSET_FILL: return 4;
+			case GL_DEPTH_CLAMP:         return 5;
+			default:                     return -1;
+			}
+		}
+
+	private:
+		Counters m_counters;
+		GLuint   m_program     = UNKNOWN;
+		GLuint   m_vertexArray = UNKNOWN;
+		std::array<GLuint, BUFFER_TARGETS>   m_buffers;
+		std::array<GLuint, UNIFORM_BINDINGS> m_uniformBindings;
+		std::array<std::array<GLuint, TEXTURE_TARGETS>, TEXTURE_UNITS> m_textures;
+		GLuint   m_activeTexture   = UNKNOWN;
+		GLuint   m_drawFramebuffer = UNKNOWN;
+		GLuint   m_readFramebuffer = UNKNOWN;
+		std::array<GLint, 4> m_viewport;
+		std::array<std::int8_t, CAPABILITIES> m_capabilities;
+		std::int8_t m_depthMask        = UNKNOWN_FLAG;
+		GLenum      m_blendSource      = UNKNOWN;
+		GLenum      m_blendDestination = UNKNOWN;
+	};
+}
@@ -4,11 +4,38 @@
   Filename: GeneralShader.frag
   Authors: Marshall Feng
   Description: A fragment shader corresponding to the GeneralShader.vert.
+    Lights each fragment with the directional lights and with the point and
+    spot lights picked for its object, or else those of its cluster of the
+    view frustum.
+  Permutations: without defines this is the general shader, which decides
+    everything at run time.  ShaderVariants compiles permutations with
+    PERMUTATION and some of
+      VERTEX_COLOR_ONLY      no lights; the vertex color is the color
+      NO_DIRECTIONAL_LIGHTS  no light is directional
+      NO_SPOT_LIGHTS         no light is a spot light
+      NO_SHADOWS             no light has a shadow map
+      OBJECT_LIGHT_COUNT n   the object is lit by n lights picked for it
+      CLUSTERED_LIGHTS       the object is lit by the lights of its clusters
 */
 
 precision highp float;
 
+#include "Lighting.glsl"
+
+// The lights picked for this object by the C++ code, most relevant first, or
+//   -1 to use the lights of each fragment's cluster.
+const int MAX_OBJECT_LIGHTS = 8;
+uniform int uObjectLightCount;
+uniform int uObjectLights[MAX_OBJECT_LIGHTS];
+
+// Nonzero to draw with the vertex colors alone, e.g. for the world axis.
+uniform int uUnlit;
+
 in vec3 vColor;
+in vec3 vPositionWorld;
+in vec3 vNormalWorld;
+in float vViewDepth;
+in vec4 vPositionClip;
 
 layout(location = 0) out vec4 fColor;
 // buffer to draw id
@@ -16,11 +43,99 @@ layout(location = 1) out int IDColor;
 
 // ID of the object provided by c++ code
 uniform int objectID;
+// alpha of the object; below 1 it is drawn blended, back to front
+uniform float uOpacity;
+
+// **
+
+// The point and spot lights picked for the object, and those of the
+//   fragment's cluster.
+vec3
+objectLighting(int count, vec3 normalWorld);
+
+vec3
+clusterLighting(vec3 normalWorld);
+
+// **
 
 void
 main ()
 {
-  fColor = vec4(vColor, 1.0);
-
   IDColor = objectID;
+
+#ifdef VERTEX_COLOR_ONLY
+  fColor = vec4(vColor, uOpacity);
+#else
+#ifndef PERMUTATION
+  if (uNumLights == 0 || uUnlit != 0)
+  {
+    // use the vertex color if not light exist
+    fColor = vec4(vColor, uOpacity);
+    return;
+  }
+#endif
+
+  vec3 normalWorld = normalize(vNormalWorld);
+
+  // Handle ambient and emissive light
+  //   It's independent of any particular light
+  vec3 color = uAmbientReflection * uAmbientIntensity + uEmissiveIntensity;
+#ifndef NO_DIRECTIONAL_LIGHTS
+  // Directional lights reach everything
+  for (int i = 0; i < uNumDirectionalLights; ++i)
+  {
+    color += calculateLighting(fetchLight(i), vPositionWorld, normalWorld, vViewDepth);
+  }
+#endif
+#if defined(OBJECT_LIGHT_COUNT)
+  // A constant count, so the loop can be unrolled
+  color += objectLighting(OBJECT_LIGHT_COUNT, normalWorld);
+#elif defined(CLUSTERED_LIGHTS)
+  color += clusterLighting(normalWorld);
+#else
+  if (uObjectLightCount >= 0)
+  {
+    color += objectLighting(uObjectLightCount, normalWorld);
+  }
+  else
+  {
+    color += clusterLighting(normalWorld);
+  }
+#endif
+  // Stay in bounds [0, 1]
+  color = clamp(color, 0.0, 1.0);
+
+  fColor = vec4(color * vColor, uOpacity);  // Combine vertex color with lighting
+#endif
+}
+
+// **
+
+vec3
+objectLighting (int count, vec3 normalWorld)
+{
+  vec3 color = vec3(0.0);
+  for (int i = 0; i < count; ++i)
+  {
+    color += calculateLighting(fetchLight(uObjectLights[i]), vPositionWorld, normalWorld, vViewDepth);
+  }
+  return color;
+}
+
+// **
+
+vec3
+clusterLighting (vec3 normalWorld)
+{
+  // Point and spot lights only reach the clusters they were assigned to
+  vec3 color = vec3(0.0);
+  // Perspective correct interpolation makes this the fragment's own NDC
+  vec2 ndc = vPositionClip.xy / vPositionClip.w;
+  uvec2 cluster = texelFetch(uClusters, clusterIndex(ndc, vViewDepth)).xy;
+  for (uint i = 0u; i < cluster.y; ++i)
+  {
+    int index = int(texelFetch(uLightIndices, int(cluster.x + i)).x);
+    color += calculateLighting(fetchLight(index), vPositionWorld, normalWorld, vViewDepth);
+  }
+  return color;
 }
@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Render/GLState.h"
+
 namespace VenusEngine
 {
 	class IndexBuffer
@@ -15,12 +17,13 @@ namespace VenusEngine
 
 		~IndexBuffer()
 		{
+			GLState::get().forgetBuffer(m_indexBuffer);
 			glDeleteBuffers(1, &m_indexBuffer);
 		}
 
 		void bind()
 		{
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+			GLState::get().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
 		}
 
 		void bufferData(GLsizeiptr size, void const* data, GLenum usage)
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+namespace VenusEngine
+{
+	// One light in the light data buffer, read as five RGBA32F texels by
+	// fetchLight in GeneralShader.frag.  Every vec3 is followed by a scalar
+	// so that each texel holds one of them
+	struct LightData
+	{
+		float        diffuseIntensity[3]        = {};
+		std::int32_t type                       = 0;
+		float        specularIntensity[3]       = {};
+		float        cutoffCosAngle             = 0.0f;
+		float        position[3]                = {};
+		float        falloff                    = 0.0f;
+		float        attenuationCoefficients[3] = {};
+		// Distance past which a point or spot light is faded out
+		float        range                      = 0.0f;
+		float        direction[3]               = {};
+		// Index of the light's first matrix in ShadowBlock, or -1 if it casts
+		// no shadow; set by ShadowMaps
+		std::int32_t shadow                     = -1;
+	};
+
+	// The std140 uniform block "LightBlock" of GeneralShader.frag: the ambient
+	// light, the material and the layout of the light clusters.  The lights
+	// themselves and the per-cluster light lists are texture buffers
+	struct LightBlock
+	{
+		static constexpr int    MAX_LIGHTS       = 4096;
+		// Uniform buffer binding point of the block
+		static constexpr GLuint BINDING          = 0;
+		// Texture units of the light data, cluster and light index buffers
+		static constexpr GLuint LIGHT_DATA_UNIT  = 1;
+		static constexpr GLuint CLUSTER_UNIT     = 2;
+		static constexpr GLuint LIGHT_INDEX_UNIT = 3;
+		// RGBA32F texels per LightData
+		static constexpr int    LIGHT_TEXELS     = 5;
+
+		float        ambientIntensity[3]   = {};
+		std::int32_t lightCount            = 0;
+		float        ambientReflection[3]  = {};
+		float        specularPower         = 0.0f;
+		float        diffuseReflection[3]  = {};
+		std::int32_t directionalCount      = 0;
+		float        specularReflection[3] = {};
+		float        padding0              = 0.0f;
+		float        emissiveIntensity[3]  = {};
+		float        padding1              = 0.0f;
+		std::int32_t clusterCount[3]       = {};
+		float        sliceScale            = 0.0f;
+		float        sliceBias             = 0.0f;
+		float        padding2[3]           = {};
+	};
+
+	// The std140 uniform block "ShadowBlock" of the lighting shaders: where
+	// the shadow maps of the lights are in the shadow atlas.  Matrices are
+	// stored by rows, as the block is declared row_major
+	struct ShadowBlock
+	{
+		static constexpr int    MAX_SHADOWS = 16;
+		// Shadow maps of a directional light, each covering a farther range
+		// of view depths
+		static constexpr int    CASCADES    = 4;
+		static constexpr GLuint BINDING     = 1;
+		// Texture unit of the atlas; it follows the units of GBuffer
+		static constexpr GLuint ATLAS_UNIT  = 7;
+
+		// World space to atlas texture coordinates and window depth
+		float        matrices[MAX_SHADOWS][16] = {};
+		// Texture coordinates of every tile, shrunk so that filtering stays
+		// inside it
+		float        tiles[MAX_SHADOWS][4]     = {};
+		// Normal offset against acne: x in world units, y per unit of
+		// distance from the light
+		float        offsets[MAX_SHADOWS][4]   = {};
+		// Far view depth of every cascade
+		float        cascadeSplits[CASCADES]   = {};
+		std::int32_t cascadeCount              = 0;
+		float        texelSize                 = 0.0f;
+		float        padding0[2]               = {};
+	};
+
+	static_assert(sizeof(LightData) == LightBlock::LIGHT_TEXELS * 16, "LightData must fill whole RGBA32F texels");
+	static_assert(offsetof(LightBlock, clusterCount) == 80, "LightBlock must match the std140 layout of the shader");
+	static_assert(offsetof(LightBlock, sliceBias) == 96, "LightBlock must match the std140 layout of the shader");
+	static_assert(sizeof(LightBlock) == 112, "LightBlock must match the std140 layout of the shader");
+	static_assert(offsetof(ShadowBlock, cascadeSplits) == 1536, "ShadowBlock must match the std140 layout of the shader");
+	static_assert(sizeof(ShadowBlock) == 1568, "ShadowBlock must match the std140 layout of the shader");
+}
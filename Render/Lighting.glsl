@@ -0,0 +1,271 @@
+/*
+  Filename: Lighting.glsl
+  Description: The lights, the shadow maps and the lighting model, shared by
+    GeneralShader.frag and DeferredLighting.frag, which include it.  The
+    permutation defines of GeneralShader.frag compile parts of it out.
+*/
+
+// Information about one light source.
+// Because different light sources store different information, not every type
+//   will use every data member.
+// The C++ mirror is LightData in Render/LightBlock.h.
+struct Light
+{
+  // All lights have these parameters.
+  vec3 diffuseIntensity;
+  // 0 if directional, 1 if point, 2 if spot -- other values illegal.
+  int type;
+  vec3 specularIntensity;
+
+  // Spot light parameters.
+  float cutoffCosAngle;
+
+  // Point and spot light parameters.
+  vec3 position;
+
+  // Spot light parameter.
+  float falloff;
+
+  // Point and spot light parameters; the light fades out towards its range.
+  vec3 attenuationCoefficients;
+  float range;
+
+  // Directional and spot light parameter.
+  vec3 direction;
+
+  // Index of the light's first shadow map in ShadowBlock, or -1 if it casts
+  //   no shadow.
+  int shadow;
+};
+
+// The ambient light, the material and the cluster layout, in one uniform
+//   buffer that the C++ code uploads only when they change, through the
+//   per-frame ring buffer (LightBlock in Render/LightBlock.h).
+layout(std140) uniform LightBlock
+{
+  // Single ambient light.
+  vec3  uAmbientIntensity;
+  // How many light sources there are.
+  int   uNumLights;
+
+  // Material properties.
+  vec3  uAmbientReflection;
+  float uSpecularPower;
+  vec3  uDiffuseReflection;
+  // The first uNumDirectionalLights lights are directional.
+  int   uNumDirectionalLights;
+  vec3  uSpecularReflection;
+  vec3  uEmissiveIntensity;
+
+  // Screen tiles and depth slices of the clusters; the slice of a view depth
+  //   d is log(d) * uSliceScale + uSliceBias.
+  ivec3 uClusterCount;
+  float uSliceScale;
+  float uSliceBias;
+};
+
+// Where the shadow maps of the directional and spot lights are in the shadow
+//   atlas (ShadowBlock in Render/LightBlock.h).
+const int MAX_SHADOWS = 16;
+layout(std140, row_major) uniform ShadowBlock
+{
+  // World space to atlas texture coordinates and window depth.
+  mat4  uShadowMatrices[MAX_SHADOWS];
+  // Texture coordinates of each map, shrunk so that filtering stays inside.
+  vec4  uShadowTiles[MAX_SHADOWS];
+  // Normal offset: x in world units, y per unit of distance from the light.
+  vec4  uShadowOffsets[MAX_SHADOWS];
+  // The cascades of a directional light end at these view depths.
+  vec4  uCascadeSplits;
+  int   uCascadeCount;
+  float uShadowTexelSize;
+};
+
+// Depths of the shadow casters, compared with hardware filtering.
+uniform sampler2DShadow uShadowAtlas;
+
+// Five texels per light, in the order of struct Light.
+uniform samplerBuffer uLightData;
+// Offset into uLightIndices and light count of each cluster.
+uniform usamplerBuffer uClusters;
+// The lights of every cluster, one after another.
+uniform usamplerBuffer uLightIndices;
+
+// Eye position, in world space, provided by C++ code.
+uniform vec3 uEyePosition;
+
+// **
+
+// The light at an index of uLightData.
+Light
+fetchLight(int index);
+
+// Index of the cluster that contains a point, from its normalized device
+//   coordinates and its distance in front of the eye.
+int
+clusterIndex(vec2 ndc, float viewDepth);
+
+// Calculate diffuse and specular lighting for a single light.
+vec3
+calculateLighting(Light light, vec3 fragmentPosition, vec3 fragmentNormal, float viewDepth);
+
+// Fraction of a light's shadow map that sees the fragment, from 0 in shadow
+//   to 1 lit.
+float
+shadowFactor(Light light, vec3 fragmentPosition, vec3 fragmentNormal, float viewDepth);
+
+// **
+
+Light
+fetchLight (int index)
+{
+  int texel = index * 5;
+  vec4 diffuse     = texelFetch(uLightData, texel);
+  vec4 specular    = texelFetch(uLightData, texel + 1);
+  vec4 position    = texelFetch(uLightData, texel + 2);
+  vec4 attenuation = texelFetch(uLightData, texel + 3);
+  vec4 direction   = texelFetch(uLightData, texel + 4);
+
+  Light light;
+  light.diffuseIntensity = diffuse.xyz;
+  light.type = floatBitsToInt(diffuse.w);
+  light.specularIntensity = specular.xyz;
+  light.cutoffCosAngle = specular.w;
+  light.position = position.xyz;
+  light.falloff = position.w;
+  light.attenuationCoefficients = attenuation.xyz;
+  light.range = attenuation.w;
+  light.direction = direction.xyz;
+  light.shadow = floatBitsToInt(direction.w);
+  return light;
+}
+
+// **
+
+int
+clusterIndex (vec2 ndc, float viewDepth)
+{
+  ivec2 tile = clamp(ivec2((ndc * 0.5 + 0.5) * vec2(uClusterCount.xy)),
+                     ivec2(0), uClusterCount.xy - 1);
+  int slice = int(floor(log(max(viewDepth, 1e-4)) * uSliceScale + uSliceBias));
+  slice = clamp(slice, 0, uClusterCount.z - 1);
+  return (slice * uClusterCount.y + tile.y) * uClusterCount.x + tile.x;
+}
+
+// **
+
+vec3
+calculateLighting (Light light, vec3 fragmentPosition, vec3 fragmentNormal, float viewDepth)
+{
+  // Light vector points toward the light
+  vec3 lightVector;
+#ifndef NO_DIRECTIONAL_LIGHTS
+  if (light.type == 0)
+  {
+    // Directional
+    lightVector = normalize(-light.direction);
+  }
+  else
+#endif
+  {
+    // Point or spot
+    lightVector = normalize(light.position - fragmentPosition);
+  }
+  // Light intensity is proportional to angle between light vector
+  //   and fragment normal
+  float lambertianCoef = max(dot(lightVector, fragmentNormal), 0.0);
+  vec3 diffuseAndSpecular = vec3(0.0);
+  if (lambertianCoef > 0.0)
+  {
+    // Light is incident on fragment, not shining on its edge or back
+    vec3 diffuseColor = uDiffuseReflection * light.diffuseIntensity;
+    diffuseColor *= lambertianCoef;
+
+    vec3 specularColor = uSpecularReflection * light.specularIntensity;
+    // See how light reflects off of fragment
+    vec3 reflectionVector = reflect(-lightVector, fragmentNormal);
+    // Compute view vector, which points toward the eye
+    vec3 eyeVector = normalize(uEyePosition - fragmentPosition);
+    // Light intensity is proportional to angle between reflection vector
+    //   and eye vector
+    float specularCoef = max(dot(eyeVector, reflectionVector), 0.0);
+    // Material's specular power determines size of bright spots
+    specularColor *= pow(specularCoef, uSpecularPower);
+
+    float attenuation = 1.0;
+    if (light.type != 0)
+    { // Non-directional, so light attenuates
+      float distance = length(fragmentPosition - light.position);
+      attenuation = 1.0 / (
+            light.attenuationCoefficients.x
+          + light.attenuationCoefficients.y * distance
+          + light.attenuationCoefficients.z * distance * distance);
+      // Fade out to nothing at the range, past which the light is culled
+      float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+      attenuation *= window * window;
+    }
+    float spotFactor = 1.0f;
+#ifndef NO_SPOT_LIGHTS
+    if (light.type == 2)
+    { // Spot light
+      float cosTheta = dot(-lightVector, light.direction);
+      cosTheta = max(cosTheta, 0.0f);
+      spotFactor = (cosTheta >= light.cutoffCosAngle) ? cosTheta : 0.0f;
+      spotFactor = pow(spotFactor, light.falloff);
+    }
+#endif
+    float shadow = 1.0;
+#ifndef NO_SHADOWS
+    if (spotFactor * attenuation > 0.0)
+    {
+      shadow = shadowFactor(light, fragmentPosition, fragmentNormal, viewDepth);
+    }
+#endif
+    diffuseAndSpecular = shadow * spotFactor * attenuation * (diffuseColor + specularColor);
+  }
+
+  return diffuseAndSpecular;
+}
+
+// **
+
+float
+shadowFactor (Light light, vec3 fragmentPosition, vec3 fragmentNormal, float viewDepth)
+{
+  if (light.shadow < 0)
+  {
+    return 1.0;
+  }
+  int index = light.shadow;
+  if (light.type == 0)
+  {
+    // The nearest cascade that covers the fragment; none past the last
+    int cascade = 0;
+    while (cascade < uCascadeCount && viewDepth > uCascadeSplits[cascade])
+    {
+      ++cascade;
+    }
+    if (cascade == uCascadeCount)
+    {
+      return 1.0;
+    }
+    index += cascade;
+  }
+  // Look up a point about a texel off the surface, against shadow acne
+  vec4 offsets = uShadowOffsets[index];
+  float offset = offsets.x + offsets.y * length(fragmentPosition - light.position);
+  vec4 shadowPosition = uShadowMatrices[index] * vec4(fragmentPosition + fragmentNormal * offset, 1.0);
+  shadowPosition.xyz /= shadowPosition.w;
+
+  // Four bilinear comparisons half a texel apart filter 3x3 texels
+  vec4 tile = uShadowTiles[index];
+  float lit = 0.0;
+  for (int i = 0; i < 4; ++i)
+  {
+    vec2 tap = (vec2(i & 1, i >> 1) - 0.5) * uShadowTexelSize;
+    vec2 coordinates = clamp(shadowPosition.xy + tap, tile.xy, tile.zw);
+    // The atlas has no mipmaps, so no derivatives are needed in this branch
+    lit += textureLod(uShadowAtlas, vec3(coordinates, shadowPosition.z), 0.0);
+  }
+  return lit * 0.25;
+}
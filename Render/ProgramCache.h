@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+namespace VenusEngine
+{
+	/// \brief Linked program binaries kept on disk between launches, so a
+	///   program whose sources did not change is loaded without compiling.
+	/// A binary is found by a hash of the shader sources, the defines they
+	///   were compiled with and the driver (vendor, renderer and version), so
+	///   an edited shader or an updated driver never loads a stale binary.
+	///   A driver may still refuse a binary; the program is then compiled
+	///   from source, and the binary replaced.
+	class ProgramCache
+	{
+	public:
+		static constexpr char const* DIRECTORY = "shader_cache";
+
+		// Programs built since launch, and the time they took
+		struct Stats
+		{
+			std::size_t programs            = 0;
+			std::size_t loaded              = 0;
+			// Building all programs, from binaries or from source
+			float       buildMilliseconds   = 0.0f;
+			// Building the loaded programs
+			float       loadMilliseconds    = 0.0f;
+			// What compiling the loaded programs took when they were cached
+			float       compileMilliseconds = 0.0f;
+
+			/// \brief The startup time the cache saved this launch.
+			float savedMilliseconds() const
+			{
+				return compileMilliseconds - loadMilliseconds;
+			}
+		};
+
+		static Stats& stats()
+		{
+			static Stats stats;
+			return stats;
+		}
+
+		/// \brief Whether the context can get and load program binaries.
+		static bool supported()
+		{
+			static bool const isSupported = [] {
+				if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+				{
+					return false;
+				}
+				GLint formats = 0;
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+				return formats > 0;
+			}();
+			return isSupported;
+		}
+
+		/// \brief FNV-1a hash of the sources, defines and driver strings.
+		static std::uint64_t key(std::string const& vertexSource, std::string const& fragmentSource,
+			std::string const& defines)
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+			auto add = [&hash](std::string_view text) {
+				for (char c : text)
+				{
+					hash ^= static_cast<std::uint8_t>(c);
+					hash *= 1099511628211ull;
+				}
+				// Keeps "ab" + "c" apart from "a" + "bc"
+				hash ^= 0xff;
+				hash *= 1099511628211ull;
+			};
+			add(vertexSource);
+			add(fragmentSource);
+			add(defines);
+			add(driver());
+			return hash;
+		}
+
+		/// \brief Links a program from the binary cached under key.
+		/// \param[out] compileMilliseconds What compiling it took when it was
+		///   cached.
+		/// \return false if there is no binary, or the driver rejects it; the
+		///   program is then left unlinked.
+		static bool load(GLuint programId, std::uint64_t key, float& compileMilliseconds)
+		{
+			if (!supported())
+			{
+				return false;
+			}
+			std::ifstream file(path(key), std::ios::binary);
+			if (!file)
+			{
+				return false;
+			}
+			Header header;
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != MAGIC ||
+				header.key != key || header.length <= 0)
+			{
+				return false;
+			}
+			std::vector<char> binary(static_cast<std::size_t>(header.length));
+			if (!file.read(binary.data(), header.length))
+			{
+				return false;
+			}
+			glProgramBinary(programId, header.format, binary.data(), header.length);
+			GLint isLinked = GL_FALSE;
+			glGetProgramiv(programId, GL_LINK_STATUS, &isLinked);
+			if (isLinked == GL_FALSE)
+			{
+				std::cout << "Cached program binary " << path(key) << " was rejected; compiling" << std::endl;
+				return false;
+			}
+			compileMilliseconds = header.compileMilliseconds;
+			return true;
+		}
+
+		/// \brief Writes the binary of a linked program under key.  The program
+		///   should have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+		static void store(GLuint programId, std::uint64_t key, float compileMilliseconds)
+		{
+			if (!supported())
+			{
+				return;
+			}
+			Header header;
+			header.key                 = key;
+			header.compileMilliseconds = compileMilliseconds;
+			glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &header.length);
+			if (header.length <= 0)
+			{
+				return;
+			}
+			std::vector<char> binary(static_cast<std::size_t>(header.length));
+			glGetProgramBinary(programId, header.length, &header.length, &header.format, binary.data());
+
+			std::error_code error;
+			std::filesystem::create_directories(DIRECTORY, error);
+			// Written aside and renamed, so a crash cannot leave half a binary
+			std::string const finalPath = path(key);
+			std::string const tempPath  = finalPath + ".tmp";
+			{
+				std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+				if (!file)
+				{
+					return;
+				}
+				file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+				file.write(binary.data(), header.length);
+				if (!file)
+				{
+					return;
+				}
+			}
+			// rename does not replace an existing file everywhere
+			std::filesystem::remove(finalPath, error);
+			std::filesystem::rename(tempPath, finalPath, error);
+		}
+
+	private:
+		static constexpr std::uint32_t MAGIC = 0x31425056; // "VPB1"
+
+		struct Header
+		{
+			std::uint32_t magic               = MAGIC;
+			GLenum        format              = 0;
+			GLint         length              = 0;
+			float         compileMilliseconds = 0.0f;
+			// Guards against a file renamed or a hash collision in the name
+			std::uint64_t key                 = 0;
+		};
+
+		static std::string const& driver()
+		{
+			static std::string const text = [] {
+				std::string result;
+				for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+				{
+					if (GLubyte const* value = glGetString(name))
+					{
+						result += reinterpret_cast<char const*>(value);
+					}
+					result += '\n';
+				}
+				return result;
+			}();
+			return text;
+		}
+
+		static std::string path(std::uint64_t key)
+		{
+			char name[32];
+			std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+			return std::string(DIRECTORY) + "/" + name;
+		}
+	};
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Math/MathHeaders.h"
+#include "Render/ShaderProgram.h"
+#include "Render/VertexArray.h"
+
+namespace VenusEngine
+{
+	// The lights chosen to shade one object, most relevant first; a count of
+	// -1 leaves the choice to the light clusters
+	struct ObjectLights
+	{
+		static constexpr int MAX_LIGHTS = 8;
+
+		std::int32_t count               = -1;
+		std::int32_t indices[MAX_LIGHTS] = {};
+	};
+
+	// One draw call waiting in a RenderQueue
+	struct RenderCommand
+	{
+		ShaderProgram* shaderProgram = nullptr;
+		VertexArray*   vertexArray   = nullptr;
+		GLsizei        vertexCount   = 0;
+		Mat4           worldMatrix;
+		int            objectID      = 0;
+		float          opacity       = 1.0f;
+		// World bounds of the object
+		Vec3           boundsMin;
+		Vec3           boundsMax;
+		ObjectLights   lights;
+	};
+
+	/// \brief Collects the draw calls of a frame and orders them by a 64-bit key.
+	/// Opaque commands come first, grouped by program and VAO so that binds can
+	///   be skipped, and front to back within a group so that early depth
+	///   testing rejects hidden fragments. Blended commands follow, back to
+	///   front, which transparency requires.
+	class RenderQueue
+	{
+	public:
+		enum class Pass : std::uint64_t
+		{
+			Opaque  = 0,
+			Blended = 1
+		};
+
+		void clear()
+		{
+			m_commands.clear();
+			m_entries.clear();
+		}
+
+		/// \param[in] depth The distance of the command from the camera; any
+		///   monotonic measure, e.g. squared distance, works.
+		void push(Pass pass, RenderCommand const& command, float depth)
+		{
+			m_entries.push_back({ makeKey(pass, command, depth), static_cast<std::uint32_t>(m_commands.size()) });
+			m_commands.push_back(command);
+		}
+
+		/// \brief Sorts the commands by key with an LSD radix sort; bytes that are
+		///   equal in every key are skipped.
+		void sort()
+		{
+			m_scratch.resize(m_entries.size());
+			for (int shift = 0; shift < 64; shift += 8)
+			{
+				std::array<std::uint32_t, 256> counts{};
+				for (Entry const& entry : m_entries)
+				{
+					++counts[(entry.key >> shift) & 0xFF];
+				}
+				if (counts[(m_entries.empty() ? 0 : m_entries[0].key >> shift) & 0xFF] == m_entries.size())
+				{
+					continue;
+				}
+				std::uint32_t offset = 0;
+				for (std::uint32_t& count : counts)
+				{
+					std::uint32_t bucketSize = count;
+					count   = offset;
+					offset += bucketSize;
+				}
+				for (Entry const& entry : m_entries)
+				{
+					m_scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+				}
+				m_entries.swap(m_scratch);
+			}
+		}
+
+		std::size_t size() const
+		{
+			return m_entries.size();
+		}
+
+		/// \return The commands in the order they were pushed, for passes that
+		///   fill in per-command data before the queue is drawn.
+		std::vector<RenderCommand>& commands()
+		{
+			return m_commands;
+		}
+
+		/// \brief Replaces the program of the i-th command pushed, e.g. by a
+		///   permutation of it, and regroups the command by the new program.
+		/// \pre sort() has not been called since the last push().
+		void setProgram(std::size_t i, ShaderProgram* program)
+		{
+			Entry& entry = m_entries[i];
+			m_commands[entry.index].shaderProgram = program;
+			int shift = (entry.key >> PASS_SHIFT) != 0 ? BLENDED_PROGRAM_SHIFT : OPAQUE_PROGRAM_SHIFT;
+			entry.key &= ~(PROGRAM_MASK << shift);
+			entry.key |= (program->id() & PROGRAM_MASK) << shift;
+		}
+
+		/// \return Whether the i-th command in sorted order is in the blended pass.
+		bool isBlended(std::size_t i) const
+		{
+			return (m_entries[i].key >> PASS_SHIFT) != 0;
+		}
+
+		/// \return The i-th command in sorted order.
+		/// \pre sort() has been called since the last push().
+		RenderCommand const& operator[](std::size_t i) const
+		{
+			return m_commands[m_entries[i].index];
+		}
+
+	private:
+		struct Entry
+		{
+			std::uint64_t key;
+			std::uint32_t index;
+		};
+
+		//  Opaque:  pass:1 | program:11 | vao:20 | depth:32
+		//  Blended: pass:1 | ~depth:32 | program:11 | vao:20
+		// Program and VAO names are truncated; that only affects grouping, as
+		//   binds are skipped by comparing the full names.
+		static constexpr int           PASS_SHIFT            = 63;
+		static constexpr int           OPAQUE_PROGRAM_SHIFT  = 52;
+		static constexpr int           BLENDED_PROGRAM_SHIFT = 20;
+		static constexpr std::uint64_t PROGRAM_MASK          = 0x7FFu;
+
+		static std::uint64_t makeKey(Pass pass, RenderCommand const& command, float depth)
+		{
+			std::uint64_t program = command.shaderProgram->id() & PROGRAM_MASK;
+			std::uint64_t vao     = command.vertexArray->id() & 0xFFFFFu;
+			std::uint64_t bits    = depthBits(depth);
+			if (pass == Pass::Opaque)
+			{
+				return (program << OPAQUE_PROGRAM_SHIFT) | (vao << 32) | bits;
+			}
+			return (std::uint64_t(1) << PASS_SHIFT) | ((~bits & 0xFFFFFFFFu) << 31) |
+				(program << BLENDED_PROGRAM_SHIFT) | vao;
+		}
+
+		// The bits of a non-negative float sort like the float itself
+		static std::uint64_t depthBits(float depth)
+		{
+			depth = depth > 0.0f ? depth : 0.0f;
+			std::uint32_t bits;
+			std::memcpy(&bits, &depth, sizeof(bits));
+			return bits;
+		}
+
+	private:
+		std::vector<RenderCommand> m_commands;
+		std::vector<Entry>         m_entries;
+		std::vector<Entry>         m_scratch;
+	};
+}
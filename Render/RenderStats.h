@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+namespace VenusEngine
+{
+	// Per-frame counters shown in the statistics window
+	struct RenderStats
+	{
+		// bytes written to the stream ring buffer
+		std::size_t streamedBytes = 0;
+		// times the CPU waited on the GPU before reusing a ring buffer region
+		std::size_t streamStalls  = 0;
+		// meshes drawn and meshes rejected by frustum culling
+		std::size_t visibleObjects = 0;
+		std::size_t culledObjects  = 0;
+		// meshes inside the frustum hidden behind occluders, and the occluder
+		// triangles rasterized on the CPU to find them
+		std::size_t occludedObjects   = 0;
+		std::size_t occluderTriangles = 0;
+		// draw calls issued by the render queue and the program, VAO and blend
+		// state changes between them
+		std::size_t drawCalls      = 0;
+		std::size_t stateChanges   = 0;
+		// cached shadow maps redrawn because their light or static casters
+		// moved, and the draw calls of all shadow maps
+		std::size_t shadowMapsRedrawn = 0;
+		std::size_t shadowDrawCalls   = 0;
+		// glUniform calls made, and those skipped because the uniform already
+		// had the value
+		std::size_t uniformCalls        = 0;
+		std::size_t uniformCallsSkipped = 0;
+		// GL state calls made through GLState (binds, viewport, blending and
+		// depth), and those skipped because the state was already set
+		std::size_t stateCalls        = 0;
+		std::size_t stateCallsSkipped = 0;
+		// draws with a permutation of the forward program rather than the
+		// general one, and the permutations ready and waiting to be built
+		std::size_t variantDraws     = 0;
+		std::size_t variantsReady    = 0;
+		std::size_t variantsBuilding = 0;
+	};
+}
@@ -1,23 +1,93 @@
 #pragma once
 
+#include <stdexcept>
+#include <string>
+
 #include <glad/glad.h>
 
+#include "Render/GLState.h"
 #include "Render/ShaderProgram.h"
+#include "Render/RingBuffer.h"
+#include "Render/RenderStats.h"
+#include "Render/RenderQueue.h"
+#include "Render/ShaderVariants.h"
+#include "Render/LightBlock.h"
+#include "Render/Framebuffer.h"
+#include "Render/GBuffer.h"
+#include "Render/VertexArray.h"
 
 namespace VenusEngine
 {
 	class Renderer
 	{
 	public:
-		Renderer(std::string const& vertexShaderPath, std::string const& fragmentShaderPath)
+		enum class ShadingPath
+		{
+			// Every object is lit as it is drawn
+			Forward,
+			// Opaque objects are drawn into a G-buffer and lit once per pixel
+			Deferred
+		};
+
+		/// \param gBufferFragmentShaderName The geometry pass of the deferred
+		///   path, which shares the vertex shader of the forward path.
+		Renderer(std::string const& vertexShaderName, std::string const& fragmentShaderName,
+			std::string const& gBufferFragmentShaderName, std::string const& lightingVertexShaderName,
+			std::string const& lightingFragmentShaderName)
+			: m_variants(vertexShaderName, fragmentShaderName, setUpForwardProgram),
+			  m_streamBuffer(GL_COPY_READ_BUFFER, STREAM_BYTES_PER_FRAME)
 		{
-			m_shaderProgram.createVertexShader(vertexShaderPath);
-			m_shaderProgram.createFragmentShader(fragmentShaderPath);
-			m_shaderProgram.link();
+			// Unlike the variants, these have nothing to fall back on
+			buildProgram(m_shaderProgram, vertexShaderName, fragmentShaderName);
+			setUpForwardProgram(m_shaderProgram);
+
+			buildProgram(m_geometryProgram, vertexShaderName, gBufferFragmentShaderName);
+
+			buildProgram(m_lightingProgram, lightingVertexShaderName, lightingFragmentShaderName);
+			m_lightingProgram.setUniformBlockBinding("LightBlock", LightBlock::BINDING);
+			m_lightingProgram.setUniformBlockBinding("ShadowBlock", ShadowBlock::BINDING);
+			m_lightingProgram.enable();
+			m_lightingProgram.setUniformInt("uLightData"   , LightBlock::LIGHT_DATA_UNIT);
+			m_lightingProgram.setUniformInt("uClusters"    , LightBlock::CLUSTER_UNIT);
+			m_lightingProgram.setUniformInt("uLightIndices", LightBlock::LIGHT_INDEX_UNIT);
+			m_lightingProgram.setUniformInt("uShadowAtlas" , ShadowBlock::ATLAS_UNIT);
+			m_lightingProgram.setUniformInt("uNormal"      , GBuffer::NORMAL_UNIT);
+			m_lightingProgram.setUniformInt("uAlbedo"      , GBuffer::ALBEDO_UNIT);
+			m_lightingProgram.setUniformInt("uDepth"       , GBuffer::DEPTH_UNIT);
+			m_lightingProgram.disable();
 		}
 
 		~Renderer() = default;
 
+		void beginFrame()
+		{
+			m_streamBuffer.beginFrame();
+			m_renderQueue.clear();
+			m_frameStats = RenderStats();
+			ShaderProgram::uniformCounters() = ShaderProgram::UniformCounters();
+			// The GUI of the last frame set state behind GLState's back
+			GLState::get().invalidate();
+			GLState::get().counters() = GLState::Counters();
+			if (m_shaderVariants)
+			{
+				m_variants.update();
+			}
+		}
+
+		void endFrame()
+		{
+			m_streamBuffer.endFrame();
+			m_frameStats.streamedBytes = m_streamBuffer.frameStats().bytesStreamed;
+			m_frameStats.streamStalls  = m_streamBuffer.frameStats().stallsWaited;
+			m_frameStats.uniformCalls        = ShaderProgram::uniformCounters().calls;
+			m_frameStats.uniformCallsSkipped = ShaderProgram::uniformCounters().skipped;
+			m_frameStats.stateCalls          = GLState::get().counters().calls;
+			m_frameStats.stateCallsSkipped   = GLState::get().counters().skipped;
+			m_frameStats.variantsReady       = m_variants.readyCount();
+			m_frameStats.variantsBuilding    = m_variants.buildingCount();
+			m_stats = m_frameStats;
+		}
+
 		void drawBuffers(GLsizei size, GLenum const* buffers)
 		{
 			glDrawBuffers(size, buffers);
@@ -33,7 +103,287 @@ namespace VenusEngine
 			return m_shaderProgram;
 		}
 
+		// The programs of the deferred path; they take the camera uniforms too
+		ShaderProgram& getGeometryProgram()
+		{
+			return m_geometryProgram;
+		}
+
+		ShaderProgram& getLightingProgram()
+		{
+			return m_lightingProgram;
+		}
+
+		// Ring buffer for data rewritten every frame
+		RingBuffer& getStreamBuffer()
+		{
+			return m_streamBuffer;
+		}
+
+		// Draw calls of the frame, submitted by drawRenderQueue
+		RenderQueue& getRenderQueue()
+		{
+			return m_renderQueue;
+		}
+
+		/// \brief Sorts and issues the queued draw calls, skipping program and VAO
+		///   binds that would not change anything.
+		/// \post The opaque pass was drawn without blending, the blended pass
+		///   without depth writes; blending and depth writes are enabled again.
+		void drawRenderQueue()
+		{
+			assignVariants(false);
+			m_renderQueue.sort();
+			submit(0, m_renderQueue.size(), nullptr);
+		}
+
+		/// \brief Draws the queue on the deferred path: opaque commands are
+		///   drawn into the G-buffer and lit by one full screen pass over the
+		///   light clusters into target, then blended commands are drawn
+		///   forward on top.
+		/// \pre target is bound and draws to color attachments 0 and 1, like
+		///   the framebuffer of World.
+		/// \post target is bound.
+		void drawRenderQueueDeferred(GBuffer& gBuffer, Framebuffer& target, Mat4 const& inverseViewProjection)
+		{
+			assignVariants(true);
+			m_renderQueue.sort();
+			std::size_t opaqueCount = 0;
+			while (opaqueCount < m_renderQueue.size() && !m_renderQueue.isBlended(opaqueCount))
+			{
+				++opaqueCount;
+			}
+
+			gBuffer.beginGeometryPass();
+			submit(0, opaqueCount, &m_geometryProgram);
+			target.bind();
+
+			// Only the color is lit; IDs and depth were written by the geometry pass
+			GLenum colorOnly[2] = { GL_COLOR_ATTACHMENT0, GL_NONE };
+			glDrawBuffers(2, colorOnly);
+			GLState& state = GLState::get();
+			state.setEnabled(GL_DEPTH_TEST, false);
+			state.setEnabled(GL_BLEND, false);
+			gBuffer.bindTextures();
+			m_lightingProgram.enable();
+			m_lightingProgram.setUniformMat4("uInverseViewProjection", inverseViewProjection);
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			m_lightingProgram.setUniformVec4("uViewport",
+				Vec4(float(viewport[0]), float(viewport[1]), float(viewport[2]), float(viewport[3])));
+			m_fullScreenArray.bind();
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			m_fullScreenArray.unbind();
+			m_lightingProgram.disable();
+			++m_frameStats.drawCalls;
+			state.setEnabled(GL_DEPTH_TEST, true);
+			state.setEnabled(GL_BLEND, true);
+			GLenum colorAndID[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+			glDrawBuffers(2, colorAndID);
+
+			submit(opaqueCount, m_renderQueue.size(), nullptr);
+		}
+
+		// Which path drawRenderQueue callers should take
+		void setShadingPath(ShadingPath path)
+		{
+			m_shadingPath = path;
+		}
+
+		ShadingPath shadingPath() const
+		{
+			return m_shadingPath;
+		}
+
+		/// \brief Tells what the lights of the frame need, which picks the
+		///   permutations of the forward program.
+		void setLightFeatures(LightFeatures const& features)
+		{
+			m_lightFeatures = features;
+		}
+
+		// Whether the render queue draws with permutations of the forward
+		// program where they are ready
+		void setShaderVariants(bool enabled)
+		{
+			m_shaderVariants = enabled;
+		}
+
+		bool shaderVariants() const
+		{
+			return m_shaderVariants;
+		}
+
+		// The permutations of the forward program; they take the camera
+		// uniforms too
+		ShaderVariants& getShaderVariants()
+		{
+			return m_variants;
+		}
+
+		// Counters of the last finished frame
+		RenderStats const& getStats() const
+		{
+			return m_stats;
+		}
+
+		// Counters of the frame being drawn
+		RenderStats& getFrameStats()
+		{
+			return m_frameStats;
+		}
+
 	private:
-		ShaderProgram m_shaderProgram;
+		// A program the renderer cannot draw without; a shader that is
+		// missing or does not compile or link ends the startup
+		static void buildProgram(ShaderProgram& program, std::string const& vertexShaderName,
+			std::string const& fragmentShaderName)
+		{
+			if (!program.build(vertexShaderName, fragmentShaderName))
+			{
+				throw std::runtime_error("failed to build the shader program " + vertexShaderName + " + " +
+					fragmentShaderName);
+			}
+		}
+
+		// Block bindings, texture units and defaults of the forward program
+		// and its permutations
+		static void setUpForwardProgram(ShaderProgram& program)
+		{
+			program.setUniformBlockBinding("LightBlock", LightBlock::BINDING);
+			program.setUniformBlockBinding("ShadowBlock", ShadowBlock::BINDING);
+			program.enable();
+			program.setUniformInt("uLightData"   , LightBlock::LIGHT_DATA_UNIT);
+			program.setUniformInt("uClusters"    , LightBlock::CLUSTER_UNIT);
+			program.setUniformInt("uLightIndices", LightBlock::LIGHT_INDEX_UNIT);
+			program.setUniformInt("uShadowAtlas" , ShadowBlock::ATLAS_UNIT);
+			// Draws outside the render queue are opaque and lit by the light clusters
+			program.setUniformFloat("uOpacity", 1.0f);
+			program.setUniformInt("uObjectLightCount", -1);
+			program.disable();
+		}
+
+		// Gives the queued commands of the forward program its cheapest ready
+		// permutation
+		void assignVariants(bool blendedOnly)
+		{
+			if (m_shaderVariants)
+			{
+				m_frameStats.variantDraws =
+					m_variants.assign(m_renderQueue, m_shaderProgram, m_lightFeatures, blendedOnly);
+			}
+		}
+
+		// Issues the sorted commands [begin, end), with program instead of their
+		// own programs if it is given.  Uniforms that keep their value from one
+		// command to the next are skipped by the program's value cache
+		void submit(std::size_t begin, std::size_t end, ShaderProgram* programOverride)
+		{
+			GLState& state = GLState::get();
+			GLuint currentProgram = 0;
+			GLuint currentVao     = 0;
+			int    currentPass    = -1;
+			ShaderProgram* program = nullptr;
+			CommandUniforms uniforms;
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				RenderCommand const& command = m_renderQueue[i];
+				ShaderProgram* commandProgram = programOverride ? programOverride : command.shaderProgram;
+				int pass = m_renderQueue.isBlended(i) ? 1 : 0;
+				if (pass != currentPass)
+				{
+					if (pass == 1)
+					{
+						state.setEnabled(GL_BLEND, true);
+						state.depthMask(false);
+					}
+					else
+					{
+						state.setEnabled(GL_BLEND, false);
+					}
+					currentPass = pass;
+					++m_frameStats.stateChanges;
+				}
+				if (commandProgram->id() != currentProgram)
+				{
+					program = commandProgram;
+					program->enable();
+					currentProgram = program->id();
+					uniforms = CommandUniforms(*program);
+					++m_frameStats.stateChanges;
+				}
+				if (command.vertexArray->id() != currentVao)
+				{
+					command.vertexArray->bind();
+					currentVao = command.vertexArray->id();
+					++m_frameStats.stateChanges;
+				}
+				program->set(uniforms.world, command.worldMatrix);
+				program->set(uniforms.objectID, command.objectID);
+				program->set(uniforms.opacity, command.opacity);
+				program->set(uniforms.objectLightCount, command.lights.count);
+				if (command.lights.count > 0)
+				{
+					program->setArray(uniforms.objectLights, command.lights.count, command.lights.indices);
+				}
+				glDrawArrays(GL_TRIANGLES, 0, command.vertexCount);
+				++m_frameStats.drawCalls;
+			}
+
+			if (program)
+			{
+				program->set(uniforms.opacity, 1.0f);
+				program->set(uniforms.objectLightCount, -1);
+				state.bindVertexArray(0);
+				program->disable();
+			}
+			state.setEnabled(GL_BLEND, true);
+			state.depthMask(true);
+		}
+
+		// The uniforms submit sets per command, looked up when the program changes
+		struct CommandUniforms
+		{
+			CommandUniforms() = default;
+
+			explicit CommandUniforms(ShaderProgram const& program)
+				: world(program.uniform<Mat4>(U_WORLD)),
+				  objectID(program.uniform<int>(U_OBJECT_ID)),
+				  opacity(program.uniform<float>(U_OPACITY)),
+				  objectLightCount(program.uniform<int>(U_OBJECT_LIGHT_COUNT)),
+				  objectLights(program.uniform<int>(U_OBJECT_LIGHTS))
+			{
+			}
+
+			static constexpr UniformName U_WORLD              = "uWorld";
+			static constexpr UniformName U_OBJECT_ID          = "objectID";
+			static constexpr UniformName U_OPACITY            = "uOpacity";
+			static constexpr UniformName U_OBJECT_LIGHT_COUNT = "uObjectLightCount";
+			static constexpr UniformName U_OBJECT_LIGHTS      = "uObjectLights";
+
+			Uniform<Mat4>  world;
+			Uniform<int>   objectID;
+			Uniform<float> opacity;
+			Uniform<int>   objectLightCount;
+			Uniform<int>   objectLights;
+		};
+
+		// Shared by vertex edits and the meshes of a scene being streamed in
+		static constexpr GLsizeiptr STREAM_BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+		ShaderProgram  m_shaderProgram;
+		ShaderVariants m_variants;
+		LightFeatures  m_lightFeatures;
+		bool           m_shaderVariants = true;
+		// The deferred path: G-buffer fill, and full screen lighting
+		ShaderProgram m_geometryProgram;
+		ShaderProgram m_lightingProgram;
+		// Bound for the full screen triangle, which has no attributes
+		VertexArray   m_fullScreenArray;
+		ShadingPath   m_shadingPath = ShadingPath::Forward;
+		RingBuffer    m_streamBuffer;
+		RenderQueue   m_renderQueue;
+		RenderStats   m_stats;
+		RenderStats   m_frameStats;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Render/GLState.h"
+
+namespace VenusEngine
+{
+	// Counters collected by a RingBuffer over one frame
+	struct RingBufferStats
+	{
+		std::size_t bytesStreamed = 0;
+		std::size_t stallsWaited  = 0;
+	};
+
+	/// \brief A buffer for data that is rewritten every frame (uniforms, debug
+	///   geometry, edited vertices).
+	/// With ARB_buffer_storage the buffer is mapped once, persistently, and split
+	///   into FRAME_COUNT regions; a fence per region keeps the CPU from
+	///   overwriting data the GPU has not consumed yet.
+	/// Without it (plain GL 3.3) the buffer is orphaned at the start of every
+	///   frame and allocations are uploaded with glBufferSubData.
+	/// Whatever its target, an allocation can be bound as a uniform block
+	///   with bindRange if it is aligned to uniformAlignment().
+	class RingBuffer
+	{
+	public:
+		static constexpr int FRAME_COUNT = 3;
+
+		/// \brief A range of the ring buffer reserved for the current frame.
+		/// data is writable until commit() is called.
+		struct Allocation
+		{
+			void*      data   = nullptr;
+			GLintptr   offset = 0;
+			GLsizeiptr size   = 0;
+
+			bool valid() const
+			{
+				return data != nullptr;
+			}
+		};
+
+		/// \param[in] target The binding point the buffer is used with.
+		/// \param[in] bytesPerFrame The maximum number of bytes streamed per frame.
+		RingBuffer(GLenum target, GLsizeiptr bytesPerFrame)
+			: m_target(target), m_bytesPerFrame(bytesPerFrame)
+		{
+			glGenBuffers(1, &m_buffer);
+			GLState::get().bindBuffer(m_target, m_buffer);
+
+			m_persistent = GLAD_GL_ARB_buffer_storage && glBufferStorage != nullptr;
+			if (m_persistent)
+			{
+				GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(m_target, m_bytesPerFrame * FRAME_COUNT, nullptr, flags);
+				m_mapped = static_cast<char*>(glMapBufferRange(m_target, 0, m_bytesPerFrame * FRAME_COUNT, flags));
+				m_persistent = m_mapped != nullptr;
+			}
+			if (!m_persistent)
+			{
+				// Orphaning fallback: one frame worth of storage plus a CPU staging copy
+				glBufferData(m_target, m_bytesPerFrame, nullptr, GL_STREAM_DRAW);
+				m_staging.resize(static_cast<std::size_t>(m_bytesPerFrame));
+			}
+
+			GLState::get().bindBuffer(m_target, 0);
+
+			GLint uniformAlignment = 0;
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+			m_uniformAlignment = std::max<GLsizeiptr>(uniformAlignment, 16);
+
+			for (GLsync& fence : m_fences)
+			{
+				fence = nullptr;
+			}
+		}
+
+		~RingBuffer()
+		{
+			for (GLsync fence : m_fences)
+			{
+				if (fence)
+				{
+					glDeleteSync(fence);
+				}
+			}
+			if (m_persistent)
+			{
+				GLState::get().bindBuffer(m_target, m_buffer);
+				glUnmapBuffer(m_target);
+				GLState::get().bindBuffer(m_target, 0);
+			}
+			GLState::get().forgetBuffer(m_buffer);
+			glDeleteBuffers(1, &m_buffer);
+		}
+
+		RingBuffer(RingBuffer const&) = delete;
+		RingBuffer& operator=(RingBuffer const&) = delete;
+
+		/// \brief Starts writing into the next frame region.
+		/// \post The GPU has finished reading the region written FRAME_COUNT frames
+		///   ago, or the buffer has been orphaned.
+		void beginFrame()
+		{
+			m_head = 0;
+			if (m_persistent)
+			{
+				waitForFence(m_fences[m_frame]);
+				m_fences[m_frame] = nullptr;
+			}
+			else
+			{
+				GLState::get().bindBuffer(m_target, m_buffer);
+				glBufferData(m_target, m_bytesPerFrame, nullptr, GL_STREAM_DRAW);
+				GLState::get().bindBuffer(m_target, 0);
+			}
+		}
+
+		/// \brief Finishes the current frame region.
+		/// \post A fence guards the region and the frame counters were published.
+		void endFrame()
+		{
+			if (m_persistent)
+			{
+				m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				m_frame = (m_frame + 1) % FRAME_COUNT;
+			}
+			m_lastFrameStats = m_frameStats;
+			m_frameStats = {};
+		}
+
+		/// \brief Reserves size bytes in the current frame region.
+		/// \return An invalid Allocation if the frame region is full.
+		Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16)
+		{
+			GLsizeiptr offset = (m_head + alignment - 1) / alignment * alignment;
+			if (offset + size > m_bytesPerFrame)
+			{
+				return {};
+			}
+			m_head = offset + size;
+
+			Allocation allocation;
+			allocation.size = size;
+			if (m_persistent)
+			{
+				allocation.offset = m_frame * m_bytesPerFrame + offset;
+				allocation.data   = m_mapped + allocation.offset;
+			}
+			else
+			{
+				allocation.offset = offset;
+				allocation.data   = m_staging.data() + offset;
+			}
+			return allocation;
+		}
+
+		/// \return The largest allocation with the alignment that still fits in
+		///   the current frame region.
+		GLsizeiptr available(GLsizeiptr alignment = 16) const
+		{
+			GLsizeiptr offset = (m_head + alignment - 1) / alignment * alignment;
+			return std::max<GLsizeiptr>(m_bytesPerFrame - offset, 0);
+		}
+
+		/// \brief Makes the data written to allocation visible to the GPU.
+		/// The persistent mapping is coherent, so only the fallback has to upload.
+		void commit(Allocation const& allocation)
+		{
+			if (!m_persistent)
+			{
+				GLState::get().bindBuffer(m_target, m_buffer);
+				glBufferSubData(m_target, allocation.offset, allocation.size, allocation.data);
+				GLState::get().bindBuffer(m_target, 0);
+			}
+			m_frameStats.bytesStreamed += static_cast<std::size_t>(allocation.size);
+		}
+
+		/// \brief Copies data into the current frame region.
+		/// \return The allocation holding the data; invalid if it did not fit.
+		Allocation write(void const* data, GLsizeiptr size, GLsizeiptr alignment = 16)
+		{
+			Allocation allocation = allocate(size, alignment);
+			if (allocation.valid())
+			{
+				std::memcpy(allocation.data, data, static_cast<std::size_t>(size));
+				commit(allocation);
+			}
+			return allocation;
+		}
+
+		void bind()
+		{
+			GLState::get().bindBuffer(m_target, m_buffer);
+		}
+
+		void unbind()
+		{
+			GLState::get().bindBuffer(m_target, 0);
+		}
+
+		/// \brief Binds an allocation to an indexed binding point.
+		/// \param[in] target GL_UNIFORM_BUFFER, whichever target the buffer was
+		///   created for.
+		/// \pre For GL_UNIFORM_BUFFER, allocation was aligned to
+		///   uniformAlignment().
+		void bindRange(GLenum target, GLuint index, Allocation const& allocation)
+		{
+			GLState::get().bindBufferRange(target, index, m_buffer, allocation.offset, allocation.size);
+		}
+
+		// The offset alignment that uniform block ranges require
+		GLsizeiptr uniformAlignment() const
+		{
+			return m_uniformAlignment;
+		}
+
+		GLuint id() const
+		{
+			return m_buffer;
+		}
+
+		bool isPersistent() const
+		{
+			return m_persistent;
+		}
+
+		// Counters of the last finished frame
+		RingBufferStats const& frameStats() const
+		{
+			return m_lastFrameStats;
+		}
+
+	private:
+		void waitForFence(GLsync fence)
+		{
+			if (!fence)
+			{
+				return;
+			}
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			if (result == GL_TIMEOUT_EXPIRED)
+			{
+				// The GPU is still reading this region; block until it is done
+				++m_frameStats.stallsWaited;
+				do
+				{
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+				} while (result == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+		}
+
+	private:
+		GLenum     m_target;
+		GLuint     m_buffer = 0;
+		GLsizeiptr m_bytesPerFrame;
+		GLsizeiptr m_head  = 0;
+		int        m_frame = 0;
+		GLsizeiptr m_uniformAlignment = 16;
+
+		bool              m_persistent = false;
+		char*             m_mapped     = nullptr;
+		std::vector<char> m_staging;
+		GLsync            m_fences[FRAME_COUNT];
+
+		RingBufferStats m_frameStats;
+		RingBufferStats m_lastFrameStats;
+	};
+}
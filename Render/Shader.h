@@ -1,12 +1,11 @@
 #pragma once
 
+#include <iostream>
 #include <string>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-#include "Core/FileReader.h"
-
 namespace VenusEngine
 {
 	class Shader
@@ -22,21 +21,35 @@ namespace VenusEngine
 			glDeleteShader(m_shaderId);
 		}
 
-		void compile(std::string const& path)
+		/// \param name Where the source came from, for the error message.
+		/// \return false if the source does not compile.
+		bool compileSource(std::string const& sourceCode, std::string const& name)
+		{
+			beginCompile(sourceCode);
+			return checkCompiled(name);
+		}
+
+		/// \brief Hands the source to the driver, which may compile it on
+		///   threads of its own; checkCompiled waits for it.
+		void beginCompile(std::string const& sourceCode)
 		{
-			std::string sourceCode = FileReader::readFile(path);
 			GLchar const* sourceCodePtr = sourceCode.c_str();
 			// One array of char*. Do not need to specify length if null-terminated.
 			glShaderSource(m_shaderId, 1, &sourceCodePtr, nullptr);
 			glCompileShader(m_shaderId);
+		}
 
+		/// \return false, after reporting it, if the shader did not compile.
+		bool checkCompiled(std::string const& name)
+		{
 			GLint isCompiled;
 			glGetShaderiv(m_shaderId, GL_COMPILE_STATUS, &isCompiled);
 			if (isCompiled == GL_FALSE)
 			{
-				std::cout << "Compilation error; exiting\n" << path << std::endl;
-				exit(-1);
+				std::cout << "Compilation error\n" << name << std::endl;
+				return false;
 			}
+			return true;
 		}
 
 		void attach(GLuint programId)
@@ -6,11 +6,21 @@
 #include <string>
 #include <cstdio>
 #include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Core/Time.h"
+#include "Render/GLState.h"
+#include "Render/ProgramCache.h"
 #include "Render/Shader.h"
+#include "Render/ShaderSource.h"
+#include "Render/Uniform.h"
 #include "Math/MathHeaders.h"
 
 namespace VenusEngine
@@ -29,6 +39,7 @@ namespace VenusEngine
 		{
 			// Delete shaders and delete the program object.
 			// We assume shaders are not shared among multiple programs.
+			GLState::get().forgetProgram(m_programId);
 			glDeleteProgram(m_programId);
 		}
 
@@ -41,76 +52,309 @@ namespace VenusEngine
 			return glGetAttribLocation(m_programId, attributeName.c_str());
 		}
 
-		GLint getUniformLocation(std::string const& uniformName) const
+		/// \return The location of an active uniform, or -1.
+		GLint getUniformLocation(UniformName name) const
 		{
-			return glGetUniformLocation(m_programId, uniformName.c_str());
+			UniformSlot const* slot = find(m_uniforms, name);
+			return slot ? slot->location : -1;
 		}
 
-		void setUniformInt(std::string const& name, int value) const
+		/// \brief Looks up an active uniform once, for repeated sets.
+		/// \return The handle, invalid if the program has no such uniform or it
+		///   is of another type.
+		template <typename T>
+		Uniform<T> uniform(UniformName name) const
 		{
-			GLint location = getUniformLocation(name);
-			glUniform1i(location, value);
+			UniformSlot const* slot = find(m_uniforms, name);
+			if (!slot)
+			{
+				return Uniform<T>();
+			}
+			if (slot->setAs != UniformTraits<T>::TYPE)
+			{
+				// Once per uniform, as the name-based setters look it up every call
+				if (!slot->mismatchReported)
+				{
+					std::cout << "Uniform " << name.text << " is not of the type it is set as" << std::endl;
+					slot->mismatchReported = true;
+				}
+				return Uniform<T>();
+			}
+			return Uniform<T>(static_cast<std::int32_t>(slot - m_uniforms.data()));
 		}
 
-		void setUniformFloat(std::string const& name, float value) const
+		/// \brief Sets a uniform unless it already has the value.  Like
+		///   glUniform, this sets the program in use, which must be this one.
+		template <typename T>
+		void set(Uniform<T> uniform, T const& value)
 		{
-			GLint location = getUniformLocation(name);
-			glUniform1f(location, value);
+			setArray(uniform, 1, &value);
 		}
 
-		void setUniformVec3(std::string const& name, Vec3 const& value) const
+		/// \brief Sets the first count elements of a uniform array.
+		template <typename T>
+		void setArray(Uniform<T> uniform, GLsizei count, T const* values)
 		{
-			GLint location = getUniformLocation(name);
-			glUniform3fv(location, 1, value.ptr());
+			if (!uniform.valid())
+			{
+				return;
+			}
+			UniformSlot& slot = m_uniforms[uniform.m_slot];
+			count = std::min(count, slot.size);
+			unsigned char packed[16 * UniformTraits<T>::BYTES];
+			unsigned char* cached = &m_values[slot.offset];
+			for (GLsizei first = 0; first < count; first += 16)
+			{
+				GLsizei batch = std::min<GLsizei>(count - first, 16);
+				for (GLsizei i = 0; i < batch; ++i)
+				{
+					UniformTraits<T>::pack(values[first + i], packed + i * UniformTraits<T>::BYTES);
+				}
+				std::size_t bytes = static_cast<std::size_t>(batch) * UniformTraits<T>::BYTES;
+				unsigned char* cachedBatch = cached + static_cast<std::size_t>(first) * UniformTraits<T>::BYTES;
+				if (std::memcmp(cachedBatch, packed, bytes) == 0)
+				{
+					++uniformCounters().skipped;
+					continue;
+				}
+				std::memcpy(cachedBatch, packed, bytes);
+				UniformTraits<T>::upload(slot.location + first, batch, packed);
+				++uniformCounters().calls;
+			}
 		}
 
-		void setUniformMat4(std::string const& name, Mat4 const& value) const
+		void setUniformInt(UniformName name, int value)
 		{
-			GLint location = getUniformLocation(name);
-			float data[16];
-			value.toData(data);
-			glUniformMatrix4fv(location, 1, GL_TRUE, data);
+			set(uniform<int>(name), value);
 		}
 
-		void createVertexShader(std::string const& vertexShaderFilename)
+		void setUniformIntArray(UniformName name, GLsizei count, int const* values)
 		{
-			m_vertexShader.compile(vertexShaderFilename);
-			m_vertexShader.attach(m_programId);
+			setArray(uniform<int>(name), count, values);
+		}
+
+		void setUniformFloat(UniformName name, float value)
+		{
+			set(uniform<float>(name), value);
+		}
+
+		void setUniformVec3(UniformName name, Vec3 const& value)
+		{
+			set(uniform<Vec3>(name), value);
+		}
+
+		void setUniformVec4(UniformName name, Vec4 const& value)
+		{
+			set(uniform<Vec4>(name), value);
+		}
+
+		void setUniformMat4(UniformName name, Mat4 const& value)
+		{
+			set(uniform<Mat4>(name), value);
+		}
+
+		/// \brief Makes the uniform block named blockName read from a uniform
+		///   buffer binding point; blocks the program lacks are ignored.
+		void setUniformBlockBinding(UniformName blockName, GLuint binding) const
+		{
+			if (BlockSlot const* block = find(m_blocks, blockName))
+			{
+				glUniformBlockBinding(m_programId, block->index, binding);
+			}
+		}
+
+		/// \return The size in bytes of an active uniform block, or -1.
+		GLint getUniformBlockSize(UniformName blockName) const
+		{
+			BlockSlot const* block = find(m_blocks, blockName);
+			return block ? block->size : -1;
 		}
 
-		void createFragmentShader(std::string const& fragmentShaderFilename)
+		// glUniform calls made and skipped as redundant, by all programs
+		struct UniformCounters
 		{
-			m_fragmentShader.compile(fragmentShaderFilename);
+			std::size_t calls   = 0;
+			std::size_t skipped = 0;
+		};
+
+		static UniformCounters& uniformCounters()
+		{
+			static UniformCounters counters;
+			return counters;
+		}
+
+		enum class BuildStatus
+		{
+			// Loaded from the ProgramCache
+			Ready,
+			// finishBuild() must be called, once buildReady()
+			Building,
+			// A shader does not exist; finishBuild() reports the shaders that
+			// do not compile or link
+			Failed
+		};
+
+		/// \brief Compiles and links the program from two shaders of
+		///   ShaderSource, or loads it from the ProgramCache if it was built
+		///   before from the same sources on the same driver.
+		/// \param defines "#define" lines put after the #version line of both
+		///   shaders.
+		/// \return false if a shader does not exist, compile or link; the
+		///   program is then left unlinked.
+		bool build(std::string const& vertexShaderName, std::string const& fragmentShaderName,
+			std::string const& defines = "")
+		{
+			BuildStatus status = beginBuild(vertexShaderName, fragmentShaderName, defines);
+			if (status == BuildStatus::Building)
+			{
+				return finishBuild();
+			}
+			return status != BuildStatus::Failed;
+		}
+
+		/// \brief Starts build() without waiting for the driver: the program
+		///   is loaded from the ProgramCache, or its shaders are compiled and
+		///   linked on the driver's threads if it has parallel compilation.
+		BuildStatus beginBuild(std::string const& vertexShaderName, std::string const& fragmentShaderName,
+			std::string const& defines = "")
+		{
+			Timer timer;
+			std::string vertexSource, fragmentSource;
+			if (!ShaderSource::get(vertexShaderName, vertexSource) ||
+				!ShaderSource::get(fragmentShaderName, fragmentSource))
+			{
+				return BuildStatus::Failed;
+			}
+			vertexSource   = withDefines(std::move(vertexSource), defines);
+			fragmentSource = withDefines(std::move(fragmentSource), defines);
+			m_cacheKey = ProgramCache::key(vertexSource, fragmentSource, defines);
+
+			ProgramCache::Stats& stats = ProgramCache::stats();
+			++stats.programs;
+			float compileMilliseconds = 0.0f;
+			if (ProgramCache::load(m_programId, m_cacheKey, compileMilliseconds))
+			{
+				reflect();
+				++stats.loaded;
+				stats.compileMilliseconds += compileMilliseconds;
+				float milliseconds = timer.elapsedMilliseconds();
+				stats.loadMilliseconds    += milliseconds;
+				stats.buildMilliseconds   += milliseconds;
+				return BuildStatus::Ready;
+			}
+
+			m_vertexName   = vertexShaderName;
+			m_fragmentName = fragmentShaderName;
+			m_vertexShader.beginCompile(vertexSource);
+			m_vertexShader.attach(m_programId);
+			m_fragmentShader.beginCompile(fragmentSource);
 			m_fragmentShader.attach(m_programId);
+			if (ProgramCache::supported())
+			{
+				glProgramParameteri(m_programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			}
+			// Linking right away keeps the whole build on the driver's threads
+			glLinkProgram(m_programId);
+			m_buildMilliseconds = timer.elapsedMilliseconds();
+			return BuildStatus::Building;
 		}
 
-		void link()
+		/// \return Whether finishBuild() can be called without waiting for the
+		///   driver; always true without parallel compilation.
+		bool buildReady() const
+		{
+			if (!parallelCompile())
+			{
+				return true;
+			}
+			GLint isComplete = GL_FALSE;
+			glGetProgramiv(m_programId, GL_COMPLETION_STATUS_KHR, &isComplete);
+			return isComplete != GL_FALSE;
+		}
+
+		/// \brief Ends a build that beginBuild() started, and caches the binary.
+		/// \return false if a shader did not compile or the program did not
+		///   link; the program is then left unlinked.
+		bool finishBuild()
+		{
+			Timer timer;
+			bool compiled = m_vertexShader.checkCompiled(m_vertexName);
+			compiled = m_fragmentShader.checkCompiled(m_fragmentName) && compiled;
+			if (!compiled || !checkLinked())
+			{
+				return false;
+			}
+			// Only the time the caller was kept waiting; the cache saves that
+			float compileMilliseconds = m_buildMilliseconds + timer.elapsedMilliseconds();
+			ProgramCache::store(m_programId, m_cacheKey, compileMilliseconds);
+			ProgramCache::stats().buildMilliseconds += compileMilliseconds;
+			return true;
+		}
+
+		/// \brief Whether the driver compiles and links on threads of its own,
+		///   through KHR_parallel_shader_compile or its ARB version.
+		static bool parallelCompile()
+		{
+			return GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+		}
+
+		/// \return false if the program did not link.
+		bool link()
 		{
 			glLinkProgram(m_programId);
+			return checkLinked();
+		}
+
+		void enable()
+		{
+			GLState::get().useProgram(m_programId);
+		}
+
+		void disable()
+		{
+			GLState::get().useProgram(0);
+		}
+
+		GLuint id() const
+		{
+			return m_programId;
+		}
+
+	private:
+		// Reports a failed link; otherwise detaches the shaders and reflects
+		bool checkLinked()
+		{
 			GLint isLinked;
 			glGetProgramiv(m_programId, GL_LINK_STATUS, &isLinked);
 			if (isLinked == GL_FALSE)
 			{
 				fprintf(stderr, "Link error -- see log\n");
-				exit(-1);
+				return false;
 			}
 			// After linking, the shader objects no longer need to be attached.
 			// A shader won't be deleted until it is detached.
 			m_vertexShader.detach(m_programId);
 			m_fragmentShader.detach(m_programId);
+			reflect();
+			return true;
 		}
 
-		void enable()
-		{
-			glUseProgram(m_programId);
-		}
-
-		void disable()
+		// Puts the defines on the line after #version, which must come first
+		static std::string withDefines(std::string source, std::string const& defines)
 		{
-			glUseProgram(0);
+			if (defines.empty())
+			{
+				return source;
+			}
+			std::size_t lineEnd = source.find('\n', source.find("#version"));
+			if (lineEnd == std::string::npos)
+			{
+				return source + '\n' + defines;
+			}
+			source.insert(lineEnd + 1, defines);
+			return source;
 		}
 
-	private:
 		void writeInfoLog(GLuint shaderId, bool isShader, std::string const& logFilename) const
 		{
 			GLint infoLogLength = 0;
@@ -132,9 +376,154 @@ namespace VenusEngine
 			}
 		}
 
+		// Finds the active uniforms and uniform blocks, and starts the value
+		// cache at zero, the value linking gives uniforms without initializer
+		void reflect()
+		{
+			m_uniforms.clear();
+			m_blocks.clear();
+			GLint count = 0;
+			GLint maxLength = 0;
+			glGetProgramiv(m_programId, GL_ACTIVE_UNIFORMS, &count);
+			glGetProgramiv(m_programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+			std::string name(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+			std::size_t valueBytes = 0;
+			for (GLint i = 0; i < count; ++i)
+			{
+				GLsizei length = 0;
+				GLint size = 0;
+				GLenum type = 0;
+				glGetActiveUniform(m_programId, static_cast<GLuint>(i), maxLength, &length, &size, &type, &name[0]);
+				// Members of uniform blocks have no location
+				GLint location = glGetUniformLocation(m_programId, name.c_str());
+				if (location < 0)
+				{
+					continue;
+				}
+				std::string_view text(name.data(), static_cast<std::size_t>(length));
+				// Arrays are reported as their first element
+				if (text.size() > 3 && text.substr(text.size() - 3) == "[0]")
+				{
+					text.remove_suffix(3);
+				}
+				UniformSlot slot;
+				slot.hash     = hashUniformName(text);
+				slot.name     = text;
+				slot.location = location;
+				slot.type     = type;
+				slot.size     = size;
+				slot.bytes    = typeBytes(type);
+				// Samplers and bools are set as ints
+				slot.setAs    = type != GL_FLOAT && slot.bytes == sizeof(GLint) ? GL_INT : type;
+				slot.offset   = valueBytes;
+				valueBytes   += static_cast<std::size_t>(slot.bytes) * static_cast<std::size_t>(size);
+				m_uniforms.push_back(slot);
+			}
+			m_values.assign(valueBytes, 0);
+
+			glGetProgramiv(m_programId, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+			glGetProgramiv(m_programId, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+			name.assign(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+			for (GLint i = 0; i < count; ++i)
+			{
+				GLsizei length = 0;
+				glGetActiveUniformBlockName(m_programId, static_cast<GLuint>(i), maxLength, &length, &name[0]);
+				BlockSlot block;
+				block.name  = std::string_view(name.data(), static_cast<std::size_t>(length));
+				block.hash  = hashUniformName(block.name);
+				block.index = static_cast<GLuint>(i);
+				glGetActiveUniformBlockiv(m_programId, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.size);
+				m_blocks.push_back(block);
+			}
+
+			sortByHash(m_uniforms);
+			sortByHash(m_blocks);
+		}
+
+		// Bytes the cache keeps per element of a uniform type
+		static GLint typeBytes(GLenum type)
+		{
+			switch (type)
+			{
+			case GL_FLOAT_VEC2:
+			case GL_INT_VEC2:
+				return 8;
+			case GL_FLOAT_VEC3:
+			case GL_INT_VEC3:
+				return 12;
+			case GL_FLOAT_VEC4:
+			case GL_INT_VEC4:
+			case GL_FLOAT_MAT2:
+				return 16;
+			case GL_FLOAT_MAT3:
+				return 36;
+			case GL_FLOAT_MAT4:
+				return 64;
+			default:
+				// Scalars and samplers
+				return 4;
+			}
+		}
+
+		template <typename Slot>
+		static void sortByHash(std::vector<Slot>& slots)
+		{
+			std::sort(slots.begin(), slots.end(), [](Slot const& a, Slot const& b) { return a.hash < b.hash; });
+		}
+
+		// The hash narrows the search; the name settles it, as two names may
+		// share a hash
+		template <typename Slot>
+		static Slot const* find(std::vector<Slot> const& slots, UniformName name)
+		{
+			auto iter = std::lower_bound(slots.begin(), slots.end(), name.hash,
+				[](Slot const& slot, std::uint32_t hash) { return slot.hash < hash; });
+			for (; iter != slots.end() && iter->hash == name.hash; ++iter)
+			{
+				if (iter->name == name.text)
+				{
+					return &*iter;
+				}
+			}
+			return nullptr;
+		}
+
+		struct UniformSlot
+		{
+			std::uint32_t hash     = 0;
+			std::string   name;
+			GLint         location = -1;
+			GLenum        type     = 0;
+			// The UniformTraits type that sets it
+			GLenum        setAs    = 0;
+			// Array length, 1 for other uniforms
+			GLint         size     = 1;
+			GLint         bytes    = 0;
+			// Where the last values set are, in m_values
+			std::size_t   offset   = 0;
+			mutable bool  mismatchReported = false;
+		};
+
+		struct BlockSlot
+		{
+			std::uint32_t hash  = 0;
+			std::string   name;
+			GLuint        index = 0;
+			GLint         size  = 0;
+		};
+
 	private:
 		GLuint m_programId;
 		Shader m_vertexShader;
 		Shader m_fragmentShader;
+		// Sorted by name hash
+		std::vector<UniformSlot>   m_uniforms;
+		std::vector<BlockSlot>     m_blocks;
+		std::vector<unsigned char> m_values;
+		// The build beginBuild() started
+		std::uint64_t              m_cacheKey          = 0;
+		float                      m_buildMilliseconds = 0.0f;
+		std::string                m_vertexName;
+		std::string                m_fragmentName;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "Core/FileReader.h"
+#include "Render/EmbeddedShaders.h"
+
+namespace VenusEngine
+{
+	/// \brief The sources of the shaders, by file name, e.g. "GeneralShader.frag".
+	/// They are compiled into the program by cmake/EmbedShaders.cmake, which
+	///   resolves their #include lines.  A build configured with
+	///   VENUS_SHADER_OVERRIDE_DIR first looks for each shader, and each file
+	///   it includes, in that directory, so that shaders can be edited without
+	///   rebuilding.
+	class ShaderSource
+	{
+	public:
+		/// \return false if there is no shader of that name.
+		static bool get(std::string const& name, std::string& source)
+		{
+#ifdef VENUS_SHADER_OVERRIDE_DIR
+			return readOverride(name, source, 0);
+#else
+			if (embedded(name, source))
+			{
+				return true;
+			}
+			std::cout << "There is no shader " << name << std::endl;
+			return false;
+#endif
+		}
+
+	private:
+		static bool embedded(std::string const& name, std::string& source)
+		{
+			for (EmbeddedShader const& shader : EMBEDDED_SHADERS)
+			{
+				if (shader.name == name)
+				{
+					source.assign(shader.source);
+					return true;
+				}
+			}
+			return false;
+		}
+
+#ifdef VENUS_SHADER_OVERRIDE_DIR
+		// Deeper includes are taken for a cycle
+		static constexpr int MAX_INCLUDE_DEPTH = 16;
+
+		// Reads a shader from the override directory, or else the table, and
+		// resolves its includes like EmbedShaders.cmake does
+		static bool readOverride(std::string const& name, std::string& source, int depth)
+		{
+			if (depth > MAX_INCLUDE_DEPTH)
+			{
+				std::cout << "Shader includes nest too deep at " << name << std::endl;
+				return false;
+			}
+			if (!FileReader::readFile(std::string(VENUS_SHADER_OVERRIDE_DIR) + "/" + name, source) &&
+				!embedded(name, source))
+			{
+				std::cout << "There is no shader " << name << std::endl;
+				return false;
+			}
+			std::string_view const directive = "#include \"";
+			for (std::size_t start = source.find(directive); start != std::string::npos;
+				start = source.find(directive, start))
+			{
+				std::size_t nameStart = start + directive.size();
+				std::size_t nameEnd   = source.find('"', nameStart);
+				if (nameEnd == std::string::npos)
+				{
+					break;
+				}
+				std::string included;
+				if (!readOverride(source.substr(nameStart, nameEnd - nameStart), included, depth + 1))
+				{
+					return false;
+				}
+				source.replace(start, nameEnd + 1 - start, included);
+				start += included.size();
+			}
+			return true;
+		}
+#endif
+	};
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Render/RenderQueue.h"
+#include "Render/ShaderProgram.h"
+
+namespace VenusEngine
+{
+	/// \brief What the lights of a frame ask of the forward shader.
+	struct LightFeatures
+	{
+		// Without lights, objects show their vertex colors
+		bool lit         = true;
+		bool directional = true;
+		bool spot        = true;
+		bool shadows     = true;
+	};
+
+	/// \brief Permutations of the forward shader, each compiled with the
+	///   "#define"s of one case, so that branches the case does not need are
+	///   compiled out: no lights, no directional or spot lights, no shadows,
+	///   and a fixed count of per-object lights or the cluster lights.
+	/// A permutation is built the first time a draw asks for it, on the
+	///   driver's threads if it has parallel compilation, and a few at a time
+	///   otherwise.  Until it is ready, the draw keeps the general program,
+	///   and for good if it fails to build.
+	class ShaderVariants
+	{
+	public:
+		// Bits of a permutation; the per-object light count, plus one, takes
+		// the bits from OBJECT_LIGHT_SHIFT, and 0 there means the clusters
+		static constexpr std::uint32_t VERTEX_COLOR_ONLY     = 1u << 0;
+		static constexpr std::uint32_t NO_DIRECTIONAL_LIGHTS = 1u << 1;
+		static constexpr std::uint32_t NO_SPOT_LIGHTS        = 1u << 2;
+		static constexpr std::uint32_t NO_SHADOWS            = 1u << 3;
+		static constexpr int           OBJECT_LIGHT_SHIFT    = 4;
+		static constexpr std::uint32_t PERMUTATION_COUNT     = (ObjectLights::MAX_LIGHTS + 2) << OBJECT_LIGHT_SHIFT;
+
+		// Builds in flight with parallel compilation, and builds started per
+		// frame without it, as each then blocks the frame
+		static constexpr std::size_t MAX_PARALLEL_BUILDS = 8;
+		static constexpr std::size_t MAX_SERIAL_BUILDS   = 1;
+
+		/// \param setUp Gives a ready permutation the bindings and constant
+		///   uniforms of the general program.
+		ShaderVariants(std::string const& vertexShaderName, std::string const& fragmentShaderName,
+			std::function<void(ShaderProgram&)> setUp)
+			: m_vertexShaderName(vertexShaderName),
+			  m_fragmentShaderName(fragmentShaderName),
+			  m_setUp(std::move(setUp))
+		{
+			// Let the driver pick its number of compiler threads
+			if (GLAD_GL_KHR_parallel_shader_compile)
+			{
+				glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+			}
+			else if (GLAD_GL_ARB_parallel_shader_compile)
+			{
+				glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+			}
+		}
+
+		ShaderVariants(ShaderVariants const&) = delete;
+
+		void operator=(ShaderVariants const&) = delete;
+
+		/// \return The cheapest permutation that draws an object correctly.
+		/// \param objectLightCount ObjectLights::count of the object.
+		static std::uint32_t permutation(LightFeatures const& features, int objectLightCount)
+		{
+			if (!features.lit)
+			{
+				return VERTEX_COLOR_ONLY;
+			}
+			std::uint32_t bits = 0;
+			bits |= features.directional ? 0 : NO_DIRECTIONAL_LIGHTS;
+			bits |= features.spot ? 0 : NO_SPOT_LIGHTS;
+			bits |= features.shadows ? 0 : NO_SHADOWS;
+			bits |= static_cast<std::uint32_t>(objectLightCount + 1) << OBJECT_LIGHT_SHIFT;
+			return bits;
+		}
+
+		/// \return The program of a permutation, or nullptr if it is not ready;
+		///   a permutation asked for the first time is queued to be built.
+		ShaderProgram* find(std::uint32_t permutation)
+		{
+			Variant& variant = m_variants[permutation];
+			if (variant.state == State::Ready)
+			{
+				return variant.program.get();
+			}
+			if (variant.state == State::Unused)
+			{
+				variant.state = State::Queued;
+				m_queued.push_back(permutation);
+			}
+			return nullptr;
+		}
+
+		/// \brief Finishes the builds the driver is done with and starts queued
+		///   ones.  Permutations that become ready here are set up, so this is
+		///   called before the frame sets its uniforms.
+		void update()
+		{
+			for (std::size_t i = 0; i < m_building.size();)
+			{
+				Variant& variant = m_variants[m_building[i]];
+				if (!variant.program->buildReady())
+				{
+					++i;
+					continue;
+				}
+				if (variant.program->finishBuild())
+				{
+					ready(variant);
+				}
+				else
+				{
+					// Like a missing shader, its draws keep the general program
+					variant.program.reset();
+					variant.state = State::Failed;
+				}
+				m_building[i] = m_building.back();
+				m_building.pop_back();
+			}
+
+			std::size_t started = 0;
+			std::size_t limit   = ShaderProgram::parallelCompile() ? MAX_PARALLEL_BUILDS : MAX_SERIAL_BUILDS;
+			while (!m_queued.empty() && m_building.size() < limit && started < limit)
+			{
+				std::uint32_t permutation = m_queued.back();
+				m_queued.pop_back();
+				Variant& variant = m_variants[permutation];
+				variant.program = std::make_unique<ShaderProgram>();
+				ShaderProgram::BuildStatus status =
+					variant.program->beginBuild(m_vertexShaderName, m_fragmentShaderName, defines(permutation));
+				if (status == ShaderProgram::BuildStatus::Ready)
+				{
+					// Loaded from the program cache
+					ready(variant);
+					continue;
+				}
+				if (status == ShaderProgram::BuildStatus::Failed)
+				{
+					// Never asked for again; its draws keep the general program
+					variant.state = State::Failed;
+					continue;
+				}
+				variant.state = State::Building;
+				m_building.push_back(permutation);
+				++started;
+			}
+		}
+
+		/// \brief Replaces the general program of the queued commands by the
+		///   cheapest ready permutation for each.
+		/// \param blendedOnly Leaves the opaque commands, e.g. as the deferred
+		///   path draws them with its own program.
+		/// \pre The queue is not sorted yet, and its lights are selected.
+		/// \return The number of commands that got a permutation.
+		std::size_t assign(RenderQueue& queue, ShaderProgram const& general, LightFeatures const& features,
+			bool blendedOnly)
+		{
+			std::size_t assigned = 0;
+			std::vector<RenderCommand> const& commands = queue.commands();
+			for (std::size_t i = 0; i < commands.size(); ++i)
+			{
+				// Unsorted, the queue is in the order of commands()
+				if (commands[i].shaderProgram != &general || (blendedOnly && !queue.isBlended(i)))
+				{
+					continue;
+				}
+				if (ShaderProgram* program = find(permutation(features, commands[i].lights.count)))
+				{
+					queue.setProgram(i, program);
+					++assigned;
+				}
+			}
+			return assigned;
+		}
+
+		/// \brief Calls function with every ready permutation, e.g. to give it
+		///   the camera uniforms of the frame.
+		template <typename Function>
+		void forEachReady(Function function)
+		{
+			for (ShaderProgram* program : m_ready)
+			{
+				function(*program);
+			}
+		}
+
+		std::size_t readyCount() const
+		{
+			return m_ready.size();
+		}
+
+		std::size_t buildingCount() const
+		{
+			return m_building.size() + m_queued.size();
+		}
+
+	private:
+		enum class State : std::uint8_t
+		{
+			Unused,
+			Queued,
+			Building,
+			Ready,
+			Failed
+		};
+
+		struct Variant
+		{
+			State                          state = State::Unused;
+			std::unique_ptr<ShaderProgram> program;
+		};
+
+		void ready(Variant& variant)
+		{
+			m_setUp(*variant.program);
+			variant.state = State::Ready;
+			m_ready.push_back(variant.program.get());
+		}
+
+		static std::string defines(std::uint32_t permutation)
+		{
+			// Permutations are only drawn by the render queue
+			std::string text = "#define PERMUTATION\n";
+			if (permutation & VERTEX_COLOR_ONLY)
+			{
+				return text + "#define VERTEX_COLOR_ONLY\n";
+			}
+			if (permutation & NO_DIRECTIONAL_LIGHTS)
+			{
+				text += "#define NO_DIRECTIONAL_LIGHTS\n";
+			}
+			if (permutation & NO_SPOT_LIGHTS)
+			{
+				text += "#define NO_SPOT_LIGHTS\n";
+			}
+			if (permutation & NO_SHADOWS)
+			{
+				text += "#define NO_SHADOWS\n";
+			}
+			int objectLightCount = static_cast<int>(permutation >> OBJECT_LIGHT_SHIFT) - 1;
+			if (objectLightCount < 0)
+			{
+				text += "#define CLUSTERED_LIGHTS\n";
+			}
+			else
+			{
+				text += "#define OBJECT_LIGHT_COUNT " + std::to_string(objectLightCount) + "\n";
+			}
+			return text;
+		}
+
+	private:
+		std::string                               m_vertexShaderName;
+		std::string                               m_fragmentShaderName;
+		std::function<void(ShaderProgram&)>       m_setUp;
+		std::array<Variant, PERMUTATION_COUNT>    m_variants;
+		std::vector<std::uint32_t>                m_queued;
+		std::vector<std::uint32_t>                m_building;
+		std::vector<ShaderProgram*>               m_ready;
+	};
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Render/Framebuffer.h"
+#include "Render/GLState.h"
+#include "Render/Texture.h"
+
+namespace VenusEngine
+{
+	/// \brief Square depth textures split into TILE_COUNT shadow maps.
+	/// There are two layers: the static layer caches what does not move, and
+	///   the live layer, which the shaders read, is a copy of it with the
+	///   moving casters drawn over it.
+	class ShadowAtlas
+	{
+	public:
+		static constexpr GLsizei SIZE          = 4096;
+		static constexpr GLsizei TILE_SIZE     = 1024;
+		static constexpr int     TILES_PER_ROW = SIZE / TILE_SIZE;
+		static constexpr int     TILE_COUNT    = TILES_PER_ROW * TILES_PER_ROW;
+
+		enum class Layer
+		{
+			Static,
+			Live
+		};
+
+		ShadowAtlas()
+		{
+			create(m_staticTexture, m_staticFramebuffer);
+			create(m_liveTexture, m_liveFramebuffer);
+			// Sampled with hardware depth comparison and bilinear filtering
+			m_liveTexture.bind();
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+			m_liveTexture.filter(GL_LINEAR);
+			m_liveTexture.unbind();
+		}
+
+		ShadowAtlas(ShadowAtlas const&) = delete;
+
+		void operator=(ShadowAtlas const&) = delete;
+
+		/// \brief Binds a layer with the viewport on one tile, and clears the
+		///   tile to the far plane.
+		void beginTile(Layer layer, int tile)
+		{
+			(layer == Layer::Static ? m_staticFramebuffer : m_liveFramebuffer).bind();
+			GLState& state = GLState::get();
+			state.viewport(tileX(tile), tileY(tile), TILE_SIZE, TILE_SIZE);
+			state.setEnabled(GL_SCISSOR_TEST, true);
+			glScissor(tileX(tile), tileY(tile), TILE_SIZE, TILE_SIZE);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			state.setEnabled(GL_SCISSOR_TEST, false);
+		}
+
+		/// \brief Copies a tile of the static layer into the live layer and
+		///   leaves the live layer bound with the viewport on the tile.
+		void copyStaticTile(int tile)
+		{
+			GLint x = tileX(tile);
+			GLint y = tileY(tile);
+			m_liveFramebuffer.bind();
+			GLState::get().bindFramebuffer(GL_READ_FRAMEBUFFER, m_staticFramebuffer.id());
+			glBlitFramebuffer(x, y, x + TILE_SIZE, y + TILE_SIZE, x, y, x + TILE_SIZE, y + TILE_SIZE,
+				GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			GLState::get().viewport(x, y, TILE_SIZE, TILE_SIZE);
+		}
+
+		/// \brief Binds the live layer for the shaders.
+		void bindUnit(GLuint unit)
+		{
+			m_liveTexture.bindUnit(unit);
+		}
+
+		static GLint tileX(int tile)
+		{
+			return (tile % TILES_PER_ROW) * TILE_SIZE;
+		}
+
+		static GLint tileY(int tile)
+		{
+			return (tile / TILES_PER_ROW) * TILE_SIZE;
+		}
+
+	private:
+		void create(Texture& texture, Framebuffer& framebuffer)
+		{
+			texture.bind();
+			texture.image2D(GL_DEPTH_COMPONENT24, SIZE, SIZE, GL_DEPTH_COMPONENT, GL_FLOAT);
+			texture.filter(GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			texture.unbind();
+
+			framebuffer.bind();
+			framebuffer.texture2D(GL_DEPTH_ATTACHMENT, texture.id());
+			// Depth only
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			framebuffer.unbind();
+		}
+
+	private:
+		Texture     m_staticTexture;
+		Texture     m_liveTexture;
+		Framebuffer m_staticFramebuffer;
+		Framebuffer m_liveFramebuffer;
+	};
+}
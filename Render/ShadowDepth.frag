@@ -0,0 +1,14 @@
+#version 330
+
+/*
+  Filename: ShadowDepth.frag
+  Description: Shadow maps have no color attachment; the depth of each
+    fragment is all that is written.
+*/
+
+precision highp float;
+
+void
+main ()
+{
+}
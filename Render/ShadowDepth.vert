@@ -0,0 +1,22 @@
+#version 330
+
+/*
+  Filename: ShadowDepth.vert
+  Description: Draws shadow casters into a shadow map, as seen from the
+    light.  Only depth is written.
+*/
+
+precision highp float;
+
+// Input from the VBO, at the location given by VertexSemantic.
+layout(location = 0) in vec3 aPosition;
+
+// World space to the clip space of the light, provided by C++ code.
+uniform mat4 uLightViewProjection;
+uniform mat4 uWorld;
+
+void
+main (void)
+{
+  gl_Position = uLightViewProjection * uWorld * vec4(aPosition, 1.0);
+}
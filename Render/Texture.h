@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Render/GLState.h"
+
 namespace VenusEngine
 {
 	class Texture
@@ -15,17 +17,25 @@ namespace VenusEngine
 
 		~Texture()
 		{
+			GLState::get().forgetTexture(m_texture);
 			glDeleteTextures(1, &m_texture);
 		}
 
+		// Binds to unit 0 and leaves it active, for the calls that edit the texture
 		void bind()
 		{
-			glBindTexture(GL_TEXTURE_2D, m_texture);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, m_texture);
 		}
 
 		void unbind()
 		{
-			glBindTexture(GL_TEXTURE_2D, 0);
+			GLState::get().bindTexture(0, GL_TEXTURE_2D, 0);
+		}
+
+		// Binds to a unit for the shaders, and leaves that unit active
+		void bindUnit(GLuint unit)
+		{
+			GLState::get().bindTexture(unit, GL_TEXTURE_2D, m_texture);
 		}
 
 		void image2D(GLint internalformat, GLsizei width, GLsizei height, GLenum format, GLenum type)
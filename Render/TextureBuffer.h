@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Render/GLState.h"
+
+namespace VenusEngine
+{
+	// A buffer read by shaders through a samplerBuffer, as an array of texels
+	class TextureBuffer
+	{
+	public:
+		explicit TextureBuffer(GLenum internalFormat)
+			: m_internalFormat(internalFormat)
+		{
+			glGenBuffers(1, &m_buffer);
+			glGenTextures(1, &m_texture);
+		}
+
+		~TextureBuffer()
+		{
+			GLState::get().forgetTexture(m_texture);
+			GLState::get().forgetBuffer(m_buffer);
+			glDeleteTextures(1, &m_texture);
+			glDeleteBuffers(1, &m_buffer);
+		}
+
+		TextureBuffer(TextureBuffer const&) = delete;
+
+		void operator=(TextureBuffer const&) = delete;
+
+		// Respecifies the storage, so the driver can orphan the old contents
+		// instead of waiting for draws that still read them
+		void bufferData(GLsizeiptr size, void const* data)
+		{
+			GLState::get().bindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+			glBufferData(GL_TEXTURE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+			GLState::get().bindBuffer(GL_TEXTURE_BUFFER, 0);
+			if (!m_attached)
+			{
+				GLState::get().bindTexture(0, GL_TEXTURE_BUFFER, m_texture);
+				glTexBuffer(GL_TEXTURE_BUFFER, m_internalFormat, m_buffer);
+				GLState::get().bindTexture(0, GL_TEXTURE_BUFFER, 0);
+				m_attached = true;
+			}
+		}
+
+		// Binds the texture to a texture unit, which is left active
+		void bindUnit(GLuint unit)
+		{
+			GLState::get().bindTexture(unit, GL_TEXTURE_BUFFER, m_texture);
+		}
+
+		// The most texels a texture buffer may hold
+		static GLint maxTexels()
+		{
+			GLint texels = 0;
+			glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+			return texels;
+		}
+
+	private:
+		GLenum m_internalFormat;
+		GLuint m_buffer;
+		GLuint m_texture;
+		bool   m_attached = false;
+	};
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include <glad/glad.h>
+
+#include "Math/MathHeaders.h"
+
+namespace VenusEngine
+{
+	/// \brief FNV-1a hash of a uniform name.  It is constexpr, so names
+	///   written in the code can be hashed at compile time.
+	constexpr std::uint32_t hashUniformName(std::string_view name)
+	{
+		std::uint32_t hash = 2166136261u;
+		for (char c : name)
+		{
+			hash ^= static_cast<std::uint8_t>(c);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	/// \brief A uniform or uniform block name with its hash, as ShaderProgram
+	///   looks them up.  A string literal converts to it; declaring it
+	///   constexpr hashes it at compile time.
+	struct UniformName
+	{
+		constexpr UniformName(char const* name)
+			: text(name), hash(hashUniformName(name))
+		{
+		}
+
+		std::string_view text;
+		std::uint32_t    hash;
+	};
+
+	/// \brief How a C++ type is passed to glUniform*.
+	template <typename T>
+	struct UniformTraits;
+
+	template <>
+	struct UniformTraits<int>
+	{
+		static constexpr GLenum TYPE  = GL_INT;
+		static constexpr int    BYTES = sizeof(GLint);
+
+		static void pack(int value, void* bytes)
+		{
+			std::memcpy(bytes, &value, BYTES);
+		}
+
+		static void upload(GLint location, GLsizei count, void const* bytes)
+		{
+			glUniform1iv(location, count, static_cast<GLint const*>(bytes));
+		}
+	};
+
+	template <>
+	struct UniformTraits<float>
+	{
+		static constexpr GLenum TYPE  = GL_FLOAT;
+		static constexpr int    BYTES = sizeof(GLfloat);
+
+		static void pack(float value, void* bytes)
+		{
+			std::memcpy(bytes, &value, BYTES);
+		}
+
+		static void upload(GLint location, GLsizei count, void const* bytes)
+		{
+			glUniform1fv(location, count, static_cast<GLfloat const*>(bytes));
+		}
+	};
+
+	template <>
+	struct UniformTraits<Vec3>
+	{
+		static constexpr GLenum TYPE  = GL_FLOAT_VEC3;
+		static constexpr int    BYTES = 3 * sizeof(GLfloat);
+
+		static void pack(Vec3 const& value, void* bytes)
+		{
+			std::memcpy(bytes, value.ptr(), BYTES);
+		}
+
+		static void upload(GLint location, GLsizei count, void const* bytes)
+		{
+			glUniform3fv(location, count, static_cast<GLfloat const*>(bytes));
+		}
+	};
+
+	template <>
+	struct UniformTraits<Vec4>
+	{
+		static constexpr GLenum TYPE  = GL_FLOAT_VEC4;
+		static constexpr int    BYTES = 4 * sizeof(GLfloat);
+
+		static void pack(Vec4 const& value, void* bytes)
+		{
+			float data[4] = { value.x, value.y, value.z, value.w };
+			std::memcpy(bytes, data, BYTES);
+		}
+
+		static void upload(GLint location, GLsizei count, void const* bytes)
+		{
+			glUniform4fv(location, count, static_cast<GLfloat const*>(bytes));
+		}
+	};
+
+	template <>
+	struct UniformTraits<Mat4>
+	{
+		static constexpr GLenum TYPE  = GL_FLOAT_MAT4;
+		static constexpr int    BYTES = 16 * sizeof(GLfloat);
+
+		static void pack(Mat4 const& value, void* bytes)
+		{
+			float data[16];
+			value.toData(data);
+			std::memcpy(bytes, data, BYTES);
+		}
+
+		// Mat4 is stored by rows
+		static void upload(GLint location, GLsizei count, void const* bytes)
+		{
+			glUniformMatrix4fv(location, count, GL_TRUE, static_cast<GLfloat const*>(bytes));
+		}
+	};
+
+	/// \brief An active uniform of a linked ShaderProgram, looked up once.
+	///   Setting it through the program needs no name lookup.  A default
+	///   constructed handle, or one for a uniform the program lacks, is
+	///   invalid, and setting it does nothing.
+	template <typename T>
+	class Uniform
+	{
+	public:
+		Uniform() = default;
+
+		bool valid() const
+		{
+			return m_slot >= 0;
+		}
+
+	private:
+		friend class ShaderProgram;
+
+		explicit Uniform(std::int32_t slot)
+			: m_slot(slot)
+		{
+		}
+
+		std::int32_t m_slot = -1;
+	};
+}
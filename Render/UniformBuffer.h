@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "Render/GLState.h"
+#include "Render/RingBuffer.h"
+
+namespace VenusEngine
+{
+	class UniformBuffer
+	{
+	public:
+		UniformBuffer()
+		{
+			glGenBuffers(1, &m_uniformBuffer);
+		}
+
+		~UniformBuffer()
+		{
+			GLState::get().forgetBuffer(m_uniformBuffer);
+			glDeleteBuffers(1, &m_uniformBuffer);
+		}
+
+		UniformBuffer(UniformBuffer const&) = delete;
+
+		void operator=(UniformBuffer const&) = delete;
+
+		void bind()
+		{
+			GLState::get().bindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer);
+		}
+
+		void bufferData(GLsizeiptr size, void const* data, GLenum usage)
+		{
+			glBufferData(GL_UNIFORM_BUFFER, size, data, usage);
+		}
+
+		void bufferSubData(GLintptr offset, GLsizeiptr size, void const* newData)
+		{
+			glBufferSubData(GL_UNIFORM_BUFFER, offset, size, newData);
+		}
+
+		/// \brief Replaces the first size bytes of this buffer by data, staged in
+		///   the ring buffer and copied on the GPU, so that draws still reading
+		///   the old contents are not waited for.  If the ring buffer is full
+		///   this frame, the data is uploaded directly.
+		/// \pre The buffer has storage for size bytes.
+		void stream(RingBuffer& streamBuffer, void const* data, GLsizeiptr size)
+		{
+			RingBuffer::Allocation allocation = streamBuffer.write(data, size);
+			if (allocation.valid())
+			{
+				// The copy targets are left bound, like VertexBuffer::copySubData
+				GLState::get().bindBuffer(GL_COPY_READ_BUFFER, streamBuffer.id());
+				GLState::get().bindBuffer(GL_COPY_WRITE_BUFFER, m_uniformBuffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, 0, size);
+			}
+			else
+			{
+				bind();
+				bufferSubData(0, size, data);
+				unbind();
+			}
+		}
+
+		// make the whole buffer the source of the blocks bound to a binding point
+		void bindBase(GLuint binding)
+		{
+			GLState::get().bindBufferBase(GL_UNIFORM_BUFFER, binding, m_uniformBuffer);
+		}
+
+		void unbind()
+		{
+			GLState::get().bindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+
+	private:
+		GLuint m_uniformBuffer;
+	};
+}
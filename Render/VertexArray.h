@@ -3,6 +3,10 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Render/GLState.h"
+
+#include "Render/VertexLayout.h"
+
 namespace VenusEngine
 {
 	class VertexArray
@@ -15,17 +19,31 @@ namespace VenusEngine
 
 		~VertexArray()
 		{
+			GLState::get().forgetVertexArray(m_vertexArray);
 			glDeleteVertexArrays(1, &m_vertexArray);
 		}
 
 		void bind()
 		{
-			glBindVertexArray(m_vertexArray);
+			GLState::get().bindVertexArray(m_vertexArray);
 		}
 
 		void unbind()
 		{
-			glBindVertexArray(0);
+			GLState::get().bindVertexArray(0);
+		}
+
+		GLuint id() const
+		{
+			return m_vertexArray;
+		}
+
+		/// \brief Configures the attributes of a vertex format.
+		/// \pre This VAO and the VBO holding Layout's data are bound.
+		template<typename Layout>
+		void setLayout()
+		{
+			Layout::enableAttributes();
 		}
 
 	private:
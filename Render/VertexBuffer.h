@@ -3,6 +3,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "Render/GLState.h"
+
 namespace VenusEngine
 {
 	class VertexBuffer
@@ -15,12 +17,13 @@ namespace VenusEngine
 
 		~VertexBuffer()
 		{
+			GLState::get().forgetBuffer(m_vertexBuffer);
 			glDeleteBuffers(1, &m_vertexBuffer);
 		}
 
 		void bind()
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+			GLState::get().bindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
 		}
 
 		void bufferData(GLsizeiptr size, void const* data, GLenum usage)
@@ -33,9 +36,19 @@ namespace VenusEngine
 			glBufferSubData(GL_ARRAY_BUFFER, offset, size, newData);
 		}
 
+		// copy a range of another buffer (e.g. a RingBuffer allocation) into this one
+		void copySubData(GLuint readBuffer, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+		{
+			// The copy targets are left bound, as nothing else reads them and the
+			// next copy usually binds the same buffers
+			GLState::get().bindBuffer(GL_COPY_READ_BUFFER, readBuffer);
+			GLState::get().bindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, readOffset, writeOffset, size);
+		}
+
 		void unbind()
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			GLState::get().bindBuffer(GL_ARRAY_BUFFER, 0);
 		}
 
 	private:
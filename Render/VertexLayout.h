@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+namespace VenusEngine
+{
+	// The meaning of a vertex attribute. The value is the shader input location.
+	enum class VertexSemantic : GLuint
+	{
+		Position = 0,
+		Normal   = 1,
+		Color    = 2,
+		TexCoord = 3,
+		Tangent  = 4
+	};
+
+	// Maps a C++ component type to its OpenGL type enum
+	template<typename Component>
+	struct VertexComponentType;
+
+	template<> struct VertexComponentType<float>         { static constexpr GLenum value = GL_FLOAT; };
+	template<> struct VertexComponentType<std::int8_t>   { static constexpr GLenum value = GL_BYTE; };
+	template<> struct VertexComponentType<std::uint8_t>  { static constexpr GLenum value = GL_UNSIGNED_BYTE; };
+	template<> struct VertexComponentType<std::int16_t>  { static constexpr GLenum value = GL_SHORT; };
+	template<> struct VertexComponentType<std::uint16_t> { static constexpr GLenum value = GL_UNSIGNED_SHORT; };
+	template<> struct VertexComponentType<std::int32_t>  { static constexpr GLenum value = GL_INT; };
+	template<> struct VertexComponentType<std::uint32_t> { static constexpr GLenum value = GL_UNSIGNED_INT; };
+
+	/// \brief Describes one vertex attribute at compile time.
+	/// \tparam Semantic What the attribute means; also selects its location.
+	/// \tparam Component The type of each component.
+	/// \tparam Count The number of components (1 to 4).
+	/// \tparam Normalized Whether integer components are mapped to [0, 1] / [-1, 1];
+	///   integer components that are not reach the shader as integers, so
+	///   its input must be an int or uint type.
+	/// \tparam Divisor 0 for per-vertex data, N to advance once every N instances.
+	template<VertexSemantic Semantic, typename Component, GLint Count, bool Normalized = false, GLuint Divisor = 0>
+	struct VertexAttribute
+	{
+		static_assert(Count >= 1 && Count <= 4, "A vertex attribute has 1 to 4 components");
+
+		using ComponentType = Component;
+
+		static constexpr VertexSemantic SEMANTIC   = Semantic;
+		static constexpr GLuint         LOCATION   = static_cast<GLuint>(Semantic);
+		static constexpr GLint          COUNT      = Count;
+		static constexpr GLenum         TYPE       = VertexComponentType<Component>::value;
+		static constexpr GLboolean      NORMALIZED = Normalized ? GL_TRUE : GL_FALSE;
+		// Fed with glVertexAttribIPointer rather than converted to float
+		static constexpr bool           INTEGER    = std::is_integral<Component>::value && !Normalized;
+		static constexpr GLuint         DIVISOR    = Divisor;
+		// Attributes are padded to 4 bytes, as most drivers require
+		static constexpr std::size_t    SIZE       = (sizeof(Component) * Count + 3) / 4 * 4;
+	};
+
+	/// \brief An interleaved vertex format: stride and offsets are computed at
+	///   compile time from the attribute list.
+	template<typename... Attributes>
+	struct VertexLayout
+	{
+		static constexpr std::size_t ATTRIBUTE_COUNT = sizeof...(Attributes);
+		static constexpr std::size_t STRIDE = (Attributes::SIZE + ... + 0);
+
+		/// \return The byte offset of the attribute at position index.
+		static constexpr std::size_t offsetAt(std::size_t index)
+		{
+			std::size_t const sizes[] = { Attributes::SIZE..., 0 };
+			std::size_t offset = 0;
+			for (std::size_t i = 0; i < index; ++i)
+			{
+				offset += sizes[i];
+			}
+			return offset;
+		}
+
+		/// \return Whether this layout has an attribute with the semantic.
+		template<VertexSemantic Semantic>
+		static constexpr bool has()
+		{
+			return ((Attributes::SEMANTIC == Semantic) || ...);
+		}
+
+		/// \return The byte offset of the attribute with the semantic.
+		template<VertexSemantic Semantic>
+		static constexpr std::size_t offsetOf()
+		{
+			static_assert(has<Semantic>(), "The layout has no attribute with this semantic");
+			VertexSemantic const semantics[] = { Attributes::SEMANTIC... };
+			std::size_t index = 0;
+			while (semantics[index] != Semantic)
+			{
+				++index;
+			}
+			return offsetAt(index);
+		}
+
+		/// \brief Copies the components of one attribute into a vertex.
+		/// \param[out] vertex The start of the vertex in an interleaved buffer.
+		/// \param[in] components The attribute's components, already in the
+		///   attribute's component type.
+		template<VertexSemantic Semantic, typename Component>
+		static void write(void* vertex, Component const* components)
+		{
+			using Attribute = typename Find<Semantic, Attributes...>::Type;
+			static_assert(std::is_same<Component, typename Attribute::ComponentType>::value,
+				"Component type does not match the layout");
+			std::memcpy(static_cast<char*>(vertex) + offsetOf<Semantic>(), components,
+				sizeof(Component) * Attribute::COUNT);
+		}
+
+		/// \brief Enables and configures every attribute of this layout.
+		/// \pre A VAO and the VBO holding this layout's data are bound.
+		static void enableAttributes()
+		{
+			enableAttributes(std::make_index_sequence<ATTRIBUTE_COUNT>());
+		}
+
+	private:
+		template<VertexSemantic Semantic, typename First, typename... Rest>
+		struct Find
+		{
+			using Type = typename std::conditional<First::SEMANTIC == Semantic, First,
+				typename Find<Semantic, Rest...>::Type>::type;
+		};
+
+		template<VertexSemantic Semantic, typename Last>
+		struct Find<Semantic, Last>
+		{
+			using Type = Last;
+		};
+
+		template<typename Attribute>
+		static void enableAttribute(std::size_t offset)
+		{
+			glEnableVertexAttribArray(Attribute::LOCATION);
+			if constexpr (Attribute::INTEGER)
+			{
+				glVertexAttribIPointer(Attribute::LOCATION, Attribute::COUNT, Attribute::TYPE,
+					static_cast<GLsizei>(STRIDE), reinterpret_cast<void*>(offset));
+			}
+			else
+			{
+				glVertexAttribPointer(Attribute::LOCATION, Attribute::COUNT, Attribute::TYPE, Attribute::NORMALIZED,
+					static_cast<GLsizei>(STRIDE), reinterpret_cast<void*>(offset));
+			}
+			glVertexAttribDivisor(Attribute::LOCATION, Attribute::DIVISOR);
+		}
+
+		template<std::size_t... Indices>
+		static void enableAttributes(std::index_sequence<Indices...>)
+		{
+			(enableAttribute<Attributes>(offsetAt(Indices)), ...);
+		}
+	};
+
+	// Common attributes
+	using Position3f = VertexAttribute<VertexSemantic::Position, float, 3>;
+	using Normal3f   = VertexAttribute<VertexSemantic::Normal  , float, 3>;
+	using Color3f    = VertexAttribute<VertexSemantic::Color   , float, 3>;
+	using TexCoord2f = VertexAttribute<VertexSemantic::TexCoord, float, 2>;
+	using Tangent4f  = VertexAttribute<VertexSemantic::Tangent , float, 4>;
+	// Compact color, 4 normalized bytes
+	using Color4ub   = VertexAttribute<VertexSemantic::Color   , std::uint8_t, 4, true>;
+
+	// 3 float position, 3 float normal, 3 float color
+	using MeshVertexLayout = VertexLayout<Position3f, Normal3f, Color3f>;
+}
@@ -0,0 +1,74 @@
+# Writes the shaders of a directory into a C++ header as constexpr strings,
+# with their #include "file" lines replaced by the included files.
+#
+#   cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P EmbedShaders.cmake
+#
+# The header is only rewritten when its contents change, so editing a C++
+# file does not rebuild everything that includes it.
+
+if(NOT SHADER_DIR OR NOT OUTPUT)
+  message(FATAL_ERROR "EmbedShaders.cmake needs SHADER_DIR and OUTPUT")
+endif()
+
+# Longest piece of one string literal; MSVC rejects longer literals, and
+# adjacent pieces are joined by the compiler
+set(PIECE_LENGTH 4000)
+
+# Reads a shader and, recursively, the files it includes.  STACK holds the
+# files being included, to report include cycles.
+function(resolve_shader NAME STACK RESULT)
+  set(PATH "${SHADER_DIR}/${NAME}")
+  if(NOT EXISTS "${PATH}")
+    message(FATAL_ERROR "Shader ${NAME} not found in ${SHADER_DIR} (included by ${STACK})")
+  endif()
+  list(FIND STACK "${NAME}" CYCLE)
+  if(NOT CYCLE EQUAL -1)
+    message(FATAL_ERROR "Shader ${NAME} includes itself through ${STACK}")
+  endif()
+  list(APPEND STACK "${NAME}")
+
+  file(READ "${PATH}" SOURCE)
+  string(REPLACE "\r" "" SOURCE "${SOURCE}")
+  string(REGEX MATCHALL "#include \"[^\"]+\"" DIRECTIVES "${SOURCE}")
+  list(REMOVE_DUPLICATES DIRECTIVES)
+  foreach(DIRECTIVE IN LISTS DIRECTIVES)
+    string(REGEX REPLACE "#include \"([^\"]+)\"" "\\1" INCLUDED "${DIRECTIVE}")
+    resolve_shader("${INCLUDED}" "${STACK}" INCLUDED_SOURCE)
+    string(REPLACE "${DIRECTIVE}" "${INCLUDED_SOURCE}" SOURCE "${SOURCE}")
+  endforeach()
+  set(${RESULT} "${SOURCE}" PARENT_SCOPE)
+endfunction()
+
+file(GLOB SHADERS RELATIVE "${SHADER_DIR}" "${SHADER_DIR}/*.vert" "${SHADER_DIR}/*.frag" "${SHADER_DIR}/*.glsl")
+list(SORT SHADERS)
+
+set(HEADER "#pragma once\n\n")
+string(APPEND HEADER "// Generated by cmake/EmbedShaders.cmake from the shaders of Render/; do not edit.\n\n")
+string(APPEND HEADER "#include <string_view>\n\n")
+string(APPEND HEADER "namespace VenusEngine\n{\n")
+string(APPEND HEADER "\tstruct EmbeddedShader\n\t{\n")
+string(APPEND HEADER "\t\tstd::string_view name;\n")
+string(APPEND HEADER "\t\tstd::string_view source;\n")
+string(APPEND HEADER "\t};\n\n")
+string(APPEND HEADER "\tinline constexpr EmbeddedShader EMBEDDED_SHADERS[] =\n\t{\n")
+foreach(SHADER IN LISTS SHADERS)
+  resolve_shader("${SHADER}" "" SOURCE)
+  string(APPEND HEADER "\t\t{ \"${SHADER}\",\n")
+  string(LENGTH "${SOURCE}" LENGTH)
+  set(OFFSET 0)
+  while(OFFSET LESS LENGTH)
+    string(SUBSTRING "${SOURCE}" ${OFFSET} ${PIECE_LENGTH} PIECE)
+    string(APPEND HEADER "R\"glsl(${PIECE})glsl\"\n")
+    math(EXPR OFFSET "${OFFSET} + ${PIECE_LENGTH}")
+  endwhile()
+  string(APPEND HEADER "\t\t},\n")
+endforeach()
+string(APPEND HEADER "\t};\n}\n")
+
+if(EXISTS "${OUTPUT}")
+  file(READ "${OUTPUT}" EXISTING)
+  if(EXISTING STREQUAL HEADER)
+    return()
+  endif()
+endif()
+file(WRITE "${OUTPUT}" "${HEADER}")
@@ -1,9 +1,29 @@
 #include <iostream>
+#include <string>
 
 #include "Editor/Application.h"
+#include "Editor/FrameBenchmark.h"
+#include "Core/Benchmark.h"
 
 int main(int argc, char* argv[])
 {
+	// VenusEngine --benchmark <name> runs a stress test without opening a window
+	if (argc >= 3 && std::string(argv[1]) == "--benchmark")
+	{
+		// ... except for the frame benchmark, which draws a generated scene
+		if (std::string(argv[2]) == "frame")
+		{
+			VenusEngine::FrameBenchmark::Settings settings;
+			if (!VenusEngine::FrameBenchmark::parse(argc - 3, argv + 3, settings))
+			{
+				return EXIT_FAILURE;
+			}
+			VenusEngine::Application app;
+			return app.runBenchmark(settings);
+		}
+		return VenusEngine::Benchmark::run(argv[2]);
+	}
+
 	VenusEngine::Application app;
 
 	app.run();